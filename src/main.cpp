@@ -8,10 +8,12 @@
 #include "nn/optim/adam.h"
 #include "nn/optim/sgd.h"
 #include "tensor.h"
+#include "tensor/kernels/gemm_tuning.h"
 #include "tensor/tensor_create.h"
 #include "tensor_utils.h"
 #include "utils/data/csv_reader.h"
 #include <algorithm>
+#include <array>
 #include <cassert>
 #include <iostream>
 #include <ostream>
@@ -27,12 +29,33 @@ std::string get_executable_path() {
 }
 
 int get_max_index(tensor::Tensor tensor) {
-  auto max_element =
-      std::max_element(tensor.data().begin(), tensor.data().end());
-  return std::distance(tensor.data().begin(), max_element);
+  auto values = tensor.data();
+  auto max_element = std::max_element(values.begin(), values.end());
+  return std::distance(values.begin(), max_element);
 }
 
-int main() {
+// Tunes the GEMM blocking for the products of training the model below, as
+// m, n, k, and saves it for later runs on this CPU.
+void tune() {
+  auto shapes = std::vector<std::array<int, 3>>{
+      {32, 512, 784}, {32, 128, 512}, {32, 10, 128},  // forward
+      {32, 784, 512}, {32, 512, 128}, {32, 128, 10},  // input gradients
+      {784, 512, 32}, {512, 128, 32}, {128, 10, 32}}; // weight gradients
+  for (auto [m, n, k] : shapes) {
+    auto blocking = kernels::tune_gemm(m, n, k);
+    std::cout << m << "x" << k << " @ " << k << "x" << n
+              << ": mc=" << blocking.mc << " kc=" << blocking.kc
+              << " nc=" << blocking.nc
+              << " grain_work=" << blocking.grain_work << "\n";
+  }
+}
+
+int main(int argc, char **argv) {
+  if (argc > 1 && std::string(argv[1]) == "tune") {
+    tune();
+    return 0;
+  }
+
   // Setup Training Data
   std::string exe_path = get_executable_path();
   std::string train_path = exe_path + "..\\..\\data\\train.csv";
@@ -40,16 +63,14 @@ int main() {
   auto labels = csv_reader.pop("label");
 
   auto y_transform = [](const std::string &label) {
-    auto result = tensor::one_hot(std::stoi(label), 10);
-    result.view({10});
-    return result;
+    return static_cast<float>(std::stoi(label));
   };
   auto x_transform = [](const std::vector<std::string> &row) {
     std::vector<float> result(row.size());
     for (int i = 0; i < row.size(); i++) {
       result[i] = std::stof(row[i]) / 255.0f;
     }
-    return Tensor(result, {28 * 28});
+    return tensor::from_vector(result, {28 * 28});
   };
 
   int train_size = 0.8 * csv_reader.data.size();
@@ -57,14 +78,14 @@ int main() {
   std::vector<tensor::Tensor> x_train;
   std::transform(csv_reader.data.begin(), csv_reader.data.begin() + train_size,
                  std::back_inserter(x_train), x_transform);
-  std::vector<tensor::Tensor> y_train;
+  std::vector<float> y_train;
   std::transform(labels.begin(), labels.begin() + train_size,
                  std::back_inserter(y_train), y_transform);
 
   std::vector<tensor::Tensor> x_val;
   std::transform(csv_reader.data.begin() + train_size, csv_reader.data.end(),
                  std::back_inserter(x_val), x_transform);
-  std::vector<tensor::Tensor> y_val;
+  std::vector<float> y_val;
   std::transform(labels.begin() + train_size, labels.end(),
                  std::back_inserter(y_val), y_transform);
   csv_reader.~CSVReader();
@@ -73,10 +94,8 @@ int main() {
   int input_size = 28 * 28;
   int num_classes = 10;
   auto model = nn::container::Sequential({
-      new nn::linear::Linear(input_size, 512),
-      new nn::activation::Tanh(),
-      new nn::linear::Linear(512, 128),
-      new nn::activation::Tanh(),
+      new nn::linear::Linear(input_size, 512, true, kernels::Activation::Tanh),
+      new nn::linear::Linear(512, 128, true, kernels::Activation::Tanh),
       new nn::linear::Linear(128, num_classes),
   });
 
@@ -95,14 +114,14 @@ int main() {
     for (int batch = 0; batch + batch_size < y_train.size();
          batch += batch_size) {
       auto x_tensors = std::vector<Tensor>();
-      auto y_tensors = std::vector<Tensor>();
-      for (int i = batch; i < batch + batch_size; i++) {
+      for (int i = batch; i < batch + batch_size; i++)
         x_tensors.push_back(x_train[i]);
-        y_tensors.push_back(y_train[i]);
-      }
       auto x = tensor::stack(x_tensors);
       x.name() = "data";
-      auto y = tensor::stack(y_tensors);
+      auto y = tensor::from_vector(
+          std::vector<float>(y_train.begin() + batch,
+                             y_train.begin() + batch + batch_size),
+          {batch_size});
       y.name() = "expected";
 
       auto result = model.forward(x);
@@ -127,19 +146,18 @@ int main() {
 
   // Validate model
   model.eval();
+  auto inference_mode = tensor::InferenceModeGuard();
   float accuracy = 0;
   float avg_loss = 0;
   float size = y_val.size();
   for (int i = 0; i < y_val.size(); i++) {
-    optimizer.zero_grad();
     auto x = x_val[i];
-    auto y = y_val[i];
+    auto y = Tensor({y_val[i]}, {1}, "expected");
 
     auto result = model.forward(x);
 
     int result_index = get_max_index(result);
-    int y_index = get_max_index(y);
-    if (result_index == y_index) {
+    if (result_index == static_cast<int>(y_val[i])) {
       accuracy++;
     }
 
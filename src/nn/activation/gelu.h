@@ -0,0 +1,19 @@
+#ifndef GELU_H
+#define GELU_H
+
+#include "../../tensor/tensor_func.h"
+#include "../containers/module.h"
+
+namespace nn {
+namespace activation {
+
+class GELU : public Module {
+public:
+  tensor::Tensor forward(tensor::Tensor data) override {
+    return tensor::gelu(data);
+  }
+};
+
+} // namespace activation
+} // namespace nn
+#endif // GELU_H
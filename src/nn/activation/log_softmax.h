@@ -0,0 +1,26 @@
+#ifndef LOG_SOFTMAX_H
+#define LOG_SOFTMAX_H
+
+#include "../../tensor/tensor.h"
+#include "../../tensor/tensor_func.h"
+#include "../containers/module.h"
+
+namespace nn {
+namespace activation {
+
+class LogSoftmax : public Module {
+public:
+  LogSoftmax(std::optional<int> dim = std::nullopt) { this->dim = dim; }
+
+  tensor::Tensor forward(tensor::Tensor data) override {
+    return tensor::log_softmax(data, dim);
+  }
+
+private:
+  std::optional<int> dim;
+};
+
+} // namespace activation
+} // namespace nn
+
+#endif // LOG_SOFTMAX_H
@@ -0,0 +1,19 @@
+#ifndef SIGMOID_H
+#define SIGMOID_H
+
+#include "../../tensor/tensor_func.h"
+#include "../containers/module.h"
+
+namespace nn {
+namespace activation {
+
+class Sigmoid : public Module {
+public:
+  tensor::Tensor forward(tensor::Tensor data) override {
+    return tensor::sigmoid(data);
+  }
+};
+
+} // namespace activation
+} // namespace nn
+#endif // SIGMOID_H
@@ -13,12 +13,7 @@ public:
   Softmax(std::optional<int> dim = std::nullopt) { this->dim = dim; }
 
   tensor::Tensor forward(tensor::Tensor data) override {
-    bool keepdim = false;
-    if (dim.has_value())
-      keepdim = true;
-    auto exps = tensor::exp(data);
-    auto sum = tensor::sum(exps, dim, keepdim);
-    return exps / sum;
+    return tensor::softmax(data, dim);
   }
 
 private:
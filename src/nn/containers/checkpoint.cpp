@@ -0,0 +1,81 @@
+#include "checkpoint.h"
+#include "../../tensor/tensor.h"
+#include "../../tensor/tensor_create.h"
+#include <memory>
+#include <vector>
+
+using namespace tensor;
+using variable::GradMode;
+using variable::Variable;
+
+namespace nn {
+namespace container {
+
+Tensor checkpoint(std::function<Tensor(Tensor)> function, Tensor input,
+                  std::vector<Tensor *> parameters) {
+  if (!GradMode::is_enabled())
+    return function(input);
+
+  auto state = generator();
+  auto result = [&]() {
+    NoGradGuard guard;
+    return function(input);
+  }();
+
+  auto prev = std::vector<std::shared_ptr<Variable<>>>{input.var};
+  for (auto parameter : parameters)
+    prev.push_back(parameter->var);
+  auto out = std::make_shared<Variable<>>(
+      result.var->storage, result.var->offset, result.var->shape,
+      result.var->strides, prev, "checkpoint");
+  if (!out->requires_grad)
+    return result;
+
+  // The recomputed graph starts from a leaf sharing the input's data, and
+  // its result is seeded with the gradient of out.
+  auto backward = [function, input = input.var.get(),
+                   saved = input.var->save(), out = out.get(), state]() {
+    auto leaf = std::make_shared<Variable<>>(
+        saved.storage, saved.offset, input->shape, input->strides,
+        std::vector<std::shared_ptr<Variable<>>>(), "");
+    leaf->requires_grad = input->requires_grad;
+    auto current = generator();
+    bool enabled = GradMode::is_enabled();
+    generator() = state;
+    GradMode::set_enabled(true);
+    auto recomputed = function(Tensor(leaf));
+    GradMode::set_enabled(enabled);
+    generator() = current;
+
+    recomputed.var->backward(out->grad);
+    if (input->requires_grad && leaf->grad_storage != nullptr)
+      for (int i = 0; i < input->grad.size(); i++)
+        input->grad[i] += leaf->grad[i];
+  };
+  out->back = backward;
+  return Tensor(out);
+}
+
+Checkpoint::Checkpoint(Module *module) : module(module) {}
+
+Tensor Checkpoint::forward(Tensor data) {
+  return checkpoint([this](Tensor x) { return module->forward(x); }, data,
+                    module->parameters());
+}
+
+std::vector<Tensor *> Checkpoint::parameters() {
+  return module->parameters();
+}
+
+void Checkpoint::train() {
+  Module::train();
+  module->train();
+}
+
+void Checkpoint::eval() {
+  Module::eval();
+  module->eval();
+}
+
+} // namespace container
+} // namespace nn
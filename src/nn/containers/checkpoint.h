@@ -0,0 +1,41 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "../../tensor/tensor.h"
+#include "module.h"
+#include <functional>
+#include <vector>
+
+namespace nn {
+namespace container {
+
+// Runs function(input) without recording a graph and returns its result as a
+// single node, whose backward runs function again, with the generator of
+// tensor::uniform and rand_n set back to where it was (so Dropout draws the
+// same mask), and passes the gradient through the recomputed graph. Only the
+// input is kept, so the activations inside function are freed during the
+// forward pass, at the cost of computing them twice. parameters are the
+// tensors function reads that may need gradients. Anything else function
+// depends on, such as training mode, must not change before the backward.
+tensor::Tensor
+checkpoint(std::function<tensor::Tensor(tensor::Tensor)> function,
+           tensor::Tensor input, std::vector<tensor::Tensor *> parameters);
+
+// A module whose forward is checkpointed.
+class Checkpoint : public Module {
+public:
+  Checkpoint(Module *module);
+
+  tensor::Tensor forward(tensor::Tensor data) override;
+  std::vector<tensor::Tensor *> parameters() override;
+  void train() override;
+  void eval() override;
+
+private:
+  Module *module;
+};
+
+} // namespace container
+} // namespace nn
+
+#endif // CHECKPOINT_H
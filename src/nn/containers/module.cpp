@@ -41,7 +41,7 @@ void Module::load(std::string filename) {
     std::getline(file, line);
     for (int i = 0; i < tensor->data().size(); i++) {
       iss >> value;
-      tensor->data()[i] = value;
+      tensor->data_span()[i] = value;
     }
   }
 }
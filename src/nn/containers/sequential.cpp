@@ -1,5 +1,6 @@
 #include "sequential.h"
 #include "../../tensor/tensor.h"
+#include "checkpoint.h"
 #include <vector>
 
 using namespace tensor;
@@ -7,20 +8,42 @@ using namespace tensor;
 namespace nn {
 namespace container {
 
-Sequential::Sequential(std::vector<Module *> modules) : modules(modules) {}
+Sequential::Sequential(std::vector<Module *> modules, int segment_size)
+    : modules(modules), segment_size(segment_size) {}
 
 Tensor Sequential::forward(Tensor data) {
   auto result = data;
-  for (auto &module : modules) {
-    result = module->forward(result);
+  size_t begin = 0;
+  // The last segment is not checkpointed, as the backward starts with it.
+  if (segment_size > 0) {
+    for (; begin + segment_size < modules.size(); begin += segment_size) {
+      size_t end = begin + segment_size;
+      auto segment = [this, begin, end](Tensor x) {
+        return forward_segment(begin, end, x);
+      };
+      result = checkpoint(segment, result, segment_parameters(begin, end));
+    }
   }
-  return result;
+  return forward_segment(begin, modules.size(), result);
 }
 
 std::vector<Tensor *> Sequential::parameters() {
+  return segment_parameters(0, modules.size());
+}
+
+Tensor Sequential::forward_segment(size_t begin, size_t end, Tensor data) {
+  auto result = data;
+  for (size_t i = begin; i < end; i++) {
+    result = modules[i]->forward(result);
+  }
+  return result;
+}
+
+std::vector<Tensor *> Sequential::segment_parameters(size_t begin,
+                                                     size_t end) {
   std::vector<Tensor *> params;
-  for (auto &module : modules) {
-    auto module_params = module->parameters();
+  for (size_t i = begin; i < end; i++) {
+    auto module_params = modules[i]->parameters();
     params.insert(params.end(), module_params.begin(), module_params.end());
   }
   return params;
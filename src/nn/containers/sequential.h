@@ -7,9 +7,13 @@
 namespace nn {
 namespace container {
 
+// With segment_size set, the modules are run in segments of that many, and
+// every segment but the last is checkpointed (see checkpoint()): its
+// activations are freed during the forward pass and recomputed by the
+// backward. The modules must outlive the graph.
 class Sequential : public Module {
 public:
-  Sequential(std::vector<Module *> modules);
+  Sequential(std::vector<Module *> modules, int segment_size = 0);
 
   tensor::Tensor forward(tensor::Tensor data) override;
   std::vector<tensor::Tensor *> parameters() override;
@@ -20,6 +24,11 @@ public:
 
 private:
   std::vector<Module *> modules;
+  int segment_size;
+
+  tensor::Tensor forward_segment(size_t begin, size_t end,
+                                 tensor::Tensor data);
+  std::vector<tensor::Tensor *> segment_parameters(size_t begin, size_t end);
 };
 
 } // namespace container
@@ -12,10 +12,11 @@ Dropout::Dropout(float p) : p(p) { assert(p >= 0 && p <= 1); }
 
 Tensor Dropout::forward(Tensor data) {
   if (training) {
-    auto mask = tensor::uniform(data.shape(), 0.0, 1.0) > p;
+    auto noise = tensor::uniform(data.shape(), 0.0, 1.0);
+    auto mask = noise > p;
     return data * mask;
   } else {
-    auto mul = Tensor({1 - p}, {1});
+    auto mul = tensor::from_vector({1 - p}, {1});
     return data * mul;
   }
 }
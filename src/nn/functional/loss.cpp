@@ -1,5 +1,6 @@
 #include "loss.h"
 #include "../../tensor/tensor.h"
+#include "../../tensor/tensor_create.h"
 #include "../../tensor/tensor_func.h"
 #include <cassert>
 #include <stdexcept>
@@ -9,56 +10,81 @@ using namespace tensor;
 namespace nn {
 namespace functional {
 
-Tensor binary_cross_entropy(Tensor &output, Tensor &target) {
-  assert(output.data().size() == target.data().size());
-  auto number = static_cast<int>(output.data().size());
-  auto one = Tensor(std::vector<float>(number, 1.0f), output.shape(), "one");
-  auto inverse = Tensor(std::vector<float>(1, -1.0f / number), {1}, "inverse");
+Tensor binary_cross_entropy(Tensor &output, Tensor &target,
+                            std::string reduction) {
+  return pointwise_loss(output, target, kernels::LossOp::BCE, reduction);
+}
 
-  auto output_log = log(output);
-  auto one_minus_output = one - output;
-  auto one_minus_output_log = log(one_minus_output);
-  auto left = target * output_log;
-  auto one_minus_target = one - target;
-  auto right = one_minus_target * one_minus_output_log;
+Tensor binary_cross_entropy_with_logits(Tensor &output, Tensor &target,
+                                        std::string reduction) {
+  return pointwise_loss(output, target, kernels::LossOp::BCEWithLogits,
+                        reduction);
+}
 
-  auto sum_vec = left + right;
-  auto sum = tensor::sum(sum_vec);
-  auto loss = inverse * sum;
+// Sums or averages per-sample losses; the mean is over the count samples
+// that were not ignored. "none" and "" keep the per-sample losses.
+static Tensor reduce(Tensor &losses, const std::string &reduction,
+                     int count) {
+  if (reduction == "" || reduction == "none")
+    return losses;
+  if (reduction != "mean" && reduction != "sum")
+    throw std::invalid_argument("Invalid reduction");
+  auto total = tensor::sum(losses);
+  if (reduction == "sum")
+    return total;
+  auto inverse = tensor::from_vector({1.0f / count}, {1});
+  return total * inverse;
+}
 
-  return loss;
+// The number of entries of target that are not ignore_index.
+static int counted(Tensor &target, int ignore_index) {
+  int count = 0;
+  auto labels = target.contiguous();
+  for (float value : labels.data())
+    count += static_cast<int>(value) != ignore_index;
+  return count;
 }
 
-Tensor cross_entropy(Tensor &output, Tensor &target, std::string reduction) {
-  if (output.shape().size() == 1)
-    output.view({1, output.shape(0)});
-  auto exp = tensor::exp(output);
-  auto sum = tensor::sum(exp, 1);
-  auto log = tensor::log(sum);
-  auto mul = output * target; // -input[i, target[i]] for one hot encoded target
-  auto mul_sum = tensor::sum(mul, 1);
-  auto result = log - mul_sum;
+Tensor cross_entropy(Tensor &output, Tensor &target, std::string reduction,
+                     float label_smoothing, int ignore_index) {
+  // A single sample is a batch of one; the caller's tensors keep their shape.
+  auto logits = output;
+  auto labels = target;
+  if (output.shape().size() == 1) {
+    if (target.shape() == output.shape())
+      labels = target.reshape({1, target.shape(0)});
+    logits = output.reshape({1, output.shape(0)});
+  }
+  if (labels.shape() != logits.shape()) {
+    auto result = tensor::class_cross_entropy(logits, labels, label_smoothing,
+                                              ignore_index);
+    return reduce(result, reduction, counted(labels, ignore_index));
+  }
+  auto result = tensor::softmax_cross_entropy(logits, labels, label_smoothing);
+  return reduce(result, reduction, result.numel());
+}
 
-  if (reduction == "mean")
-    return tensor::mean(result);
-  else if (reduction == "sum")
-    return tensor::sum(result);
-  else if (reduction == "")
-    return result;
-  else
-    throw std::invalid_argument("Invalid reduction");
+Tensor nll_loss(Tensor &output, Tensor &target, std::string reduction,
+                int ignore_index) {
+  auto log_probabilities = output;
+  if (output.shape().size() == 1)
+    log_probabilities = output.reshape({1, output.shape(0)});
+  auto result = tensor::nll(log_probabilities, target, ignore_index);
+  return reduce(result, reduction, counted(target, ignore_index));
 }
 
 Tensor mse_loss(Tensor &output, Tensor &target, std::string reduction) {
-  auto diff = output - target;
-  auto square = diff * diff;
-  if (reduction == "sum") {
-    return tensor::sum(square);
-  } else if (reduction == "mean") {
-    return tensor::mean(square);
-  } else {
-    throw std::invalid_argument("Invalid reduction");
-  }
+  return pointwise_loss(output, target, kernels::LossOp::MSE, reduction);
+}
+
+Tensor l1_loss(Tensor &output, Tensor &target, std::string reduction) {
+  return pointwise_loss(output, target, kernels::LossOp::L1, reduction);
+}
+
+Tensor huber_loss(Tensor &output, Tensor &target, std::string reduction,
+                  float delta) {
+  return pointwise_loss(output, target, kernels::LossOp::Huber, reduction,
+                        delta);
 }
 
 } // namespace functional
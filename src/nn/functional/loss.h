@@ -6,12 +6,36 @@
 namespace nn {
 namespace functional {
 
+// Elementwise losses of output against a target of the same shape, each one
+// fused kernel, reduced by "mean", "sum" or "none".
 tensor::Tensor binary_cross_entropy(tensor::Tensor &output,
-                                    tensor::Tensor &target);
+                                    tensor::Tensor &target,
+                                    std::string reduction = "mean");
+// binary_cross_entropy of sigmoid(output), computed from the logits so that
+// it stays finite for logits of any size.
+tensor::Tensor binary_cross_entropy_with_logits(tensor::Tensor &output,
+                                                tensor::Tensor &target,
+                                                std::string reduction = "mean");
+// Cross-entropy of logits [N, C, ...]. A target of the same shape holds class
+// probabilities; a target of shape [N, ...] holds class indices, and samples
+// of class ignore_index are left out, also from the mean. label_smoothing
+// mixes the target with the uniform distribution over the classes.
 tensor::Tensor cross_entropy(tensor::Tensor &output, tensor::Tensor &target,
-                             std::string reduction = "mean");
+                             std::string reduction = "mean",
+                             float label_smoothing = 0.0f,
+                             int ignore_index = -100);
+// Negative log-likelihood of log-probabilities [N, C, ...] against class
+// indices [N, ...].
+tensor::Tensor nll_loss(tensor::Tensor &output, tensor::Tensor &target,
+                        std::string reduction = "mean",
+                        int ignore_index = -100);
 tensor::Tensor mse_loss(tensor::Tensor &output, tensor::Tensor &target,
                         std::string reduction = "mean");
+tensor::Tensor l1_loss(tensor::Tensor &output, tensor::Tensor &target,
+                       std::string reduction = "mean");
+// Squared error within delta of the target and absolute error beyond it.
+tensor::Tensor huber_loss(tensor::Tensor &output, tensor::Tensor &target,
+                          std::string reduction = "mean", float delta = 1.0f);
 
 } // namespace functional
 } // namespace nn
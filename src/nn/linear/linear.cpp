@@ -1,6 +1,7 @@
 #include "linear.h"
 #include "../../tensor/tensor.h"
 #include "../../tensor/tensor_create.h"
+#include "../../tensor/tensor_func.h"
 #include <cmath>
 #include <vector>
 
@@ -9,12 +10,14 @@ using namespace tensor;
 namespace nn {
 namespace linear {
 
-Linear::Linear(int in_features, int out_features, bool has_bias)
+Linear::Linear(int in_features, int out_features, bool has_bias,
+               kernels::Activation activation)
     : in_features(in_features), out_features(out_features), has_bias(has_bias),
+      activation(activation),
       weights(tensor::uniform({in_features, out_features},
                               -1.0f / std::sqrt(in_features),
-                              1.0f / std::sqrt(in_features))),
-      bias(has_bias ? std::make_optional(tensor::zeros({out_features}))
+                              1.0f / std::sqrt(in_features), true)),
+      bias(has_bias ? std::make_optional(tensor::zeros({out_features}, true))
                     : std::nullopt) {
   weights.name() = "weights";
   if (this->has_bias)
@@ -22,10 +25,9 @@ Linear::Linear(int in_features, int out_features, bool has_bias)
 }
 
 Tensor Linear::forward(Tensor data) {
-  auto result = data & weights;
   if (this->has_bias)
-    result = result + bias.value();
-  return result;
+    return tensor::linear(data, weights, bias.value(), activation);
+  return tensor::linear(data, weights, activation);
 }
 
 std::vector<Tensor *> Linear::parameters() {
@@ -1,6 +1,6 @@
 #include "adam.h"
+#include "../../tensor/kernels/optim.h"
 #include "optimizer.h"
-#include <cmath>
 
 namespace nn {
 namespace optim {
@@ -11,8 +11,8 @@ Adam::Adam(std::vector<tensor::Tensor *> parameters, float learning_rate,
       beta_2(beta_2), eps(eps) {
   t = 0;
   for (tensor::Tensor *parameter : parameters) {
-    m.push_back(std::vector<float>(parameter->data().size(), 0));
-    v.push_back(std::vector<float>(parameter->data().size(), 0));
+    m.push_back(std::vector<float>(parameter->numel(), 0));
+    v.push_back(std::vector<float>(parameter->numel(), 0));
   }
 }
 
@@ -22,17 +22,12 @@ void Adam::step() {
   beta_2_to_t_power = beta_2_to_t_power * beta_2;
 
   for (int i = 0; i < parameters.size(); i++) {
-    for (int j = 0; j < parameters[i]->data().size(); j++) {
-      m[i][j] = beta_1 * m[i][j] + (1 - beta_1) * parameters[i]->grad()[j];
-      v[i][j] = beta_2 * v[i][j] +
-                (1 - beta_2) * std::pow(parameters[i]->grad()[j], 2);
-
-      float m_hat = m[i][j] / (1 - beta_1_to_t_power);
-      float v_hat = v[i][j] / (1 - beta_2_to_t_power);
-
-      parameters[i]->data()[j] -=
-          learning_rate * m_hat / (std::sqrt(v_hat) + eps);
-    }
+    kernels::adam_step(parameters[i]->data_span().data(),
+                       parameters[i]->grad_span().data(), m[i].data(),
+                       v[i].data(),
+                       learning_rate, beta_1, beta_2, eps,
+                       1 - beta_1_to_t_power, 1 - beta_2_to_t_power,
+                       parameters[i]->numel());
   }
 }
 
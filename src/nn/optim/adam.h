@@ -23,8 +23,8 @@ private:
   std::vector<std::vector<float>> m;
   std::vector<std::vector<float>> v;
 
-  float beta_1_to_t_power;
-  float beta_2_to_t_power;
+  float beta_1_to_t_power = 1;
+  float beta_2_to_t_power = 1;
 };
 
 } // namespace optim
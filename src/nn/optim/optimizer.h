@@ -13,7 +13,8 @@ public:
   virtual void step() {}
   virtual void zero_grad() {
     for (tensor::Tensor *parameter : parameters) {
-      std::fill(parameter->grad().begin(), parameter->grad().end(), 0.0f);
+      auto grad = parameter->grad_span();
+      std::fill(grad.begin(), grad.end(), 0.0f);
     }
   }
 
@@ -1,6 +1,7 @@
 #ifndef SGD_H
 #define SGD_H
 
+#include "../../tensor/kernels/optim.h"
 #include "../../tensor/tensor.h"
 #include "optimizer.h"
 
@@ -15,9 +16,9 @@ public:
       : Optimizer(parameters), learning_rate(learning_rate) {}
   virtual void step() {
     for (Tensor *parameter : parameters) {
-      for (int i = 0; i < parameter->grad().size(); i++) {
-        parameter->data()[i] -= learning_rate * parameter->grad()[i];
-      }
+      kernels::sgd_step(parameter->data_span().data(),
+                        parameter->grad_span().data(),
+                        learning_rate, parameter->numel());
     }
   }
 
@@ -0,0 +1,132 @@
+#include "blas.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstdlib>
+#include <iostream>
+#ifdef CTORCH_HAS_BLAS
+#include <cblas.h>
+#endif
+
+namespace kernels {
+
+static GemmBackend parse_backend(std::string name) {
+  std::transform(name.begin(), name.end(), name.begin(),
+                 [](unsigned char c) { return std::tolower(c); });
+  if (name == "blas")
+    return GemmBackend::Blas;
+  if (name != "builtin")
+    std::cerr << GEMM_BACKEND_ENV << "=" << name
+              << " is not one of builtin, blas" << std::endl;
+  return GemmBackend::Builtin;
+}
+
+static GemmBackend available(GemmBackend backend) {
+  return blas_available() ? backend : GemmBackend::Builtin;
+}
+
+static std::atomic<GemmBackend> &active_backend() {
+  static std::atomic<GemmBackend> backend = [] {
+    const char *env = std::getenv(GEMM_BACKEND_ENV);
+    if (env == nullptr)
+      return GemmBackend::Builtin;
+    GemmBackend parsed = parse_backend(env);
+    if (available(parsed) != parsed)
+      std::cerr << GEMM_BACKEND_ENV << "=" << env
+                << " needs a build with CTORCH_USE_BLAS" << std::endl;
+    return available(parsed);
+  }();
+  return backend;
+}
+
+bool blas_available() {
+#ifdef CTORCH_HAS_BLAS
+  return true;
+#else
+  return false;
+#endif
+}
+
+GemmBackend get_gemm_backend() { return active_backend(); }
+
+void set_gemm_backend(GemmBackend backend) {
+  active_backend() = available(backend);
+}
+
+std::string gemm_backend_name(GemmBackend backend) {
+  return backend == GemmBackend::Blas ? "blas" : "builtin";
+}
+
+#ifdef CTORCH_HAS_BLAS
+
+namespace {
+
+// A rows x cols operand, element (i, j) at x[i * row + j * col], as a
+// row-major matrix with leading dimension ld, transposed or not.
+struct Layout {
+  CBLAS_TRANSPOSE trans;
+  int ld;
+};
+
+bool layout(int rows, int cols, int row, int col, Layout &out) {
+  if (col == 1 && (rows == 1 || row >= cols))
+    out = {CblasNoTrans, rows == 1 ? cols : row};
+  else if (row == 1 && (cols == 1 || col >= rows))
+    out = {CblasTrans, cols == 1 ? rows : col};
+  else if (rows == 1 && col > 0)
+    out = {CblasTrans, col};
+  else if (cols == 1 && row > 0)
+    out = {CblasNoTrans, row};
+  else
+    return false;
+  return true;
+}
+
+CBLAS_TRANSPOSE flip(CBLAS_TRANSPOSE trans) {
+  return trans == CblasTrans ? CblasNoTrans : CblasTrans;
+}
+
+} // namespace
+
+bool blas_gemm(int m, int n, int k, const float *a, int a_row, int a_col,
+               const float *b, int b_row, int b_col, float *c, int ldc,
+               bool accumulate) {
+  Layout la, lb;
+  if (m == 0 || n == 0 || k == 0 || !layout(m, k, a_row, a_col, la) ||
+      !layout(k, n, b_row, b_col, lb))
+    return false;
+  float beta = accumulate ? 1.0f : 0.0f;
+  // The vector operand is read with its stride along k, which has to be
+  // positive; for k == 1 any stride will do.
+  if (m == 1 && (k == 1 || a_col > 0)) {
+    // c = B^T a, with B stored k x n or, transposed, n x k.
+    int rows = lb.trans == CblasNoTrans ? k : n;
+    int cols = lb.trans == CblasNoTrans ? n : k;
+    cblas_sgemv(CblasRowMajor, flip(lb.trans), rows, cols, 1.0f, b, lb.ld, a,
+                k == 1 ? 1 : a_col, beta, c, 1);
+    return true;
+  }
+  if (n == 1 && (k == 1 || b_row > 0) && ldc > 0) {
+    int rows = la.trans == CblasNoTrans ? m : k;
+    int cols = la.trans == CblasNoTrans ? k : m;
+    cblas_sgemv(CblasRowMajor, la.trans, rows, cols, 1.0f, a, la.ld, b,
+                k == 1 ? 1 : b_row, beta, c, ldc);
+    return true;
+  }
+  if (ldc < n)
+    return false;
+  cblas_sgemm(CblasRowMajor, la.trans, lb.trans, m, n, k, 1.0f, a, la.ld, b,
+              lb.ld, beta, c, ldc);
+  return true;
+}
+
+#else
+
+bool blas_gemm(int, int, int, const float *, int, int, const float *, int, int,
+               float *, int, bool) {
+  return false;
+}
+
+#endif
+
+} // namespace kernels
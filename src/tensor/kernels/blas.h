@@ -0,0 +1,36 @@
+#ifndef BLAS_H
+#define BLAS_H
+
+#include <string>
+
+// Backend of the float gemm: builtin or blas. The blas backend needs a build
+// with CTORCH_USE_BLAS; without one it falls back to builtin.
+#define GEMM_BACKEND_ENV "CTORCH_GEMM_BACKEND"
+
+namespace kernels {
+
+enum class GemmBackend { Builtin, Blas };
+
+// Whether the library was built against a CBLAS such as OpenBLAS or BLIS.
+bool blas_available();
+
+// Backend the float gemm and gemm_bias_activation use: the value of
+// GEMM_BACKEND_ENV, read on first use, or builtin.
+GemmBackend get_gemm_backend();
+
+// Selects another backend, falling back to builtin when blas is not
+// available. Like set_num_threads it must not race with running kernels.
+void set_gemm_backend(GemmBackend backend);
+
+std::string gemm_backend_name(GemmBackend backend);
+
+// The float gemm through cblas_sgemm, or cblas_sgemv when m or n is 1. The
+// library does its own threading. Returns false and leaves C alone when blas
+// is not available, a dimension is 0, or an operand has no unit stride.
+bool blas_gemm(int m, int n, int k, const float *a, int a_row, int a_col,
+               const float *b, int b_row, int b_col, float *c, int ldc,
+               bool accumulate);
+
+} // namespace kernels
+
+#endif // BLAS_H
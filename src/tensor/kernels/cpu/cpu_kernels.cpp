@@ -0,0 +1,17 @@
+#include "cpu_kernels.h"
+
+namespace kernels {
+namespace CPU_CAPABILITY {
+
+const CPUKernels &get_cpu_kernels() {
+  static const CPUKernels table = {
+      binary, binary_backward, binary_backward_sum, gemm, sgd_step, adam_step,
+      unary, unary_backward, reduce, arg_reduce, reduce_backward, softmax,
+      softmax_backward, cross_entropy, cross_entropy_backward,
+      cross_entropy_classes, cross_entropy_classes_backward, loss, loss_sum,
+      loss_backward, gemm_bias_activation, activation_backward};
+  return table;
+}
+
+} // namespace CPU_CAPABILITY
+} // namespace kernels
@@ -0,0 +1,158 @@
+#ifndef CPU_KERNELS_H
+#define CPU_KERNELS_H
+
+#include "../elementwise.h"
+#include "../gemm.h"
+#include "../loss.h"
+#include "../reduce.h"
+#include "../softmax.h"
+#include "../unary.h"
+
+// Every source in this directory is compiled once per instruction set, with
+// CPU_CAPABILITY naming the namespace its functions land in (DEFAULT, AVX2 or
+// AVX512). Nothing here may be called directly: the public functions in
+// kernels/ pick the table of the capability selected at startup.
+
+namespace kernels {
+
+struct CPUKernels {
+  void (*binary)(BinaryOp op, const float *a, int stride_a, const float *b,
+                 int stride_b, float *out, int n);
+  void (*binary_backward)(BinaryOp op, int operand, const float *grad,
+                          const float *a, int stride_a, const float *b,
+                          int stride_b, float *target, int stride_target,
+                          int n);
+  float (*binary_backward_sum)(BinaryOp op, int operand, const float *grad,
+                               const float *a, int stride_a, const float *b,
+                               int stride_b, int n);
+  void (*gemm)(int m, int n, int k, const float *a, int a_row, int a_col,
+               const float *b, int b_row, int b_col, float *c, int ldc,
+               bool accumulate);
+  void (*sgd_step)(float *data, const float *grad, float learning_rate,
+                   long n);
+  void (*adam_step)(float *data, const float *grad, float *m, float *v,
+                    float learning_rate, float beta_1, float beta_2, float eps,
+                    float bias_correction_1, float bias_correction_2, long n);
+  void (*unary)(UnaryOp op, const float *in, float *out, long n, bool fast);
+  void (*unary_backward)(UnaryOp op, const float *grad, const float *in,
+                         const float *out, float *target, long n);
+  void (*reduce)(ReduceOp op, const Reduction &reduction, const float *in,
+                 const float *center, float *out);
+  void (*arg_reduce)(bool max, const Reduction &reduction, const float *in,
+                     float *out, int *indices);
+  void (*reduce_backward)(const Reduction &reduction, const float *coef,
+                          const float *in, const float *center,
+                          float *grad_in);
+  void (*softmax)(const SoftmaxDims &dims, const float *in, float *out,
+                  bool log);
+  void (*softmax_backward)(const SoftmaxDims &dims, const float *grad,
+                           const float *out, float *grad_in, bool log);
+  void (*cross_entropy)(const SoftmaxDims &dims, const float *logits,
+                        const float *target, float smoothing, float *loss,
+                        float *log_sum);
+  void (*cross_entropy_backward)(const SoftmaxDims &dims, const float *grad,
+                                 const float *logits, const float *target,
+                                 float smoothing, const float *log_sum,
+                                 float *logits_grad, float *target_grad);
+  void (*cross_entropy_classes)(const SoftmaxDims &dims, const float *logits,
+                                const int *classes, float smoothing,
+                                float *loss, float *log_sum);
+  void (*cross_entropy_classes_backward)(const SoftmaxDims &dims,
+                                         const float *grad,
+                                         const float *logits,
+                                         const int *classes, float smoothing,
+                                         const float *log_sum,
+                                         float *logits_grad);
+  void (*loss)(LossOp op, const float *input, const float *target,
+               float delta, float *out, long n);
+  float (*loss_sum)(LossOp op, const float *input, const float *target,
+                    float delta, long n);
+  void (*loss_backward)(LossOp op, const float *grad, long grad_stride,
+                        const float *input, const float *target, float delta,
+                        float *input_grad, float *target_grad, long n);
+  void (*gemm_bias_activation)(int m, int n, int k, const float *a, int a_row,
+                               int a_col, const float *b, int b_row,
+                               int b_col, const float *bias,
+                               Activation activation, float *c, int ldc,
+                               float *pre, bool fast);
+  void (*activation_backward)(int m, int n, Activation activation,
+                              const float *grad, const float *out,
+                              const float *pre, float *grad_pre,
+                              float *bias_grad);
+};
+
+namespace DEFAULT {
+const CPUKernels &get_cpu_kernels();
+}
+namespace AVX2 {
+const CPUKernels &get_cpu_kernels();
+}
+namespace AVX512 {
+const CPUKernels &get_cpu_kernels();
+}
+
+#ifdef CPU_CAPABILITY
+namespace CPU_CAPABILITY {
+
+void binary(BinaryOp op, const float *a, int stride_a, const float *b,
+            int stride_b, float *out, int n);
+void binary_backward(BinaryOp op, int operand, const float *grad,
+                     const float *a, int stride_a, const float *b,
+                     int stride_b, float *target, int stride_target, int n);
+float binary_backward_sum(BinaryOp op, int operand, const float *grad,
+                          const float *a, int stride_a, const float *b,
+                          int stride_b, int n);
+void gemm(int m, int n, int k, const float *a, int a_row, int a_col,
+          const float *b, int b_row, int b_col, float *c, int ldc,
+          bool accumulate);
+void sgd_step(float *data, const float *grad, float learning_rate, long n);
+void adam_step(float *data, const float *grad, float *m, float *v,
+               float learning_rate, float beta_1, float beta_2, float eps,
+               float bias_correction_1, float bias_correction_2, long n);
+void unary(UnaryOp op, const float *in, float *out, long n, bool fast);
+void unary_backward(UnaryOp op, const float *grad, const float *in,
+                    const float *out, float *target, long n);
+void reduce(ReduceOp op, const Reduction &reduction, const float *in,
+            const float *center, float *out);
+void arg_reduce(bool max, const Reduction &reduction, const float *in,
+                float *out, int *indices);
+void reduce_backward(const Reduction &reduction, const float *coef,
+                     const float *in, const float *center, float *grad_in);
+void softmax(const SoftmaxDims &dims, const float *in, float *out, bool log);
+void softmax_backward(const SoftmaxDims &dims, const float *grad,
+                      const float *out, float *grad_in, bool log);
+void cross_entropy(const SoftmaxDims &dims, const float *logits,
+                   const float *target, float smoothing, float *loss,
+                   float *log_sum);
+void cross_entropy_backward(const SoftmaxDims &dims, const float *grad,
+                            const float *logits, const float *target,
+                            float smoothing, const float *log_sum,
+                            float *logits_grad, float *target_grad);
+void cross_entropy_classes(const SoftmaxDims &dims, const float *logits,
+                           const int *classes, float smoothing, float *loss,
+                           float *log_sum);
+void cross_entropy_classes_backward(const SoftmaxDims &dims, const float *grad,
+                                    const float *logits, const int *classes,
+                                    float smoothing, const float *log_sum,
+                                    float *logits_grad);
+void loss(LossOp op, const float *input, const float *target, float delta,
+          float *out, long n);
+float loss_sum(LossOp op, const float *input, const float *target,
+               float delta, long n);
+void loss_backward(LossOp op, const float *grad, long grad_stride,
+                   const float *input, const float *target, float delta,
+                   float *input_grad, float *target_grad, long n);
+void gemm_bias_activation(int m, int n, int k, const float *a, int a_row,
+                          int a_col, const float *b, int b_row, int b_col,
+                          const float *bias, Activation activation, float *c,
+                          int ldc, float *pre, bool fast);
+void activation_backward(int m, int n, Activation activation,
+                         const float *grad, const float *out, const float *pre,
+                         float *grad_pre, float *bias_grad);
+
+} // namespace CPU_CAPABILITY
+#endif
+
+} // namespace kernels
+
+#endif // CPU_KERNELS_H
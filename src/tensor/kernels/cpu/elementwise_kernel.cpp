@@ -0,0 +1,257 @@
+#include "cpu_kernels.h"
+#include "vec.h"
+
+namespace kernels {
+namespace CPU_CAPABILITY {
+
+namespace {
+
+template <typename T> T splat(float x) { return x; }
+template <> Vec splat<Vec>(float x) { return Vec::broadcast(x); }
+
+// Each op is written once for Vec and for the float tails and strided runs.
+// The float versions mirror kernels::apply and apply_grad, which are not used
+// here so that no inline function of a shared header is compiled with this
+// file's instruction set. The backward of an operand ignores a or b where
+// reads(operand, which) is false, and they may then be null.
+struct Add {
+  static constexpr bool reads(int, int) { return false; }
+  template <typename T> static T forward(T a, T b) { return a + b; }
+  template <typename T> static T backward(int, T grad, T, T) { return grad; }
+};
+
+struct Sub {
+  static constexpr bool reads(int, int) { return false; }
+  template <typename T> static T forward(T a, T b) { return a - b; }
+  template <typename T>
+  static T backward(int operand, T grad, T, T) {
+    return operand == 0 ? grad : splat<T>(0.0f) - grad;
+  }
+};
+
+struct Mul {
+  static constexpr bool reads(int operand, int which) {
+    return operand != which;
+  }
+  template <typename T> static T forward(T a, T b) { return a * b; }
+  template <typename T>
+  static T backward(int operand, T grad, T a, T b) {
+    return operand == 0 ? grad * b : grad * a;
+  }
+};
+
+struct Div {
+  static constexpr bool reads(int operand, int which) {
+    return operand == 1 || which == 1;
+  }
+  template <typename T> static T forward(T a, T b) {
+    return a / (b + splat<T>(EPS));
+  }
+  template <typename T>
+  static T backward(int operand, T grad, T a, T b) {
+    T denominator = b + splat<T>(EPS);
+    if (operand == 0)
+      return grad / denominator;
+    return splat<T>(0.0f) - grad * a / (denominator * denominator);
+  }
+};
+
+// A broadcast operand has stride 0 within the run and is splatted once.
+template <bool broadcast> inline Vec load(const float *p, int i) {
+  if (broadcast)
+    return Vec::broadcast(p[0]);
+  return Vec::load(p + i);
+}
+
+// An operand of the backward, which is not loaded unless it is read.
+template <bool read, bool broadcast> inline Vec saved(const float *p, int i) {
+  if constexpr (!read)
+    return Vec::zero();
+  else
+    return load<broadcast>(p, i);
+}
+
+template <bool read> inline float saved(const float *p, int i, int stride) {
+  if constexpr (!read)
+    return 0.0f;
+  else
+    return p[i * stride];
+}
+
+template <typename Op, bool broadcast_a, bool broadcast_b>
+int forward_loop(const float *a, const float *b, float *out, int n) {
+  int i = 0;
+  for (; i + Vec::size <= n; i += Vec::size)
+    Op::forward(load<broadcast_a>(a, i), load<broadcast_b>(b, i))
+        .store(out + i);
+  return i;
+}
+
+template <typename Op, int operand, bool broadcast_a, bool broadcast_b>
+int backward_loop(const float *grad, const float *a, const float *b,
+                  float *target, int n) {
+  constexpr bool read_a = Op::reads(operand, 0);
+  constexpr bool read_b = Op::reads(operand, 1);
+  int i = 0;
+  for (; i + Vec::size <= n; i += Vec::size) {
+    Vec contribution = Op::backward(operand, Vec::load(grad + i),
+                                    saved<read_a, broadcast_a>(a, i),
+                                    saved<read_b, broadcast_b>(b, i));
+    (Vec::load(target + i) + contribution).store(target + i);
+  }
+  return i;
+}
+
+template <typename Op, int operand, bool broadcast_a, bool broadcast_b>
+int sum_loop(const float *grad, const float *a, const float *b, int n,
+             float &sum) {
+  constexpr bool read_a = Op::reads(operand, 0);
+  constexpr bool read_b = Op::reads(operand, 1);
+  // Two accumulators hide the latency of the dependent adds.
+  Vec first = Vec::zero(), second = Vec::zero();
+  int i = 0;
+  for (; i + 2 * Vec::size <= n; i += 2 * Vec::size) {
+    first = first + Op::backward(operand, Vec::load(grad + i),
+                                 saved<read_a, broadcast_a>(a, i),
+                                 saved<read_b, broadcast_b>(b, i));
+    int j = i + Vec::size;
+    second = second + Op::backward(operand, Vec::load(grad + j),
+                                   saved<read_a, broadcast_a>(a, j),
+                                   saved<read_b, broadcast_b>(b, j));
+  }
+  for (; i + Vec::size <= n; i += Vec::size)
+    first = first + Op::backward(operand, Vec::load(grad + i),
+                                 saved<read_a, broadcast_a>(a, i),
+                                 saved<read_b, broadcast_b>(b, i));
+  sum = (first + second).sum();
+  return i;
+}
+
+template <typename Op>
+void forward_run(const float *a, int stride_a, const float *b, int stride_b,
+                 float *out, int n) {
+  int done = 0;
+  if (stride_a == 1 && stride_b == 1)
+    done = forward_loop<Op, false, false>(a, b, out, n);
+  else if (stride_a == 0 && stride_b == 1)
+    done = forward_loop<Op, true, false>(a, b, out, n);
+  else if (stride_a == 1 && stride_b == 0)
+    done = forward_loop<Op, false, true>(a, b, out, n);
+  for (int i = done; i < n; i++)
+    out[i] = Op::forward(a[i * stride_a], b[i * stride_b]);
+}
+
+template <typename Op, int operand>
+void backward_run(const float *grad, const float *a, int stride_a,
+                  const float *b, int stride_b, float *target,
+                  int stride_target, int n) {
+  constexpr bool read_a = Op::reads(operand, 0);
+  constexpr bool read_b = Op::reads(operand, 1);
+  int done = 0;
+  if (stride_target == 1) {
+    if (stride_a == 1 && stride_b == 1)
+      done = backward_loop<Op, operand, false, false>(grad, a, b, target, n);
+    else if (stride_a == 0 && stride_b == 1)
+      done = backward_loop<Op, operand, true, false>(grad, a, b, target, n);
+    else if (stride_a == 1 && stride_b == 0)
+      done = backward_loop<Op, operand, false, true>(grad, a, b, target, n);
+  }
+  for (int i = done; i < n; i++)
+    target[i * stride_target] +=
+        Op::backward(operand, grad[i], saved<read_a>(a, i, stride_a),
+                     saved<read_b>(b, i, stride_b));
+}
+
+template <typename Op, int operand>
+float sum_run(const float *grad, const float *a, int stride_a, const float *b,
+              int stride_b, int n) {
+  constexpr bool read_a = Op::reads(operand, 0);
+  constexpr bool read_b = Op::reads(operand, 1);
+  float sum = 0;
+  int done = 0;
+  if (stride_a == 1 && stride_b == 1)
+    done = sum_loop<Op, operand, false, false>(grad, a, b, n, sum);
+  else if (stride_a == 0 && stride_b == 1)
+    done = sum_loop<Op, operand, true, false>(grad, a, b, n, sum);
+  else if (stride_a == 1 && stride_b == 0)
+    done = sum_loop<Op, operand, false, true>(grad, a, b, n, sum);
+  for (int i = done; i < n; i++)
+    sum += Op::backward(operand, grad[i], saved<read_a>(a, i, stride_a),
+                        saved<read_b>(b, i, stride_b));
+  return sum;
+}
+
+// The operand is a template argument so that the loops only load what its
+// gradient reads.
+template <typename Op>
+void backward_run(int operand, const float *grad, const float *a,
+                  int stride_a, const float *b, int stride_b, float *target,
+                  int stride_target, int n) {
+  if (operand == 0)
+    return backward_run<Op, 0>(grad, a, stride_a, b, stride_b, target,
+                               stride_target, n);
+  return backward_run<Op, 1>(grad, a, stride_a, b, stride_b, target,
+                             stride_target, n);
+}
+
+template <typename Op>
+float sum_run(int operand, const float *grad, const float *a, int stride_a,
+              const float *b, int stride_b, int n) {
+  if (operand == 0)
+    return sum_run<Op, 0>(grad, a, stride_a, b, stride_b, n);
+  return sum_run<Op, 1>(grad, a, stride_a, b, stride_b, n);
+}
+
+} // namespace
+
+void binary(BinaryOp op, const float *a, int stride_a, const float *b,
+            int stride_b, float *out, int n) {
+  switch (op) {
+  case BinaryOp::Add:
+    return forward_run<Add>(a, stride_a, b, stride_b, out, n);
+  case BinaryOp::Sub:
+    return forward_run<Sub>(a, stride_a, b, stride_b, out, n);
+  case BinaryOp::Mul:
+    return forward_run<Mul>(a, stride_a, b, stride_b, out, n);
+  case BinaryOp::Div:
+    return forward_run<Div>(a, stride_a, b, stride_b, out, n);
+  }
+}
+
+void binary_backward(BinaryOp op, int operand, const float *grad,
+                     const float *a, int stride_a, const float *b,
+                     int stride_b, float *target, int stride_target, int n) {
+  switch (op) {
+  case BinaryOp::Add:
+    return backward_run<Add>(operand, grad, a, stride_a, b, stride_b, target,
+                             stride_target, n);
+  case BinaryOp::Sub:
+    return backward_run<Sub>(operand, grad, a, stride_a, b, stride_b, target,
+                             stride_target, n);
+  case BinaryOp::Mul:
+    return backward_run<Mul>(operand, grad, a, stride_a, b, stride_b, target,
+                             stride_target, n);
+  case BinaryOp::Div:
+    return backward_run<Div>(operand, grad, a, stride_a, b, stride_b, target,
+                             stride_target, n);
+  }
+}
+
+float binary_backward_sum(BinaryOp op, int operand, const float *grad,
+                          const float *a, int stride_a, const float *b,
+                          int stride_b, int n) {
+  switch (op) {
+  case BinaryOp::Add:
+    return sum_run<Add>(operand, grad, a, stride_a, b, stride_b, n);
+  case BinaryOp::Sub:
+    return sum_run<Sub>(operand, grad, a, stride_a, b, stride_b, n);
+  case BinaryOp::Mul:
+    return sum_run<Mul>(operand, grad, a, stride_a, b, stride_b, n);
+  case BinaryOp::Div:
+    return sum_run<Div>(operand, grad, a, stride_a, b, stride_b, n);
+  }
+  return 0;
+}
+
+} // namespace CPU_CAPABILITY
+} // namespace kernels
@@ -0,0 +1,553 @@
+#include "../../parallel/parallel.h"
+#include "../gemm_tuning.h"
+#include "../loop.h"
+#include "cpu_kernels.h"
+#include "vec.h"
+#include "vec_math.h"
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+// Blocking in the style of BLIS: B is packed in KC x NC panels that stay in
+// L3, A in MC x KC blocks that stay in L2, and the micro-kernel keeps an
+// MR x NR tile of C in registers while streaming both packed panels. KC, MC,
+// NC and the grain are defaults for shapes without a tuned GemmBlocking.
+#if defined(__AVX512F__)
+#define GEMM_MR 14
+#else
+#define GEMM_MR 6
+#endif
+#define GEMM_NR (2 * Vec::size)
+#define GEMM_KC 256
+#define GEMM_MC (GEMM_MR * 16)
+#define GEMM_NC 3072
+
+// Every thread gets at least this many multiply-adds.
+#define GEMM_GRAIN_WORK (1 << 17)
+
+// Products with at most this many rows, or this many multiply-adds, skip
+// the packing when the rows of B are contiguous.
+#define GEMM_SMALL_ROWS 4
+#define GEMM_SMALL_WORK (1 << 15)
+
+namespace kernels {
+namespace CPU_CAPABILITY {
+
+namespace {
+
+constexpr int MR = GEMM_MR;
+constexpr int NR = GEMM_NR;
+
+// Packs an mc x kc block of A into MR-row panels, each stored column by
+// column, padding the last panel with zeros.
+void pack_a(int mc, int kc, const float *a, int a_row, int a_col,
+            float *packed) {
+  for (int i = 0; i < mc; i += MR) {
+    int rows = std::min(MR, mc - i);
+    const float *src = a + i * a_row;
+    if (a_row == 1 && rows == MR) {
+      // Transposed A: the MR values of each column are contiguous.
+      for (int p = 0; p < kc; p++)
+        std::memcpy(packed + p * MR, src + p * a_col, MR * sizeof(float));
+    } else if (a_col == 1) {
+      for (int r = 0; r < rows; r++) {
+        const float *row = src + r * a_row;
+        for (int p = 0; p < kc; p++)
+          packed[p * MR + r] = row[p];
+      }
+      for (int r = rows; r < MR; r++)
+        for (int p = 0; p < kc; p++)
+          packed[p * MR + r] = 0;
+    } else {
+      for (int p = 0; p < kc; p++)
+        for (int r = 0; r < MR; r++)
+          packed[p * MR + r] = r < rows ? src[r * a_row + p * a_col] : 0;
+    }
+    packed += MR * kc;
+  }
+}
+
+// Packs a kc x nc panel of B into NR-column slivers, each stored row by row,
+// padding the last sliver with zeros.
+void pack_b(int kc, int nc, const float *b, int b_row, int b_col,
+            float *packed) {
+  for (int j = 0; j < nc; j += NR) {
+    int columns = std::min(NR, nc - j);
+    const float *src = b + j * b_col;
+    if (b_col == 1 && columns == NR) {
+      for (int p = 0; p < kc; p++)
+        std::memcpy(packed + p * NR, src + p * b_row, NR * sizeof(float));
+    } else if (b_row == 1) {
+      // Transposed B: each column is contiguous along k.
+      for (int c = 0; c < columns; c++) {
+        const float *column = src + c * b_col;
+        for (int p = 0; p < kc; p++)
+          packed[p * NR + c] = column[p];
+      }
+      for (int c = columns; c < NR; c++)
+        for (int p = 0; p < kc; p++)
+          packed[p * NR + c] = 0;
+    } else {
+      for (int p = 0; p < kc; p++)
+        for (int c = 0; c < NR; c++)
+          packed[p * NR + c] = c < columns ? src[p * b_row + c * b_col] : 0;
+    }
+    packed += NR * kc;
+  }
+}
+
+// The first count values at p, zero-padded, or a whole vector when count is
+// at least Vec::size.
+Vec load_columns(const float *p, long count) {
+  if (count >= Vec::size)
+    return Vec::load(p);
+  float buffer[Vec::size] = {};
+  for (long k = 0; k < count; k++)
+    buffer[k] = p[k];
+  return Vec::load(buffer);
+}
+
+void store_columns(Vec v, float *p, long count) {
+  if (count >= Vec::size)
+    return v.store(p);
+  float buffer[Vec::size];
+  v.store(buffer);
+  for (long k = 0; k < count; k++)
+    p[k] = buffer[k];
+}
+
+// What gemm_bias_activation does to C after the last block of k: add the
+// bias, store the sum to pre for Gelu, and apply the activation.
+struct Epilogue {
+  const float *bias = nullptr;
+  Activation activation = Activation::None;
+  float *pre = nullptr;
+  bool fast = false;
+};
+
+template <bool fast> Vec activate(Activation activation, Vec x) {
+  switch (activation) {
+  case Activation::None:
+    return x;
+  case Activation::ReLU:
+    return max(x, Vec::zero());
+  case Activation::Tanh:
+    return tanh<fast>(x);
+  case Activation::Gelu:
+    return gelu<fast>(x);
+  }
+  return x;
+}
+
+// Applies the epilogue to one register of C, whose pre-activation value goes
+// to pre when that is set.
+Vec finish(const Epilogue &epilogue, Vec x, Vec bias, float *pre) {
+  x = x + bias;
+  if (pre != nullptr)
+    x.store(pre);
+  return epilogue.fast ? activate<true>(epilogue.activation, x)
+                       : activate<false>(epilogue.activation, x);
+}
+
+// C[MR x NR] (+)= packed A sliver * packed B sliver, then the epilogue if
+// there is one, with bias holding the NR values for these columns and pre
+// sharing the leading dimension of C.
+void micro_kernel(int kc, const float *a, const float *b, float *c, int ldc,
+                  bool accumulate, const Epilogue *epilogue = nullptr,
+                  const float *bias = nullptr, float *pre = nullptr) {
+  Vec low[MR], high[MR];
+  for (int i = 0; i < MR; i++) {
+    low[i] = Vec::zero();
+    high[i] = Vec::zero();
+  }
+  for (int p = 0; p < kc; p++) {
+    Vec b_low = Vec::load(b);
+    Vec b_high = Vec::load(b + Vec::size);
+    for (int i = 0; i < MR; i++) {
+      Vec a_value = Vec::broadcast(a[i]);
+      low[i] = fmadd(a_value, b_low, low[i]);
+      high[i] = fmadd(a_value, b_high, high[i]);
+    }
+    a += MR;
+    b += NR;
+  }
+  Vec bias_low = bias != nullptr ? Vec::load(bias) : Vec::zero();
+  Vec bias_high = bias != nullptr ? Vec::load(bias + Vec::size) : Vec::zero();
+  for (int i = 0; i < MR; i++) {
+    float *row = c + i * ldc;
+    if (accumulate) {
+      low[i] = low[i] + Vec::load(row);
+      high[i] = high[i] + Vec::load(row + Vec::size);
+    }
+    if (epilogue != nullptr) {
+      float *pre_row = pre != nullptr ? pre + i * ldc : nullptr;
+      low[i] = finish(*epilogue, low[i], bias_low, pre_row);
+      high[i] = finish(*epilogue, high[i], bias_high,
+                       pre_row != nullptr ? pre_row + Vec::size : nullptr);
+    }
+    low[i].store(row);
+    high[i].store(row + Vec::size);
+  }
+}
+
+// Edge tiles go through full-size scratch tiles, with the bias padded.
+void edge_kernel(int mr, int nr, int kc, const float *a, const float *b,
+                 float *c, int ldc, bool accumulate,
+                 const Epilogue *epilogue = nullptr,
+                 const float *bias = nullptr, float *pre = nullptr) {
+  float tile[MR * NR];
+  float pre_tile[MR * NR];
+  float bias_tile[NR] = {};
+  for (int i = 0; accumulate && i < MR; i++)
+    for (int j = 0; j < NR; j++)
+      tile[i * NR + j] = i < mr && j < nr ? c[i * ldc + j] : 0.0f;
+  for (int j = 0; bias != nullptr && j < nr; j++)
+    bias_tile[j] = bias[j];
+  micro_kernel(kc, a, b, tile, NR, accumulate, epilogue,
+               bias != nullptr ? bias_tile : nullptr,
+               pre != nullptr ? pre_tile : nullptr);
+  for (int i = 0; i < mr; i++) {
+    for (int j = 0; j < nr; j++) {
+      c[i * ldc + j] = tile[i * NR + j];
+      if (pre != nullptr)
+        pre[i * ldc + j] = pre_tile[i * NR + j];
+    }
+  }
+}
+
+// The epilogue, if any, has its bias and pre offset to this block of C.
+void macro_kernel(int mc, int nc, int kc, const float *packed_a,
+                  const float *packed_b, float *c, int ldc, bool accumulate,
+                  const Epilogue *epilogue, long grain_work) {
+  int panels = (nc + NR - 1) / NR;
+  int row_tiles = (mc + MR - 1) / MR;
+  long grain = std::max<long>(1, grain_work / (MR * NR * kc));
+  // Consecutive tiles share a B sliver, which stays in L1 between them.
+  parallel::parallel_for(0, panels * row_tiles, grain, [&](long begin,
+                                                          long end) {
+    for (long tile = begin; tile < end; tile++) {
+      int j = tile / row_tiles * NR;
+      int i = tile % row_tiles * MR;
+      int nr = std::min(NR, nc - j);
+      int mr = std::min(MR, mc - i);
+      const float *a = packed_a + i * kc;
+      const float *b = packed_b + j * kc;
+      const float *bias = nullptr;
+      float *pre = nullptr;
+      if (epilogue != nullptr && epilogue->bias != nullptr)
+        bias = epilogue->bias + j;
+      if (epilogue != nullptr && epilogue->pre != nullptr)
+        pre = epilogue->pre + i * ldc + j;
+      if (mr == MR && nr == NR)
+        micro_kernel(kc, a, b, c + i * ldc + j, ldc, accumulate, epilogue,
+                     bias, pre);
+      else
+        edge_kernel(mr, nr, kc, a, b, c + i * ldc + j, ldc, accumulate,
+                    epilogue, bias, pre);
+    }
+  });
+}
+
+// Vector-matrix and other small products read each element of B about once,
+// so packing would only add a copy of B. For each strip of W vectors of
+// columns, every row of C is kept in registers while the strip of B, which
+// stays in L2, streams past. count is the number of columns in the strip,
+// less than W * Vec::size only for a final W = 1 strip.
+template <int W>
+void strip_kernel(int m, int k, const float *a, int a_row, int a_col,
+                  const float *b, int b_row, float *c, int ldc, long count,
+                  bool accumulate, const Epilogue *epilogue,
+                  const float *bias, float *pre) {
+  for (int i = 0; i < m; i++) {
+    Vec sums[W];
+    for (int q = 0; q < W; q++)
+      sums[q] = Vec::zero();
+    const float *a_row_i = a + (long)i * a_row;
+    for (int p = 0; p < k; p++) {
+      Vec a_value = Vec::broadcast(a_row_i[(long)p * a_col]);
+      const float *b_row_p = b + (long)p * b_row;
+      for (int q = 0; q < W; q++)
+        sums[q] = fmadd(a_value, load_columns(b_row_p + q * Vec::size,
+                                              count - q * Vec::size),
+                        sums[q]);
+    }
+    for (int q = 0; q < W; q++) {
+      long lanes = std::min<long>(Vec::size, count - q * Vec::size);
+      float *out = c + (long)i * ldc + q * Vec::size;
+      Vec value = sums[q];
+      if (accumulate)
+        value = value + load_columns(out, lanes);
+      if (epilogue != nullptr) {
+        float pre_lanes[Vec::size];
+        Vec bias_value = bias != nullptr
+                             ? load_columns(bias + q * Vec::size, lanes)
+                             : Vec::zero();
+        value = finish(*epilogue, value, bias_value,
+                       pre != nullptr ? pre_lanes : nullptr);
+        if (pre != nullptr)
+          store_columns(Vec::load(pre_lanes),
+                        pre + (long)i * ldc + q * Vec::size, lanes);
+      }
+      store_columns(value, out, lanes);
+    }
+  }
+}
+
+void small_gemm(int m, int n, int k, const float *a, int a_row, int a_col,
+                const float *b, int b_row, float *c, int ldc, bool accumulate,
+                const Epilogue *epilogue) {
+  constexpr int W = 4;
+  constexpr long width = W * Vec::size;
+  long strips = (n + width - 1) / width;
+  long grain = std::max<long>(1, GEMM_GRAIN_WORK / ((long)m * k * width + 1));
+  parallel::parallel_for(0, strips, grain, [&](long begin, long end) {
+    for (long j = begin * width; j < std::min<long>(end * width, n);) {
+      long count = std::min<long>(n - j, width);
+      const float *bias = nullptr;
+      float *pre = nullptr;
+      if (epilogue != nullptr && epilogue->bias != nullptr)
+        bias = epilogue->bias + j;
+      if (epilogue != nullptr && epilogue->pre != nullptr)
+        pre = epilogue->pre + j;
+      if (count == width) {
+        strip_kernel<W>(m, k, a, a_row, a_col, b + j, b_row, c + j, ldc,
+                        count, accumulate, epilogue, bias, pre);
+      } else {
+        count = std::min<long>(count, Vec::size);
+        strip_kernel<1>(m, k, a, a_row, a_col, b + j, b_row, c + j, ldc,
+                        count, accumulate, epilogue, bias, pre);
+      }
+      j += count;
+    }
+  });
+}
+
+// Matrix-vector products with contiguous rows of A and a contiguous B are
+// dot products along k.
+void dot_gemm(int m, int k, const float *a, int a_row, const float *b,
+              float *c, int ldc, bool accumulate, const Epilogue *epilogue) {
+  long grain = std::max<long>(1, GEMM_GRAIN_WORK / ((long)k + 1));
+  parallel::parallel_for(0, m, grain, [&](long begin, long end) {
+    for (long i = begin; i < end; i++) {
+      const float *row = a + i * a_row;
+      Vec first = Vec::zero();
+      Vec second = Vec::zero();
+      long p = 0;
+      for (; p + 2 * Vec::size <= k; p += 2 * Vec::size) {
+        first = fmadd(Vec::load(row + p), Vec::load(b + p), first);
+        second = fmadd(Vec::load(row + p + Vec::size),
+                       Vec::load(b + p + Vec::size), second);
+      }
+      for (; p < k; p += Vec::size)
+        first = fmadd(load_columns(row + p, k - p), load_columns(b + p, k - p),
+                      first);
+      float value = (first + second).sum();
+      if (accumulate)
+        value += c[i * ldc];
+      if (epilogue != nullptr) {
+        float lanes[Vec::size];
+        float pre[Vec::size];
+        Vec bias = epilogue->bias != nullptr
+                       ? Vec::broadcast(*epilogue->bias)
+                       : Vec::zero();
+        finish(*epilogue, Vec::broadcast(value), bias,
+               epilogue->pre != nullptr ? pre : nullptr)
+            .store(lanes);
+        if (epilogue->pre != nullptr)
+          epilogue->pre[i * ldc] = pre[0];
+        value = lanes[0];
+      }
+      c[i * ldc] = value;
+    }
+  });
+}
+
+// With k = 0 the product is zero and only the epilogue is left.
+void epilogue_only(int m, int n, float *c, int ldc,
+                   const Epilogue &epilogue) {
+  for (int i = 0; i < m; i += MR) {
+    for (int j = 0; j < n; j += NR) {
+      const float *bias = epilogue.bias ? epilogue.bias + j : nullptr;
+      float *pre = epilogue.pre ? epilogue.pre + i * ldc + j : nullptr;
+      edge_kernel(std::min(MR, m - i), std::min(NR, n - j), 0, nullptr,
+                  nullptr, c + i * ldc + j, ldc, false, &epilogue, bias, pre);
+    }
+  }
+}
+
+void blocked_gemm(int m, int n, int k, const float *a, int a_row, int a_col,
+                  const float *b, int b_row, int b_col, float *c, int ldc,
+                  bool accumulate, const Epilogue *epilogue) {
+  if (m == 0 || n == 0)
+    return;
+  if (k == 0 && epilogue != nullptr) {
+    epilogue_only(m, n, c, ldc, *epilogue);
+    return;
+  }
+  if (k == 0) {
+    for (int i = 0; !accumulate && i < m; i++)
+      for (int j = 0; j < n; j++)
+        c[i * ldc + j] = 0.0f;
+    return;
+  }
+  if (n == 1 && a_col == 1 && b_row == 1) {
+    dot_gemm(m, k, a, a_row, b, c, ldc, accumulate, epilogue);
+    return;
+  }
+  bool small = m <= GEMM_SMALL_ROWS || (long)m * n * k <= GEMM_SMALL_WORK;
+  if (small && (b_col == 1 || n == 1)) {
+    small_gemm(m, n, k, a, a_row, a_col, b, b_row, c, ldc, accumulate,
+               epilogue);
+    return;
+  }
+
+  GemmBlocking blocking = gemm_blocking(m, n, k);
+  int block_k = blocking.kc > 0 ? blocking.kc : GEMM_KC;
+  int block_m = blocking.mc > 0 ? (blocking.mc + MR - 1) / MR * MR : GEMM_MC;
+  int block_n = blocking.nc > 0 ? (blocking.nc + NR - 1) / NR * NR : GEMM_NC;
+  long grain_work =
+      blocking.grain_work > 0 ? blocking.grain_work : GEMM_GRAIN_WORK;
+  int max_kc = std::min(k, block_k);
+  int max_mc = (std::min(m, block_m) + MR - 1) / MR * MR;
+  int max_nc = (std::min(n, block_n) + NR - 1) / NR * NR;
+  thread_local std::vector<float> packed_a, packed_b;
+  packed_a.resize((size_t)max_mc * max_kc);
+  packed_b.resize((size_t)max_nc * max_kc);
+
+  for (int jc = 0; jc < n; jc += block_n) {
+    int nc = std::min(block_n, n - jc);
+    for (int pc = 0; pc < k; pc += block_k) {
+      int kc = std::min(block_k, k - pc);
+      pack_b(kc, nc, b + pc * b_row + jc * b_col, b_row, b_col,
+             packed_b.data());
+      bool accumulate_block = accumulate || pc > 0;
+      bool last = pc + kc == k;
+      for (int ic = 0; ic < m; ic += block_m) {
+        int mc = std::min(block_m, m - ic);
+        pack_a(mc, kc, a + ic * a_row + pc * a_col, a_row, a_col,
+               packed_a.data());
+        Epilogue block;
+        if (epilogue != nullptr) {
+          block = *epilogue;
+          if (block.bias != nullptr)
+            block.bias += jc;
+          if (block.pre != nullptr)
+            block.pre += ic * ldc + jc;
+        }
+        macro_kernel(mc, nc, kc, packed_a.data(), packed_b.data(),
+                     c + ic * ldc + jc, ldc, accumulate_block,
+                     epilogue != nullptr && last ? &block : nullptr,
+                     grain_work);
+      }
+    }
+  }
+}
+
+// grad times the derivative of the activation, from its output or, for Gelu,
+// its input.
+Vec activation_grad(Activation activation, Vec grad, Vec out, Vec pre) {
+  switch (activation) {
+  case Activation::None:
+    return grad;
+  case Activation::ReLU:
+    return where_less(Vec::zero(), out, grad, Vec::zero());
+  case Activation::Tanh:
+    return grad * (constant(1.0f) - out * out);
+  case Activation::Gelu:
+    return grad * gelu_grad(pre);
+  }
+  return grad;
+}
+
+// activation_backward for the columns [begin, end) of rows rows, with the
+// column sums added to sums.
+void activation_backward_rows(int rows, int n, long begin, long end,
+                              Activation activation, const float *grad,
+                              const float *out, const float *pre,
+                              float *grad_pre, float *sums) {
+  for (long j = begin; j < end; j += Vec::size) {
+    long count = std::min<long>(Vec::size, end - j);
+    Vec sum = Vec::zero();
+    for (long offset = j; offset < (long)rows * n; offset += n) {
+      Vec x = pre != nullptr ? load_columns(pre + offset, count) : Vec::zero();
+      Vec y = out != nullptr ? load_columns(out + offset, count) : Vec::zero();
+      Vec g = activation_grad(activation, load_columns(grad + offset, count),
+                              y, x);
+      sum = sum + g;
+      if (grad_pre != nullptr)
+        store_columns(g, grad_pre + offset, count);
+    }
+    if (sums != nullptr) {
+      float lanes[Vec::size];
+      sum.store(lanes);
+      for (long k = 0; k < count; k++)
+        sums[j + k] += lanes[k];
+    }
+  }
+}
+
+} // namespace
+
+void gemm(int m, int n, int k, const float *a, int a_row, int a_col,
+          const float *b, int b_row, int b_col, float *c, int ldc,
+          bool accumulate) {
+  blocked_gemm(m, n, k, a, a_row, a_col, b, b_row, b_col, c, ldc, accumulate,
+               nullptr);
+}
+
+void gemm_bias_activation(int m, int n, int k, const float *a, int a_row,
+                          int a_col, const float *b, int b_row, int b_col,
+                          const float *bias, Activation activation, float *c,
+                          int ldc, float *pre, bool fast) {
+  Epilogue epilogue;
+  epilogue.bias = bias;
+  epilogue.activation = activation;
+  epilogue.pre = activation == Activation::Gelu ? pre : nullptr;
+  epilogue.fast = fast;
+  blocked_gemm(m, n, k, a, a_row, a_col, b, b_row, b_col, c, ldc, false,
+               &epilogue);
+}
+
+void activation_backward(int m, int n, Activation activation,
+                         const float *grad, const float *out, const float *pre,
+                         float *grad_pre, float *bias_grad) {
+  if (activation != Activation::Gelu)
+    pre = nullptr;
+  if (activation != Activation::ReLU && activation != Activation::Tanh)
+    out = nullptr;
+  // Column blocks go to different threads when there are enough of them;
+  // otherwise row blocks do, each summing into its own row of partials.
+  long columns = ((long)n + Vec::size - 1) / Vec::size;
+  long work = (long)m * n;
+  long threads = std::min<long>(parallel::get_num_threads(),
+                                work / TRANSCENDENTAL_GRAIN_SIZE);
+  if (columns >= threads || parallel::in_parallel_region()) {
+    long grain =
+        std::max<long>(1, TRANSCENDENTAL_GRAIN_SIZE / std::max(m, 1));
+    parallel::parallel_for(0, columns, grain, [&](long begin, long end) {
+      activation_backward_rows(m, n, begin * Vec::size,
+                               std::min<long>(end * Vec::size, n), activation,
+                               grad, out, pre, grad_pre, bias_grad);
+    });
+    return;
+  }
+  std::vector<float> partials(bias_grad != nullptr ? threads * n : 0);
+  parallel::parallel_for(0, threads, 1, [&](long begin, long end) {
+    for (long t = begin; t < end; t++) {
+      long first = m * t / threads;
+      long offset = first * n;
+      activation_backward_rows(
+          m * (t + 1) / threads - first, n, 0, n, activation, grad + offset,
+          out != nullptr ? out + offset : nullptr,
+          pre != nullptr ? pre + offset : nullptr,
+          grad_pre != nullptr ? grad_pre + offset : nullptr,
+          bias_grad != nullptr ? partials.data() + t * n : nullptr);
+    }
+  });
+  for (long t = 0; bias_grad != nullptr && t < threads; t++)
+    for (long j = 0; j < n; j++)
+      bias_grad[j] += partials[t * n + j];
+}
+
+} // namespace CPU_CAPABILITY
+} // namespace kernels
@@ -0,0 +1,213 @@
+#include "../../parallel/parallel.h"
+#include "../loop.h"
+#include "cpu_kernels.h"
+#include "vec.h"
+#include "vec_math.h"
+#include <algorithm>
+#include <vector>
+
+namespace kernels {
+namespace CPU_CAPABILITY {
+
+namespace {
+
+// log(1 + t) for t >= 0, accurate also where 1 + t rounds to 1: the rounding
+// of u = 1 + t is undone by the factor t / (u - 1).
+Vec log1p(Vec t) {
+  Vec u = constant(1.0f) + t;
+  Vec rounded = u - constant(1.0f);
+  Vec scaled = log_accurate(u) * t / rounded;
+  return where_less(Vec::zero(), rounded, scaled, t);
+}
+
+Vec clamped_log(Vec x) { return max(log_accurate(x), constant(-100.0f)); }
+
+Vec sign(Vec x) {
+  Vec one = constant(1.0f);
+  Vec positive = where_less(Vec::zero(), x, one, Vec::zero());
+  return where_less(x, Vec::zero(), Vec::zero() - one, positive);
+}
+
+Vec value(LossOp op, Vec x, Vec y, Vec delta) {
+  Vec d = x - y;
+  Vec one = constant(1.0f);
+  switch (op) {
+  case LossOp::BCE:
+    return Vec::zero() - fmadd(y, clamped_log(x),
+                               (one - y) * clamped_log(one - x));
+  case LossOp::BCEWithLogits:
+    return max(x, Vec::zero()) - x * y +
+           log1p(exp<false>(Vec::zero() - abs(x)));
+  case LossOp::MSE:
+    return d * d;
+  case LossOp::L1:
+    return abs(d);
+  case LossOp::Huber: {
+    Vec magnitude = abs(d);
+    Vec linear = delta * (magnitude - constant(0.5f) * delta);
+    return where_less(delta, magnitude, linear, constant(0.5f) * d * d);
+  }
+  }
+  return d;
+}
+
+Vec input_grad(LossOp op, Vec x, Vec y, Vec delta) {
+  Vec d = x - y;
+  switch (op) {
+  case LossOp::BCE:
+    return d / max(x * (constant(1.0f) - x), constant(1e-12f));
+  case LossOp::BCEWithLogits:
+    return sigmoid<false>(x) - y;
+  case LossOp::MSE:
+    return constant(2.0f) * d;
+  case LossOp::L1:
+    return sign(d);
+  case LossOp::Huber:
+    return max(Vec::zero() - delta, min(delta, d));
+  }
+  return d;
+}
+
+Vec target_grad(LossOp op, Vec x, Vec y, Vec delta) {
+  switch (op) {
+  case LossOp::BCE:
+    return clamped_log(constant(1.0f) - x) - clamped_log(x);
+  case LossOp::BCEWithLogits:
+    return Vec::zero() - x;
+  default:
+    return Vec::zero() - input_grad(op, x, y, delta);
+  }
+}
+
+Vec load_tail(const float *p, long n) {
+  float buffer[Vec::size] = {};
+  for (long k = 0; k < n; k++)
+    buffer[k] = p[k];
+  return Vec::load(buffer);
+}
+
+void store_tail(Vec v, float *p, long n) {
+  float buffer[Vec::size];
+  v.store(buffer);
+  for (long k = 0; k < n; k++)
+    p[k] = buffer[k];
+}
+
+long grain_size(LossOp op) {
+  bool transcendental = op == LossOp::BCE || op == LossOp::BCEWithLogits;
+  return transcendental ? TRANSCENDENTAL_GRAIN_SIZE : ELEMENTWISE_GRAIN_SIZE;
+}
+
+void loss_range(LossOp op, const float *x, const float *y, Vec delta,
+                float *out, long n) {
+  long i = 0;
+  for (; i + Vec::size <= n; i += Vec::size)
+    value(op, Vec::load(x + i), Vec::load(y + i), delta).store(out + i);
+  if (i < n)
+    store_tail(value(op, load_tail(x + i, n - i), load_tail(y + i, n - i),
+                     delta),
+               out + i, n - i);
+}
+
+float sum_range(LossOp op, const float *x, const float *y, Vec delta,
+                long n) {
+  // Two accumulators hide the latency of the dependent adds.
+  Vec first = Vec::zero();
+  Vec second = Vec::zero();
+  long i = 0;
+  for (; i + 2 * Vec::size <= n; i += 2 * Vec::size) {
+    first = first + value(op, Vec::load(x + i), Vec::load(y + i), delta);
+    second = second + value(op, Vec::load(x + i + Vec::size),
+                            Vec::load(y + i + Vec::size), delta);
+  }
+  for (; i + Vec::size <= n; i += Vec::size)
+    first = first + value(op, Vec::load(x + i), Vec::load(y + i), delta);
+  float result = (first + second).sum();
+  if (i == n)
+    return result;
+  // The padded lanes are left out of the sum.
+  float lanes[Vec::size];
+  value(op, load_tail(x + i, n - i), load_tail(y + i, n - i), delta)
+      .store(lanes);
+  for (long k = 0; i + k < n; k++)
+    result += lanes[k];
+  return result;
+}
+
+void backward_block(LossOp op, Vec g, Vec x, Vec y, Vec delta,
+                    float *x_grad, float *y_grad, long n) {
+  if (x_grad != nullptr) {
+    Vec sum = (n == Vec::size ? Vec::load(x_grad) : load_tail(x_grad, n)) +
+              g * input_grad(op, x, y, delta);
+    n == Vec::size ? sum.store(x_grad) : store_tail(sum, x_grad, n);
+  }
+  if (y_grad != nullptr) {
+    Vec sum = (n == Vec::size ? Vec::load(y_grad) : load_tail(y_grad, n)) +
+              g * target_grad(op, x, y, delta);
+    n == Vec::size ? sum.store(y_grad) : store_tail(sum, y_grad, n);
+  }
+}
+
+void backward_range(LossOp op, const float *grad, long grad_stride,
+                    const float *x, const float *y, Vec delta, float *x_grad,
+                    float *y_grad, long n) {
+  long i = 0;
+  for (; i < n; i += Vec::size) {
+    long count = std::min<long>(Vec::size, n - i);
+    bool full = count == Vec::size;
+    Vec g = grad_stride == 0 ? Vec::broadcast(*grad)
+            : full           ? Vec::load(grad + i)
+                             : load_tail(grad + i, count);
+    Vec xv = full ? Vec::load(x + i) : load_tail(x + i, count);
+    Vec yv = full ? Vec::load(y + i) : load_tail(y + i, count);
+    backward_block(op, g, xv, yv, delta, x_grad ? x_grad + i : nullptr,
+                   y_grad ? y_grad + i : nullptr, count);
+  }
+}
+
+} // namespace
+
+void loss(LossOp op, const float *input, const float *target, float delta,
+          float *out, long n) {
+  Vec d = Vec::broadcast(delta);
+  parallel::parallel_for(0, n, grain_size(op), [&](long begin, long end) {
+    loss_range(op, input + begin, target + begin, d, out + begin,
+               end - begin);
+  });
+}
+
+float loss_sum(LossOp op, const float *input, const float *target,
+               float delta, long n) {
+  Vec d = Vec::broadcast(delta);
+  long chunks =
+      std::min<long>(parallel::get_num_threads(), n / grain_size(op));
+  if (chunks <= 1 || parallel::in_parallel_region())
+    return sum_range(op, input, target, d, n);
+  std::vector<float> partials(chunks);
+  parallel::parallel_for(0, chunks, 1, [&](long begin, long end) {
+    for (long c = begin; c < end; c++) {
+      long first = n * c / chunks;
+      partials[c] = sum_range(op, input + first, target + first, d,
+                              n * (c + 1) / chunks - first);
+    }
+  });
+  float result = 0.0f;
+  for (float partial : partials)
+    result += partial;
+  return result;
+}
+
+void loss_backward(LossOp op, const float *grad, long grad_stride,
+                   const float *input, const float *target, float delta,
+                   float *input_grad, float *target_grad, long n) {
+  Vec d = Vec::broadcast(delta);
+  parallel::parallel_for(0, n, grain_size(op), [&](long begin, long end) {
+    backward_range(op, grad + begin * grad_stride, grad_stride,
+                   input + begin, target + begin, d,
+                   input_grad ? input_grad + begin : nullptr,
+                   target_grad ? target_grad + begin : nullptr, end - begin);
+  });
+}
+
+} // namespace CPU_CAPABILITY
+} // namespace kernels
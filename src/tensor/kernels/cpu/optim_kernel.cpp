@@ -0,0 +1,55 @@
+#include "../../parallel/parallel.h"
+#include "../loop.h"
+#include "cpu_kernels.h"
+#include "vec.h"
+#include <cmath>
+
+namespace kernels {
+namespace CPU_CAPABILITY {
+
+void sgd_step(float *data, const float *grad, float learning_rate, long n) {
+  parallel::parallel_for(0, n, ELEMENTWISE_GRAIN_SIZE, [&](long begin,
+                                                           long end) {
+    Vec rate = Vec::broadcast(-learning_rate);
+    long i = begin;
+    for (; i + Vec::size <= end; i += Vec::size)
+      fmadd(rate, Vec::load(grad + i), Vec::load(data + i)).store(data + i);
+    for (; i < end; i++)
+      data[i] -= learning_rate * grad[i];
+  });
+}
+
+void adam_step(float *data, const float *grad, float *m, float *v,
+               float learning_rate, float beta_1, float beta_2, float eps,
+               float bias_correction_1, float bias_correction_2, long n) {
+  // The bias corrections are folded into the step size and epsilon:
+  // lr * m_hat / (sqrt(v_hat) + eps) == step * m / (sqrt(v) + eps_hat).
+  float root = std::sqrt(bias_correction_2);
+  float step = learning_rate * root / bias_correction_1;
+  float eps_hat = eps * root;
+  parallel::parallel_for(0, n, ELEMENTWISE_GRAIN_SIZE, [&](long begin,
+                                                           long end) {
+    Vec b1 = Vec::broadcast(beta_1), b2 = Vec::broadcast(beta_2);
+    Vec c1 = Vec::broadcast(1 - beta_1), c2 = Vec::broadcast(1 - beta_2);
+    Vec vec_step = Vec::broadcast(step);
+    Vec vec_eps = Vec::broadcast(eps_hat);
+    long i = begin;
+    for (; i + Vec::size <= end; i += Vec::size) {
+      Vec g = Vec::load(grad + i);
+      Vec m_i = fmadd(b1, Vec::load(m + i), c1 * g);
+      Vec v_i = fmadd(b2, Vec::load(v + i), c2 * g * g);
+      m_i.store(m + i);
+      v_i.store(v + i);
+      Vec update = vec_step * m_i / (sqrt(v_i) + vec_eps);
+      (Vec::load(data + i) - update).store(data + i);
+    }
+    for (; i < end; i++) {
+      m[i] = beta_1 * m[i] + (1 - beta_1) * grad[i];
+      v[i] = beta_2 * v[i] + (1 - beta_2) * grad[i] * grad[i];
+      data[i] -= step * m[i] / (std::sqrt(v[i]) + eps_hat);
+    }
+  });
+}
+
+} // namespace CPU_CAPABILITY
+} // namespace kernels
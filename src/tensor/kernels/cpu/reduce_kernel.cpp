@@ -0,0 +1,353 @@
+#include "../../parallel/parallel.h"
+#include "../loop.h"
+#include "cpu_kernels.h"
+#include "vec.h"
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+namespace kernels {
+namespace CPU_CAPABILITY {
+
+namespace {
+
+struct Sum {
+  static constexpr float identity = 0.0f;
+  template <typename T> static T map(T x, T) { return x; }
+  static float combine(float a, float b) { return a + b; }
+  static Vec combine(Vec a, Vec b) { return a + b; }
+};
+
+struct SumSquares {
+  static constexpr float identity = 0.0f;
+  template <typename T> static T map(T x, T center) {
+    T deviation = x - center;
+    return deviation * deviation;
+  }
+  static float combine(float a, float b) { return a + b; }
+  static Vec combine(Vec a, Vec b) { return a + b; }
+};
+
+struct Max {
+  static constexpr float identity = std::numeric_limits<float>::lowest();
+  template <typename T> static T map(T x, T) { return x; }
+  static float combine(float a, float b) { return b > a ? b : a; }
+  static Vec combine(Vec a, Vec b) { return max(a, b); }
+};
+
+struct Min {
+  static constexpr float identity = std::numeric_limits<float>::max();
+  template <typename T> static T map(T x, T) { return x; }
+  static float combine(float a, float b) { return b < a ? b : a; }
+  static Vec combine(Vec a, Vec b) { return min(a, b); }
+};
+
+// Local copy of kernels::walk_offset: inline functions of shared headers must
+// not be compiled with this file's instruction set.
+long offset_of(const std::vector<int> &shape, const std::vector<int> &strides,
+               long index) {
+  long offset = 0;
+  for (int d = shape.size() - 1; d >= 0; d--) {
+    offset += index % shape[d] * strides[d];
+    index /= shape[d];
+  }
+  return offset;
+}
+
+template <typename Op> float horizontal(Vec v) {
+  float lanes[Vec::size];
+  v.store(lanes);
+  float result = lanes[0];
+  for (int i = 1; i < Vec::size; i++)
+    result = Op::combine(result, lanes[i]);
+  return result;
+}
+
+// Op over the n contiguous floats at p.
+template <typename Op> float reduce_run(const float *p, long n, float center) {
+  Vec c = Vec::broadcast(center);
+  // Two accumulators hide the latency of the dependent combines.
+  Vec first = Vec::broadcast(Op::identity), second = first;
+  long i = 0;
+  for (; i + 2 * Vec::size <= n; i += 2 * Vec::size) {
+    first = Op::combine(first, Op::map(Vec::load(p + i), c));
+    second = Op::combine(second, Op::map(Vec::load(p + i + Vec::size), c));
+  }
+  for (; i + Vec::size <= n; i += Vec::size)
+    first = Op::combine(first, Op::map(Vec::load(p + i), c));
+  float result = horizontal<Op>(Op::combine(first, second));
+  for (; i < n; i++)
+    result = Op::combine(result, Op::map(p[i], center));
+  return result;
+}
+
+// Row-major offsets of the first count positions of a walk over shape.
+std::vector<long> walk(const std::vector<int> &shape,
+                       const std::vector<int> &strides, long count) {
+  std::vector<long> offsets(count);
+  for (long i = 0; i < count; i++)
+    offsets[i] = offset_of(shape, strides, i);
+  return offsets;
+}
+
+// The reduced dimensions form a contiguous run of length `run` at each of
+// `starts`, relative to the input offset of the output.
+struct Runs {
+  long run;
+  std::vector<long> starts;
+};
+
+Runs inner_runs(const Reduction &reduction) {
+  std::vector<int> shape = reduction.reduced_shape;
+  std::vector<int> strides = reduction.reduced_strides;
+  long run = shape.back();
+  shape.pop_back();
+  strides.pop_back();
+  return {run, walk(shape, strides, reduction.size / run)};
+}
+
+// The innermost dimension is reduced: every output reduces contiguous runs.
+bool reduces_inner(const Reduction &reduction) {
+  return reduction.kept_shape.empty() || reduction.kept_strides.back() != 1;
+}
+
+// Calls segment(o, base, n) for outputs [o, o + n) whose inputs start at
+// base and are contiguous across the n outputs, covering [begin, end) without
+// crossing the innermost kept dimension.
+template <typename Segment>
+void for_each_segment(const Reduction &reduction, long begin, long end,
+                      Segment segment) {
+  std::vector<int> shape = reduction.kept_shape;
+  std::vector<int> strides = reduction.kept_strides;
+  long columns = shape.back();
+  shape.pop_back();
+  strides.pop_back();
+  for (long o = begin; o < end;) {
+    long column = o % columns;
+    long n = std::min(end - o, columns - column);
+    segment(o, offset_of(shape, strides, o / columns) + column, n);
+    o += n;
+  }
+}
+
+template <typename Op>
+void reduce_op(const Reduction &reduction, const float *in,
+               const float *center, float *out) {
+  long grain = ELEMENTWISE_GRAIN_SIZE / std::max<long>(1, reduction.size);
+  if (reduces_inner(reduction)) {
+    Runs runs = inner_runs(reduction);
+    if (reduction.outputs == 1 && runs.starts.size() == 1) {
+      // A full reduction of contiguous data: split the run itself.
+      long n = runs.run;
+      long chunks = std::min<long>(parallel::get_num_threads(),
+                                   n / ELEMENTWISE_GRAIN_SIZE);
+      float c = center ? center[0] : 0.0f;
+      if (chunks <= 1 || parallel::in_parallel_region()) {
+        out[0] = reduce_run<Op>(in, n, c);
+        return;
+      }
+      std::vector<float> partials(chunks);
+      parallel::parallel_for(0, chunks, 1, [&](long begin, long end) {
+        for (long i = begin; i < end; i++)
+          partials[i] = reduce_run<Op>(in + n * i / chunks,
+                                       n * (i + 1) / chunks - n * i / chunks,
+                                       c);
+      });
+      float result = Op::identity;
+      for (float partial : partials)
+        result = Op::combine(result, partial);
+      out[0] = result;
+      return;
+    }
+    parallel::parallel_for(
+        0, reduction.outputs, grain, [&](long begin, long end) {
+          for (long o = begin; o < end; o++) {
+            const float *base = in + offset_of(reduction.kept_shape,
+                                                 reduction.kept_strides, o);
+            float c = center ? center[o] : 0.0f;
+            float result = Op::identity;
+            for (long start : runs.starts)
+              result = Op::combine(result,
+                                   reduce_run<Op>(base + start, runs.run, c));
+            out[o] = result;
+          }
+        });
+    return;
+  }
+
+  // The innermost dimension is kept: combine whole rows of outputs at once.
+  auto positions = walk(reduction.reduced_shape, reduction.reduced_strides,
+                        reduction.size);
+  parallel::parallel_for(0, reduction.outputs, grain, [&](long begin,
+                                                          long end) {
+    for_each_segment(reduction, begin, end, [&](long o, long base, long n) {
+      float *result = out + o;
+      for (long j = 0; j < n; j++)
+        result[j] = Op::identity;
+      for (long position : positions) {
+        const float *row = in + base + position;
+        long j = 0;
+        for (; j + Vec::size <= n; j += Vec::size) {
+          Vec c = center ? Vec::load(center + o + j) : Vec::zero();
+          Op::combine(Vec::load(result + j), Op::map(Vec::load(row + j), c))
+              .store(result + j);
+        }
+        for (; j < n; j++)
+          result[j] = Op::combine(
+              result[j], Op::map(row[j], center ? center[o + j] : 0.0f));
+      }
+    });
+  });
+}
+
+template <typename Op>
+void arg_reduce_op(const Reduction &reduction, const float *in, float *out,
+                   int *indices) {
+  long grain = ELEMENTWISE_GRAIN_SIZE / std::max<long>(1, reduction.size);
+  if (reduces_inner(reduction)) {
+    Runs runs = inner_runs(reduction);
+    parallel::parallel_for(
+        0, reduction.outputs, grain, [&](long begin, long end) {
+          for (long o = begin; o < end; o++) {
+            const float *base = in + offset_of(reduction.kept_shape,
+                                                 reduction.kept_strides, o);
+            float best = Op::identity;
+            for (long start : runs.starts)
+              best = Op::combine(best, reduce_run<Op>(base + start, runs.run,
+                                                      0.0f));
+            // Second pass for the first position holding the best value.
+            int index = 0;
+            for (int q = 0; q < static_cast<int>(runs.starts.size()); q++) {
+              const float *run = base + runs.starts[q];
+              long j = 0;
+              while (j < runs.run && run[j] != best)
+                j++;
+              if (j < runs.run) {
+                index = q * runs.run + j;
+                break;
+              }
+            }
+            out[o] = best;
+            indices[o] = index;
+          }
+        });
+    return;
+  }
+
+  auto positions = walk(reduction.reduced_shape, reduction.reduced_strides,
+                        reduction.size);
+  parallel::parallel_for(0, reduction.outputs, grain, [&](long begin,
+                                                          long end) {
+    for_each_segment(reduction, begin, end, [&](long o, long base, long n) {
+      for (long j = 0; j < n; j++) {
+        out[o + j] = in[base + j];
+        indices[o + j] = 0;
+      }
+      for (int p = 1; p < static_cast<int>(positions.size()); p++) {
+        const float *row = in + base + positions[p];
+        for (long j = 0; j < n; j++) {
+          if (Op::combine(out[o + j], row[j]) != out[o + j]) {
+            out[o + j] = row[j];
+            indices[o + j] = p;
+          }
+        }
+      }
+    });
+  });
+}
+
+// target[i] += coef * (in[i] - center), or += coef without in, for i < n.
+void backward_run(float *target, const float *in, float coef, float center,
+                  long n) {
+  Vec c = Vec::broadcast(coef);
+  long i = 0;
+  if (in == nullptr) {
+    for (; i + Vec::size <= n; i += Vec::size)
+      (Vec::load(target + i) + c).store(target + i);
+    for (; i < n; i++)
+      target[i] += coef;
+    return;
+  }
+  Vec shift = Vec::broadcast(center);
+  for (; i + Vec::size <= n; i += Vec::size)
+    fmadd(c, Vec::load(in + i) - shift, Vec::load(target + i))
+        .store(target + i);
+  for (; i < n; i++)
+    target[i] += coef * (in[i] - center);
+}
+
+} // namespace
+
+void reduce(ReduceOp op, const Reduction &reduction, const float *in,
+            const float *center, float *out) {
+  switch (op) {
+  case ReduceOp::Sum:
+    return reduce_op<Sum>(reduction, in, center, out);
+  case ReduceOp::SumSquares:
+    return reduce_op<SumSquares>(reduction, in, center, out);
+  case ReduceOp::Max:
+    return reduce_op<Max>(reduction, in, center, out);
+  case ReduceOp::Min:
+    return reduce_op<Min>(reduction, in, center, out);
+  }
+}
+
+void arg_reduce(bool max, const Reduction &reduction, const float *in,
+                float *out, int *indices) {
+  if (max)
+    arg_reduce_op<Max>(reduction, in, out, indices);
+  else
+    arg_reduce_op<Min>(reduction, in, out, indices);
+}
+
+void reduce_backward(const Reduction &reduction, const float *coef,
+                     const float *in, const float *center, float *grad_in) {
+  long grain = ELEMENTWISE_GRAIN_SIZE / std::max<long>(1, reduction.size);
+  if (reduces_inner(reduction)) {
+    Runs runs = inner_runs(reduction);
+    parallel::parallel_for(
+        0, reduction.outputs, grain, [&](long begin, long end) {
+          for (long o = begin; o < end; o++) {
+            long base = offset_of(reduction.kept_shape,
+                                    reduction.kept_strides, o);
+            float c = center ? center[o] : 0.0f;
+            for (long start : runs.starts)
+              backward_run(grad_in + base + start,
+                           in ? in + base + start : nullptr, coef[o], c,
+                           runs.run);
+          }
+        });
+    return;
+  }
+
+  auto positions = walk(reduction.reduced_shape, reduction.reduced_strides,
+                        reduction.size);
+  parallel::parallel_for(0, reduction.outputs, grain, [&](long begin,
+                                                          long end) {
+    for_each_segment(reduction, begin, end, [&](long o, long base, long n) {
+      for (long position : positions) {
+        float *target = grad_in + base + position;
+        const float *row = in ? in + base + position : nullptr;
+        long j = 0;
+        for (; j + Vec::size <= n; j += Vec::size) {
+          Vec c = Vec::load(coef + o + j);
+          Vec term = c;
+          if (row != nullptr) {
+            Vec shift = center ? Vec::load(center + o + j) : Vec::zero();
+            term = c * (Vec::load(row + j) - shift);
+          }
+          (Vec::load(target + j) + term).store(target + j);
+        }
+        for (; j < n; j++) {
+          float term = coef[o + j];
+          if (row != nullptr)
+            term *= row[j] - (center ? center[o + j] : 0.0f);
+          target[j] += term;
+        }
+      }
+    });
+  });
+}
+
+} // namespace CPU_CAPABILITY
+} // namespace kernels
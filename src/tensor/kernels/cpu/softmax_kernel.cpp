@@ -0,0 +1,380 @@
+#include "../../parallel/parallel.h"
+#include "../loop.h"
+#include "cpu_kernels.h"
+#include "vec.h"
+#include "vec_math.h"
+#include <algorithm>
+#include <limits>
+
+namespace kernels {
+namespace CPU_CAPABILITY {
+
+namespace {
+
+constexpr float LOWEST = std::numeric_limits<float>::lowest();
+
+// The elements of one softmax, or of up to Vec::size neighbouring ones, as
+// a sequence of blocks. Along a contiguous row (across) a block holds
+// Vec::size consecutive elements of the same softmax and the lanes are
+// combined at the end; otherwise block j holds element j of width softmaxes
+// lying next to each other in memory.
+struct Slice {
+  long size;
+  long blocks;
+  long stride;
+  long width;
+  long last;
+  bool across;
+
+  long lanes(long b) const { return b == blocks - 1 ? last : width; }
+};
+
+Slice row_slice(long n) {
+  long blocks = (n + Vec::size - 1) / Vec::size;
+  long last = n - (blocks - 1) * Vec::size;
+  return {n, blocks, Vec::size, Vec::size, last, true};
+}
+
+Slice column_slice(long n, long inner, long width) {
+  return {n, n, inner, width, width, false};
+}
+
+Vec load_partial(const float *p, long lanes, float fill) {
+  if (lanes == Vec::size)
+    return Vec::load(p);
+  float buffer[Vec::size];
+  for (int k = 0; k < Vec::size; k++)
+    buffer[k] = k < lanes ? p[k] : fill;
+  return Vec::load(buffer);
+}
+
+void store_partial(Vec v, float *p, long lanes) {
+  if (lanes == Vec::size) {
+    v.store(p);
+    return;
+  }
+  float buffer[Vec::size];
+  v.store(buffer);
+  for (int k = 0; k < lanes; k++)
+    p[k] = buffer[k];
+}
+
+Vec load(const Slice &slice, const float *p, long b, float fill) {
+  return load_partial(p + b * slice.stride, slice.lanes(b), fill);
+}
+
+void store(const Slice &slice, Vec v, float *p, long b) {
+  store_partial(v, p + b * slice.stride, slice.lanes(b));
+}
+
+// Zeroes the lanes past the end of a row so they drop out of sums.
+Vec valid(const Slice &slice, Vec v, long b) {
+  long lanes = slice.lanes(b);
+  if (!slice.across || lanes == Vec::size)
+    return v;
+  float buffer[Vec::size];
+  v.store(buffer);
+  for (int k = lanes; k < Vec::size; k++)
+    buffer[k] = 0.0f;
+  return Vec::load(buffer);
+}
+
+Vec total_sum(const Slice &slice, Vec v) {
+  return slice.across ? Vec::broadcast(v.sum()) : v;
+}
+
+Vec total_max(const Slice &slice, Vec v) {
+  if (!slice.across)
+    return v;
+  float lanes[Vec::size];
+  v.store(lanes);
+  float result = lanes[0];
+  for (int k = 1; k < Vec::size; k++)
+    result = lanes[k] > result ? lanes[k] : result;
+  return Vec::broadcast(result);
+}
+
+// The number of softmaxes in a slice.
+long count(const Slice &slice) { return slice.across ? 1 : slice.width; }
+
+// Offset of element j of the k-th softmax in a slice.
+long element(const Slice &slice, long j, long k) {
+  return slice.across ? j : j * slice.stride + k;
+}
+
+// One value per softmax, at p.
+Vec load_result(const Slice &slice, const float *p) {
+  return slice.across ? Vec::broadcast(*p) : load_partial(p, slice.width, 0);
+}
+
+void store_result(const Slice &slice, Vec v, float *p) {
+  store_partial(v, p, slice.across ? 1 : slice.width);
+}
+
+Vec max_of(const Slice &slice, const float *x) {
+  Vec m = Vec::broadcast(LOWEST);
+  for (long b = 0; b < slice.blocks; b++)
+    m = max(load(slice, x, b, LOWEST), m);
+  return total_max(slice, m);
+}
+
+// Sum of e^(x - shift), with the terms also stored to out unless it is null.
+Vec exp_sum(const Slice &slice, const float *x, Vec shift, float *out) {
+  Vec sum = Vec::zero();
+  for (long b = 0; b < slice.blocks; b++) {
+    Vec e = exp<false>(load(slice, x, b, LOWEST) - shift);
+    if (out != nullptr)
+      store(slice, e, out, b);
+    sum = sum + valid(slice, e, b);
+  }
+  return total_sum(slice, sum);
+}
+
+// Sum of a * b, or of a with b null.
+Vec dot(const Slice &slice, const float *a, const float *b) {
+  Vec sum = Vec::zero();
+  for (long k = 0; k < slice.blocks; k++) {
+    Vec term = load(slice, a, k, 0.0f);
+    if (b != nullptr)
+      term = term * load(slice, b, k, 0.0f);
+    sum = sum + term;
+  }
+  return total_sum(slice, sum);
+}
+
+void softmax_slice(const Slice &slice, const float *in, float *out,
+                   bool log) {
+  Vec largest = max_of(slice, in);
+  Vec sum = exp_sum(slice, in, largest, log ? nullptr : out);
+  if (log) {
+    Vec log_sum = log_accurate(sum);
+    for (long b = 0; b < slice.blocks; b++)
+      store(slice, load(slice, in, b, LOWEST) - largest - log_sum, out, b);
+    return;
+  }
+  Vec scale = Vec::broadcast(1.0f) / sum;
+  for (long b = 0; b < slice.blocks; b++)
+    store(slice, load(slice, out, b, 0.0f) * scale, out, b);
+}
+
+void softmax_backward_slice(const Slice &slice, const float *grad,
+                            const float *out, float *grad_in, bool log) {
+  Vec total = dot(slice, grad, log ? nullptr : out);
+  for (long b = 0; b < slice.blocks; b++) {
+    Vec g = load(slice, grad, b, 0.0f);
+    Vec y = load(slice, out, b, 0.0f);
+    Vec term = log ? g - exp<false>(y) * total : y * (g - total);
+    store(slice, load(slice, grad_in, b, 0.0f) + term, grad_in, b);
+  }
+}
+
+// The max of the logits and the sum of the target, which share a pass.
+void max_and_target_sum(const Slice &slice, const float *logits,
+                        const float *target, Vec &largest, Vec &target_sum) {
+  largest = Vec::broadcast(LOWEST);
+  target_sum = Vec::zero();
+  for (long b = 0; b < slice.blocks; b++) {
+    largest = max(load(slice, logits, b, LOWEST), largest);
+    target_sum = target_sum + load(slice, target, b, 0.0f);
+  }
+  largest = total_max(slice, largest);
+  target_sum = total_sum(slice, target_sum);
+}
+
+void cross_entropy_slice(const Slice &slice, const float *logits,
+                         const float *target, float smoothing, float *loss,
+                         float *log_sum) {
+  Vec largest;
+  Vec target_sum;
+  max_and_target_sum(slice, logits, target, largest, target_sum);
+  Vec sum = Vec::zero();
+  Vec product = Vec::zero();
+  Vec shifted_sum = Vec::zero();
+  for (long b = 0; b < slice.blocks; b++) {
+    Vec shifted = load(slice, logits, b, LOWEST) - largest;
+    sum = sum + valid(slice, exp<false>(shifted), b);
+    shifted = valid(slice, shifted, b);
+    product = fmadd(load(slice, target, b, 0.0f), shifted, product);
+    shifted_sum = shifted_sum + shifted;
+  }
+  Vec keep = Vec::broadcast(1.0f - smoothing);
+  Vec uniform = Vec::broadcast(smoothing / slice.size);
+  Vec result = log_accurate(total_sum(slice, sum));
+  store_result(slice, result, log_sum);
+  Vec smoothed_sum = fmadd(keep, target_sum, Vec::broadcast(smoothing));
+  Vec loss_value = result * smoothed_sum -
+                   keep * total_sum(slice, product) -
+                   uniform * total_sum(slice, shifted_sum);
+  store_result(slice, loss_value, loss);
+}
+
+void cross_entropy_backward_slice(const Slice &slice, const float *grad,
+                                  const float *logits, const float *target,
+                                  float smoothing, const float *log_sum,
+                                  float *logits_grad, float *target_grad) {
+  Vec largest;
+  Vec target_sum;
+  max_and_target_sum(slice, logits, target, largest, target_sum);
+  Vec g = load_result(slice, grad);
+  Vec log_sums = load_result(slice, log_sum);
+  Vec keep = Vec::broadcast(1.0f - smoothing);
+  Vec uniform = Vec::broadcast(smoothing / slice.size);
+  Vec scale = g * fmadd(keep, target_sum, Vec::broadcast(smoothing));
+  for (long b = 0; b < slice.blocks; b++) {
+    Vec shifted = load(slice, logits, b, 0.0f) - largest - log_sums;
+    Vec t = fmadd(keep, load(slice, target, b, 0.0f), uniform);
+    if (logits_grad != nullptr) {
+      Vec term = exp<false>(shifted) * scale - g * t;
+      store(slice, load(slice, logits_grad, b, 0.0f) + term, logits_grad, b);
+    }
+    if (target_grad != nullptr) {
+      Vec term = g * keep * shifted;
+      store(slice, load(slice, target_grad, b, 0.0f) - term, target_grad, b);
+    }
+  }
+}
+
+// The class logit is picked per softmax after the vector passes; classes
+// holds one entry per softmax of the slice.
+void cross_entropy_classes_slice(const Slice &slice, const float *logits,
+                                 const int *classes, float smoothing,
+                                 float *loss, float *log_sum) {
+  Vec largest = max_of(slice, logits);
+  Vec sum = Vec::zero();
+  Vec shifted_sum = Vec::zero();
+  for (long b = 0; b < slice.blocks; b++) {
+    Vec shifted = load(slice, logits, b, LOWEST) - largest;
+    sum = sum + valid(slice, exp<false>(shifted), b);
+    shifted_sum = shifted_sum + valid(slice, shifted, b);
+  }
+  Vec result = log_accurate(total_sum(slice, sum));
+  store_result(slice, result, log_sum);
+  Vec uniform = Vec::broadcast(smoothing / slice.size);
+  float losses[Vec::size];
+  float maxes[Vec::size];
+  (result - uniform * total_sum(slice, shifted_sum)).store(losses);
+  largest.store(maxes);
+  for (long k = 0; k < count(slice); k++) {
+    if (classes[k] < 0) {
+      loss[k] = 0.0f;
+      continue;
+    }
+    float picked = logits[element(slice, classes[k], k)] - maxes[k];
+    loss[k] = losses[k] - (1.0f - smoothing) * picked;
+  }
+}
+
+void cross_entropy_classes_backward_slice(const Slice &slice,
+                                          const float *grad,
+                                          const float *logits,
+                                          const int *classes, float smoothing,
+                                          const float *log_sum,
+                                          float *logits_grad) {
+  // Ignored softmaxes get a zero gradient through g.
+  float grads[Vec::size] = {};
+  for (long k = 0; k < count(slice); k++)
+    grads[k] = classes[k] < 0 ? 0.0f : grad[k];
+  Vec g = slice.across ? Vec::broadcast(grads[0]) : Vec::load(grads);
+  Vec largest = max_of(slice, logits);
+  Vec log_sums = load_result(slice, log_sum);
+  Vec uniform = g * Vec::broadcast(smoothing / slice.size);
+  for (long b = 0; b < slice.blocks; b++) {
+    Vec shifted = load(slice, logits, b, 0.0f) - largest - log_sums;
+    Vec term = g * exp<false>(shifted) - uniform;
+    store(slice, load(slice, logits_grad, b, 0.0f) + term, logits_grad, b);
+  }
+  for (long k = 0; k < count(slice); k++)
+    if (classes[k] >= 0)
+      logits_grad[element(slice, classes[k], k)] -=
+          grads[k] * (1.0f - smoothing);
+}
+
+// Calls body(slice, offset, result) for every softmax, or block of
+// neighbouring ones, with offset the position of its first element and
+// result that of its per-softmax value.
+template <typename Body>
+void for_each_slice(const SoftmaxDims &dims, Body body) {
+  long size = std::max<long>(1, dims.size);
+  if (dims.inner == 1) {
+    Slice slice = row_slice(dims.size);
+    parallel::parallel_for(0, dims.outer, TRANSCENDENTAL_GRAIN_SIZE / size,
+                           [&](long begin, long end) {
+                             for (long o = begin; o < end; o++)
+                               body(slice, o * dims.size, o);
+                           });
+    return;
+  }
+  long blocks = (dims.inner + Vec::size - 1) / Vec::size;
+  parallel::parallel_for(
+      0, dims.outer * blocks, TRANSCENDENTAL_GRAIN_SIZE / (size * Vec::size),
+      [&](long begin, long end) {
+        for (long t = begin; t < end; t++) {
+          long o = t / blocks;
+          long i = t % blocks * Vec::size;
+          long width = std::min<long>(Vec::size, dims.inner - i);
+          body(column_slice(dims.size, dims.inner, width),
+               o * dims.size * dims.inner + i, o * dims.inner + i);
+        }
+      });
+}
+
+} // namespace
+
+void softmax(const SoftmaxDims &dims, const float *in, float *out, bool log) {
+  for_each_slice(dims, [&](const Slice &slice, long offset, long) {
+    softmax_slice(slice, in + offset, out + offset, log);
+  });
+}
+
+void softmax_backward(const SoftmaxDims &dims, const float *grad,
+                      const float *out, float *grad_in, bool log) {
+  for_each_slice(dims, [&](const Slice &slice, long offset, long) {
+    softmax_backward_slice(slice, grad + offset, out + offset,
+                           grad_in + offset, log);
+  });
+}
+
+void cross_entropy(const SoftmaxDims &dims, const float *logits,
+                   const float *target, float smoothing, float *loss,
+                   float *log_sum) {
+  for_each_slice(dims, [&](const Slice &slice, long offset, long result) {
+    cross_entropy_slice(slice, logits + offset, target + offset, smoothing,
+                        loss + result, log_sum + result);
+  });
+}
+
+void cross_entropy_backward(const SoftmaxDims &dims, const float *grad,
+                            const float *logits, const float *target,
+                            float smoothing, const float *log_sum,
+                            float *logits_grad, float *target_grad) {
+  for_each_slice(dims, [&](const Slice &slice, long offset, long result) {
+    cross_entropy_backward_slice(
+        slice, grad + result, logits + offset, target + offset, smoothing,
+        log_sum + result, logits_grad ? logits_grad + offset : nullptr,
+        target_grad ? target_grad + offset : nullptr);
+  });
+}
+
+void cross_entropy_classes(const SoftmaxDims &dims, const float *logits,
+                           const int *classes, float smoothing, float *loss,
+                           float *log_sum) {
+  for_each_slice(dims, [&](const Slice &slice, long offset, long result) {
+    cross_entropy_classes_slice(slice, logits + offset, classes + result,
+                                smoothing, loss + result, log_sum + result);
+  });
+}
+
+void cross_entropy_classes_backward(const SoftmaxDims &dims, const float *grad,
+                                    const float *logits, const int *classes,
+                                    float smoothing, const float *log_sum,
+                                    float *logits_grad) {
+  for_each_slice(dims, [&](const Slice &slice, long offset, long result) {
+    cross_entropy_classes_backward_slice(slice, grad + result,
+                                         logits + offset, classes + result,
+                                         smoothing, log_sum + result,
+                                         logits_grad + offset);
+  });
+}
+
+} // namespace CPU_CAPABILITY
+} // namespace kernels
@@ -0,0 +1,108 @@
+#include "../../parallel/parallel.h"
+#include "../loop.h"
+#include "cpu_kernels.h"
+#include "vec.h"
+#include "vec_math.h"
+
+namespace kernels {
+namespace CPU_CAPABILITY {
+
+namespace {
+
+template <bool fast> Vec forward(UnaryOp op, Vec x) {
+  switch (op) {
+  case UnaryOp::Exp:
+    return exp<fast>(x);
+  case UnaryOp::Log:
+    return fast ? log_fast(x) : log_accurate(x);
+  case UnaryOp::Tanh:
+    return tanh<fast>(x);
+  case UnaryOp::Sigmoid:
+    return sigmoid<fast>(x);
+  case UnaryOp::Gelu:
+    return gelu<fast>(x);
+  }
+  return x;
+}
+
+Vec backward(UnaryOp op, Vec grad, Vec x, Vec y) {
+  Vec one = constant(1.0f);
+  switch (op) {
+  case UnaryOp::Exp:
+    return grad * y;
+  case UnaryOp::Log:
+    return grad / x;
+  case UnaryOp::Tanh:
+    return grad * (one - y * y);
+  case UnaryOp::Sigmoid:
+    return grad * y * (one - y);
+  case UnaryOp::Gelu:
+    return grad * gelu_grad(x);
+  }
+  return grad;
+}
+
+// The tail goes through the vector code as well, padded with ones, so every
+// element gets the same result wherever the chunk boundaries fall.
+template <bool fast>
+void forward_range(UnaryOp op, const float *in, float *out, long n) {
+  long i = 0;
+  for (; i + Vec::size <= n; i += Vec::size)
+    forward<fast>(op, Vec::load(in + i)).store(out + i);
+  if (i == n)
+    return;
+  float buffer[Vec::size];
+  for (int j = 0; j < Vec::size; j++)
+    buffer[j] = i + j < n ? in[i + j] : 1.0f;
+  forward<fast>(op, Vec::load(buffer)).store(buffer);
+  for (int j = 0; i + j < n; j++)
+    out[i + j] = buffer[j];
+}
+
+} // namespace
+
+void unary(UnaryOp op, const float *in, float *out, long n, bool fast) {
+  parallel::parallel_for(0, n, TRANSCENDENTAL_GRAIN_SIZE,
+                         [&](long begin, long end) {
+                           if (fast)
+                             forward_range<true>(op, in + begin, out + begin,
+                                                 end - begin);
+                           else
+                             forward_range<false>(op, in + begin, out + begin,
+                                                  end - begin);
+                         });
+}
+
+void unary_backward(UnaryOp op, const float *grad, const float *in,
+                    const float *out, float *target, long n) {
+  // Only one of in and out is read; the other may be null.
+  if (grad_uses_output(op))
+    in = out;
+  else
+    out = in;
+  parallel::parallel_for(0, n, TRANSCENDENTAL_GRAIN_SIZE, [&](long begin,
+                                                              long end) {
+    long i = begin;
+    for (; i + Vec::size <= end; i += Vec::size) {
+      Vec contribution = backward(op, Vec::load(grad + i), Vec::load(in + i),
+                                  Vec::load(out + i));
+      (Vec::load(target + i) + contribution).store(target + i);
+    }
+    if (i == end)
+      return;
+    const float *sources[4] = {grad, in, out, target};
+    float buffers[4][Vec::size];
+    for (int b = 0; b < 4; b++)
+      for (int j = 0; j < Vec::size; j++)
+        buffers[b][j] = i + j < end ? sources[b][i + j] : 1.0f;
+    Vec contribution =
+        backward(op, Vec::load(buffers[0]), Vec::load(buffers[1]),
+                 Vec::load(buffers[2]));
+    (Vec::load(buffers[3]) + contribution).store(buffers[3]);
+    for (int j = 0; i + j < end; j++)
+      target[i + j] = buffers[3][j];
+  });
+}
+
+} // namespace CPU_CAPABILITY
+} // namespace kernels
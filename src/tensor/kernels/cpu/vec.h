@@ -0,0 +1,225 @@
+#ifndef VEC_H
+#define VEC_H
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX512F__) || defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#ifndef CPU_CAPABILITY
+#error "vec.h is only for sources compiled per CPU capability"
+#endif
+
+namespace kernels {
+namespace CPU_CAPABILITY {
+
+// Packed floats of the widest vector width the translation unit is compiled
+// for. Kernels are written once against Vec and loop in steps of Vec::size.
+// Vec lives in the capability namespace so the differently sized variants
+// never meet at link time.
+//
+// Besides arithmetic every variant provides:
+//   min(a, b), max(a, b)  with the SSE rule of returning b if either is NaN;
+//   round(a)              to the nearest integer, for |a| < 2^31;
+//   pow2(n)               2^n for integral n in [-126, 127];
+//   frexp(a, e)           mantissa in [0.5, 1) and exponent of a positive
+//                         normal a;
+//   where_less(a, b, t, f) lanewise a < b ? t : f.
+#if defined(__AVX512F__)
+
+struct Vec {
+  static constexpr int size = 16;
+  __m512 v;
+
+  static Vec load(const float *p) { return {_mm512_loadu_ps(p)}; }
+  static Vec broadcast(float x) { return {_mm512_set1_ps(x)}; }
+  static Vec zero() { return {_mm512_setzero_ps()}; }
+  void store(float *p) const { _mm512_storeu_ps(p, v); }
+  float sum() const { return _mm512_reduce_add_ps(v); }
+};
+
+inline Vec operator+(Vec a, Vec b) { return {_mm512_add_ps(a.v, b.v)}; }
+inline Vec operator-(Vec a, Vec b) { return {_mm512_sub_ps(a.v, b.v)}; }
+inline Vec operator*(Vec a, Vec b) { return {_mm512_mul_ps(a.v, b.v)}; }
+inline Vec operator/(Vec a, Vec b) { return {_mm512_div_ps(a.v, b.v)}; }
+inline Vec fmadd(Vec a, Vec b, Vec c) {
+  return {_mm512_fmadd_ps(a.v, b.v, c.v)};
+}
+inline Vec sqrt(Vec a) { return {_mm512_sqrt_ps(a.v)}; }
+inline Vec min(Vec a, Vec b) { return {_mm512_min_ps(a.v, b.v)}; }
+inline Vec max(Vec a, Vec b) { return {_mm512_max_ps(a.v, b.v)}; }
+inline Vec abs(Vec a) { return {_mm512_abs_ps(a.v)}; }
+inline Vec round(Vec a) {
+  return {_mm512_roundscale_ps(a.v, _MM_FROUND_TO_NEAREST_INT |
+                                        _MM_FROUND_NO_EXC)};
+}
+inline Vec pow2(Vec n) {
+  __m512i biased =
+      _mm512_add_epi32(_mm512_cvtps_epi32(n.v), _mm512_set1_epi32(127));
+  return {_mm512_castsi512_ps(_mm512_slli_epi32(biased, 23))};
+}
+inline Vec frexp(Vec a, Vec &exponent) {
+  exponent = {_mm512_add_ps(_mm512_getexp_ps(a.v), _mm512_set1_ps(1.0f))};
+  return {_mm512_getmant_ps(a.v, _MM_MANT_NORM_p5_1, _MM_MANT_SIGN_zero)};
+}
+inline Vec where_less(Vec a, Vec b, Vec then, Vec otherwise) {
+  __mmask16 mask = _mm512_cmp_ps_mask(a.v, b.v, _CMP_LT_OQ);
+  return {_mm512_mask_blend_ps(mask, otherwise.v, then.v)};
+}
+
+#elif defined(__AVX2__)
+
+struct Vec {
+  static constexpr int size = 8;
+  __m256 v;
+
+  static Vec load(const float *p) { return {_mm256_loadu_ps(p)}; }
+  static Vec broadcast(float x) { return {_mm256_set1_ps(x)}; }
+  static Vec zero() { return {_mm256_setzero_ps()}; }
+  void store(float *p) const { _mm256_storeu_ps(p, v); }
+  float sum() const {
+    __m128 half = _mm_add_ps(_mm256_castps256_ps128(v),
+                             _mm256_extractf128_ps(v, 1));
+    half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+    half = _mm_add_ss(half, _mm_movehdup_ps(half));
+    return _mm_cvtss_f32(half);
+  }
+};
+
+inline Vec operator+(Vec a, Vec b) { return {_mm256_add_ps(a.v, b.v)}; }
+inline Vec operator-(Vec a, Vec b) { return {_mm256_sub_ps(a.v, b.v)}; }
+inline Vec operator*(Vec a, Vec b) { return {_mm256_mul_ps(a.v, b.v)}; }
+inline Vec operator/(Vec a, Vec b) { return {_mm256_div_ps(a.v, b.v)}; }
+inline Vec fmadd(Vec a, Vec b, Vec c) {
+#if defined(__FMA__)
+  return {_mm256_fmadd_ps(a.v, b.v, c.v)};
+#else
+  return {_mm256_add_ps(_mm256_mul_ps(a.v, b.v), c.v)};
+#endif
+}
+inline Vec sqrt(Vec a) { return {_mm256_sqrt_ps(a.v)}; }
+inline Vec min(Vec a, Vec b) { return {_mm256_min_ps(a.v, b.v)}; }
+inline Vec max(Vec a, Vec b) { return {_mm256_max_ps(a.v, b.v)}; }
+inline Vec abs(Vec a) {
+  return {_mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v)};
+}
+inline Vec round(Vec a) {
+  return {_mm256_round_ps(a.v, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC)};
+}
+inline Vec pow2(Vec n) {
+  __m256i biased =
+      _mm256_add_epi32(_mm256_cvtps_epi32(n.v), _mm256_set1_epi32(127));
+  return {_mm256_castsi256_ps(_mm256_slli_epi32(biased, 23))};
+}
+inline Vec frexp(Vec a, Vec &exponent) {
+  __m256i bits = _mm256_castps_si256(a.v);
+  __m256i biased = _mm256_srli_epi32(bits, 23);
+  exponent = {_mm256_cvtepi32_ps(
+      _mm256_sub_epi32(biased, _mm256_set1_epi32(126)))};
+  bits = _mm256_and_si256(bits, _mm256_set1_epi32(0x007fffff));
+  bits = _mm256_or_si256(bits, _mm256_set1_epi32(0x3f000000));
+  return {_mm256_castsi256_ps(bits)};
+}
+inline Vec where_less(Vec a, Vec b, Vec then, Vec otherwise) {
+  __m256 mask = _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ);
+  return {_mm256_blendv_ps(otherwise.v, then.v, mask)};
+}
+
+#elif defined(__SSE2__)
+
+struct Vec {
+  static constexpr int size = 4;
+  __m128 v;
+
+  static Vec load(const float *p) { return {_mm_loadu_ps(p)}; }
+  static Vec broadcast(float x) { return {_mm_set1_ps(x)}; }
+  static Vec zero() { return {_mm_setzero_ps()}; }
+  void store(float *p) const { _mm_storeu_ps(p, v); }
+  float sum() const {
+    __m128 shuffled = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1));
+    __m128 sums = _mm_add_ps(v, shuffled);
+    shuffled = _mm_movehl_ps(shuffled, sums);
+    return _mm_cvtss_f32(_mm_add_ss(sums, shuffled));
+  }
+};
+
+inline Vec operator+(Vec a, Vec b) { return {_mm_add_ps(a.v, b.v)}; }
+inline Vec operator-(Vec a, Vec b) { return {_mm_sub_ps(a.v, b.v)}; }
+inline Vec operator*(Vec a, Vec b) { return {_mm_mul_ps(a.v, b.v)}; }
+inline Vec operator/(Vec a, Vec b) { return {_mm_div_ps(a.v, b.v)}; }
+inline Vec fmadd(Vec a, Vec b, Vec c) {
+  return {_mm_add_ps(_mm_mul_ps(a.v, b.v), c.v)};
+}
+inline Vec sqrt(Vec a) { return {_mm_sqrt_ps(a.v)}; }
+inline Vec min(Vec a, Vec b) { return {_mm_min_ps(a.v, b.v)}; }
+inline Vec max(Vec a, Vec b) { return {_mm_max_ps(a.v, b.v)}; }
+inline Vec abs(Vec a) { return {_mm_andnot_ps(_mm_set1_ps(-0.0f), a.v)}; }
+inline Vec round(Vec a) { return {_mm_cvtepi32_ps(_mm_cvtps_epi32(a.v))}; }
+inline Vec pow2(Vec n) {
+  __m128i biased = _mm_add_epi32(_mm_cvtps_epi32(n.v), _mm_set1_epi32(127));
+  return {_mm_castsi128_ps(_mm_slli_epi32(biased, 23))};
+}
+inline Vec frexp(Vec a, Vec &exponent) {
+  __m128i bits = _mm_castps_si128(a.v);
+  __m128i biased = _mm_srli_epi32(bits, 23);
+  exponent = {_mm_cvtepi32_ps(_mm_sub_epi32(biased, _mm_set1_epi32(126)))};
+  bits = _mm_and_si128(bits, _mm_set1_epi32(0x007fffff));
+  bits = _mm_or_si128(bits, _mm_set1_epi32(0x3f000000));
+  return {_mm_castsi128_ps(bits)};
+}
+inline Vec where_less(Vec a, Vec b, Vec then, Vec otherwise) {
+  __m128 mask = _mm_cmplt_ps(a.v, b.v);
+  return {_mm_or_ps(_mm_and_ps(mask, then.v),
+                    _mm_andnot_ps(mask, otherwise.v))};
+}
+
+#else
+
+struct Vec {
+  static constexpr int size = 1;
+  float v;
+
+  static Vec load(const float *p) { return {*p}; }
+  static Vec broadcast(float x) { return {x}; }
+  static Vec zero() { return {0.0f}; }
+  void store(float *p) const { *p = v; }
+  float sum() const { return v; }
+};
+
+inline Vec operator+(Vec a, Vec b) { return {a.v + b.v}; }
+inline Vec operator-(Vec a, Vec b) { return {a.v - b.v}; }
+inline Vec operator*(Vec a, Vec b) { return {a.v * b.v}; }
+inline Vec operator/(Vec a, Vec b) { return {a.v / b.v}; }
+inline Vec fmadd(Vec a, Vec b, Vec c) { return {a.v * b.v + c.v}; }
+inline Vec sqrt(Vec a) { return {std::sqrt(a.v)}; }
+inline Vec min(Vec a, Vec b) { return {a.v < b.v ? a.v : b.v}; }
+inline Vec max(Vec a, Vec b) { return {a.v > b.v ? a.v : b.v}; }
+inline Vec abs(Vec a) { return {std::fabs(a.v)}; }
+inline Vec round(Vec a) { return {std::nearbyint(a.v)}; }
+inline Vec pow2(Vec n) {
+  uint32_t bits = static_cast<uint32_t>(static_cast<int32_t>(n.v) + 127)
+                  << 23;
+  float result;
+  std::memcpy(&result, &bits, sizeof(result));
+  return {result};
+}
+inline Vec frexp(Vec a, Vec &exponent) {
+  int e;
+  float mantissa = std::frexp(a.v, &e);
+  exponent = {static_cast<float>(e)};
+  return {mantissa};
+}
+inline Vec where_less(Vec a, Vec b, Vec then, Vec otherwise) {
+  return {a.v < b.v ? then.v : otherwise.v};
+}
+
+#endif
+
+} // namespace CPU_CAPABILITY
+} // namespace kernels
+
+#endif // VEC_H
@@ -0,0 +1,138 @@
+#ifndef VEC_MATH_H
+#define VEC_MATH_H
+
+#include "../unary.h"
+#include "vec.h"
+#include <cfloat>
+#include <initializer_list>
+#include <limits>
+
+namespace kernels {
+namespace CPU_CAPABILITY {
+
+// exp, log, sigmoid, tanh and GELU on Vec, shared by the kernels that need
+// them. The accuracy of each mode is documented with the float overloads in
+// kernels/unary.h.
+
+inline Vec constant(float x) { return Vec::broadcast(x); }
+
+inline Vec polynomial(Vec x, std::initializer_list<float> coefficients) {
+  auto c = coefficients.begin();
+  Vec result = constant(*c++);
+  for (; c != coefficients.end(); c++)
+    result = fmadd(result, x, constant(*c));
+  return result;
+}
+
+// e^x = 2^n e^r with n = round(x / ln 2) and |r| <= ln 2 / 2. ln 2 is split in
+// two (Cody and Waite) so that r is exact, and e^r uses the Cephes minimax
+// polynomial.
+template <bool fast> inline Vec exp(Vec x) {
+  // Below -104 the result rounds to 0 and above 88.8 to infinity. The clamp
+  // keeps NaN, which propagates through the rest.
+  x = max(constant(-104.0f), min(constant(88.8f), x));
+  Vec n = round(x * constant(1.44269504088896341f));
+  Vec p;
+  Vec r;
+  if (fast) {
+    // One-term reduction and a degree 5 Taylor polynomial.
+    r = fmadd(n, constant(-0.69314718056f), x);
+    p = polynomial(r, {1.0f / 120, 1.0f / 24, 1.0f / 6, 0.5f, 1.0f, 1.0f});
+  } else {
+    r = fmadd(n, constant(-0.693359375f), x);
+    r = fmadd(n, constant(2.12194440e-4f), r);
+    p = polynomial(r, {1.9875691500e-4f, 1.3981999507e-3f, 8.3334519073e-3f,
+                       4.1665795894e-2f, 1.6666665459e-1f, 5.0000001201e-1f});
+    p = fmadd(p * r, r, r + constant(1.0f));
+  }
+  // Scaling by 2^n in two halves keeps both factors normal, so results that
+  // overflow or are subnormal are still rounded only once.
+  Vec half = round(n * constant(0.5f));
+  return p * pow2(half) * pow2(n - half);
+}
+
+// log x = e ln 2 + log m with m folded into [sqrt(0.5), sqrt(2)), using the
+// Cephes minimax polynomial for log(1 + f). x is a positive normal number
+// times 2^-shift.
+inline Vec log_polynomial(Vec x, Vec shift) {
+  Vec e;
+  Vec m = frexp(x, e);
+  e = e - shift;
+  Vec below = constant(0.707106781186547524f);
+  e = where_less(m, below, e - constant(1.0f), e);
+  Vec f = where_less(m, below, m + m, m) - constant(1.0f);
+  Vec z = f * f;
+  Vec y = polynomial(f, {7.0376836292e-2f, -1.1514610310e-1f,
+                         1.1676998740e-1f, -1.2420140846e-1f,
+                         1.4249322787e-1f, -1.6668057665e-1f,
+                         2.0000714765e-1f, -2.4999993993e-1f,
+                         3.3333331174e-1f}) *
+          f * z;
+  y = fmadd(e, constant(-2.12194440e-4f), y);
+  y = fmadd(z, constant(-0.5f), y);
+  return fmadd(e, constant(0.693359375f), f + y);
+}
+
+inline Vec log_accurate(Vec x) {
+  // Subnormals are scaled into the normal range first.
+  Vec subnormal = constant(FLT_MIN);
+  Vec scaled = where_less(x, subnormal, x * constant(33554432.0f), x);
+  Vec shift = where_less(x, subnormal, constant(25.0f), Vec::zero());
+  Vec result = log_polynomial(scaled, shift);
+  // x - x is NaN for NaN and infinite x, and 0 otherwise.
+  result = result + (x - x);
+  float infinity = std::numeric_limits<float>::infinity();
+  result = where_less(constant(FLT_MAX), x, x, result);
+  result = where_less(x, constant(FLT_TRUE_MIN), constant(-infinity), result);
+  return where_less(x, Vec::zero(),
+                    constant(std::numeric_limits<float>::quiet_NaN()), result);
+}
+
+inline Vec log_fast(Vec x) { return log_polynomial(x, Vec::zero()); }
+
+// 1 / (1 + e^-x), or e^x / (1 + e^x) for negative x so that e^-x cannot
+// overflow where the result is still representable.
+template <bool fast> inline Vec sigmoid(Vec x) {
+  Vec t = exp<fast>(Vec::zero() - abs(x));
+  Vec s = constant(1.0f) / (constant(1.0f) + t);
+  return where_less(x, Vec::zero(), t * s, s);
+}
+
+template <bool fast> inline Vec tanh(Vec x) {
+  // 1 - 2 / (e^2x + 1) loses relative accuracy near 0, where the Cephes
+  // odd polynomial takes over.
+  Vec magnitude = abs(x);
+  Vec large = constant(1.0f) -
+              constant(2.0f) / (exp<fast>(magnitude + magnitude) +
+                                constant(1.0f));
+  large = where_less(x, Vec::zero(), Vec::zero() - large, large);
+  if (fast)
+    return large;
+  Vec z = x * x;
+  Vec small = polynomial(z, {-5.70498872745e-3f, 2.06390887954e-2f,
+                             -5.37397155531e-2f, 1.33314422036e-1f,
+                             -3.33332819422e-1f});
+  small = fmadd(small * z, x, x);
+  return where_less(magnitude, constant(0.625f), small, large);
+}
+
+// The tanh form of GELU, as x * sigmoid(2u).
+template <bool fast> inline Vec gelu(Vec x) {
+  Vec inner = fmadd(constant(GELU_CUBIC) * x, x * x, x);
+  return x * sigmoid<fast>(constant(2 * GELU_SCALE) * inner);
+}
+
+// The derivative of gelu at x.
+inline Vec gelu_grad(Vec x) {
+  Vec square = x * x;
+  Vec inner = fmadd(constant(GELU_CUBIC) * x, square, x);
+  Vec s = sigmoid<false>(constant(2 * GELU_SCALE) * inner);
+  Vec slope = fmadd(constant(6 * GELU_SCALE * GELU_CUBIC), square,
+                    constant(2 * GELU_SCALE));
+  return fmadd(x * s * (constant(1.0f) - s), slope, s);
+}
+
+} // namespace CPU_CAPABILITY
+} // namespace kernels
+
+#endif // VEC_MATH_H
@@ -0,0 +1,94 @@
+#include "dispatch.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstdlib>
+#include <iostream>
+
+namespace kernels {
+
+static CPUCapability supported_capability() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_cpu_init();
+#ifdef CPU_CAPABILITY_AVX512
+  if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") &&
+      __builtin_cpu_supports("avx512vl") &&
+      __builtin_cpu_supports("avx512dq") && __builtin_cpu_supports("fma"))
+    return CPUCapability::AVX512;
+#endif
+#ifdef CPU_CAPABILITY_AVX2
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    return CPUCapability::AVX2;
+#endif
+#endif
+  return CPUCapability::DEFAULT;
+}
+
+static CPUCapability parse_capability(std::string name) {
+  std::transform(name.begin(), name.end(), name.begin(),
+                 [](unsigned char c) { return std::tolower(c); });
+  if (name == "avx512")
+    return CPUCapability::AVX512;
+  if (name == "avx2")
+    return CPUCapability::AVX2;
+  if (name != "default")
+    std::cerr << CPU_CAPABILITY_ENV << "=" << name
+              << " is not one of default, avx2, avx512" << std::endl;
+  return CPUCapability::DEFAULT;
+}
+
+static const CPUKernels &kernels_for(CPUCapability capability) {
+  switch (capability) {
+#ifdef CPU_CAPABILITY_AVX512
+  case CPUCapability::AVX512:
+    return AVX512::get_cpu_kernels();
+#endif
+#ifdef CPU_CAPABILITY_AVX2
+  case CPUCapability::AVX2:
+    return AVX2::get_cpu_kernels();
+#endif
+  default:
+    return DEFAULT::get_cpu_kernels();
+  }
+}
+
+static CPUCapability initial_capability() {
+  CPUCapability capability = supported_capability();
+  if (const char *env = std::getenv(CPU_CAPABILITY_ENV))
+    capability = std::min(capability, parse_capability(env));
+  return capability;
+}
+
+static std::atomic<CPUCapability> &active_capability() {
+  static std::atomic<CPUCapability> capability = initial_capability();
+  return capability;
+}
+
+static std::atomic<const CPUKernels *> &active_kernels() {
+  static std::atomic<const CPUKernels *> table =
+      &kernels_for(active_capability());
+  return table;
+}
+
+CPUCapability get_cpu_capability() { return active_capability(); }
+
+void set_cpu_capability(CPUCapability capability) {
+  capability = std::min(capability, supported_capability());
+  active_capability() = capability;
+  active_kernels() = &kernels_for(capability);
+}
+
+std::string cpu_capability_name(CPUCapability capability) {
+  switch (capability) {
+  case CPUCapability::AVX512:
+    return "avx512";
+  case CPUCapability::AVX2:
+    return "avx2";
+  default:
+    return "default";
+  }
+}
+
+const CPUKernels &cpu_kernels() { return *active_kernels(); }
+
+} // namespace kernels
@@ -0,0 +1,29 @@
+#ifndef DISPATCH_H
+#define DISPATCH_H
+
+#include "cpu/cpu_kernels.h"
+#include <string>
+
+// Caps the instruction set used by the kernels: default, avx2 or avx512.
+#define CPU_CAPABILITY_ENV "CTORCH_CPU_CAPABILITY"
+
+namespace kernels {
+
+enum class CPUCapability { DEFAULT, AVX2, AVX512 };
+
+// Best capability both compiled in and supported by this CPU, lowered to the
+// value of CPU_CAPABILITY_ENV when that is set. Detected on first use.
+CPUCapability get_cpu_capability();
+
+// Selects another kernel table, clamped to what the CPU supports. Like
+// set_num_threads it must not race with running kernels.
+void set_cpu_capability(CPUCapability capability);
+
+std::string cpu_capability_name(CPUCapability capability);
+
+// Kernel table of the active capability.
+const CPUKernels &cpu_kernels();
+
+} // namespace kernels
+
+#endif // DISPATCH_H
@@ -0,0 +1,25 @@
+#include "elementwise.h"
+#include "dispatch.h"
+
+namespace kernels {
+
+void binary(BinaryOp op, const float *a, int stride_a, const float *b,
+            int stride_b, float *out, int n) {
+  cpu_kernels().binary(op, a, stride_a, b, stride_b, out, n);
+}
+
+void binary_backward(BinaryOp op, int operand, const float *grad,
+                     const float *a, int stride_a, const float *b,
+                     int stride_b, float *target, int stride_target, int n) {
+  cpu_kernels().binary_backward(op, operand, grad, a, stride_a, b, stride_b,
+                                target, stride_target, n);
+}
+
+float binary_backward_sum(BinaryOp op, int operand, const float *grad,
+                          const float *a, int stride_a, const float *b,
+                          int stride_b, int n) {
+  return cpu_kernels().binary_backward_sum(op, operand, grad, a, stride_a, b,
+                                           stride_b, n);
+}
+
+} // namespace kernels
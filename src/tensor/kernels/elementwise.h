@@ -0,0 +1,110 @@
+#ifndef ELEMENTWISE_H
+#define ELEMENTWISE_H
+
+#define EPS 0.0000001f
+
+namespace kernels {
+
+enum class BinaryOp { Add, Sub, Mul, Div };
+
+template <typename DType> inline DType apply(BinaryOp op, DType a, DType b) {
+  switch (op) {
+  case BinaryOp::Add:
+    return a + b;
+  case BinaryOp::Sub:
+    return a - b;
+  case BinaryOp::Mul:
+    return a * b;
+  case BinaryOp::Div:
+    return a / (b + EPS);
+  }
+  return a;
+}
+
+// Contribution of `grad` to the gradient of operand 0 (a) or 1 (b).
+template <typename DType>
+inline DType apply_grad(BinaryOp op, int operand, DType grad, DType a,
+                        DType b) {
+  switch (op) {
+  case BinaryOp::Add:
+    return grad;
+  case BinaryOp::Sub:
+    return operand == 0 ? grad : -grad;
+  case BinaryOp::Mul:
+    return operand == 0 ? grad * b : grad * a;
+  case BinaryOp::Div:
+    if (operand == 0)
+      return grad / (b + EPS);
+    return -grad * a / ((b + EPS) * (b + EPS));
+  }
+  return grad;
+}
+
+// out[i] = a[i * stride_a] op b[i * stride_b] for i < n.
+template <typename DType>
+void binary(BinaryOp op, const DType *a, int stride_a, const DType *b,
+            int stride_b, DType *out, int n) {
+  for (int i = 0; i < n; i++)
+    out[i] = apply(op, a[i * stride_a], b[i * stride_b]);
+}
+
+// Whether the gradient of operand 0 or 1 depends on operand `which` (0 for a,
+// 1 for b); the backward functions below do not read an operand it does not
+// depend on, which may then be null.
+inline bool grad_reads_operand(BinaryOp op, int operand, int which) {
+  switch (op) {
+  case BinaryOp::Mul:
+    return operand != which;
+  case BinaryOp::Div:
+    return operand == 1 || which == 1;
+  default:
+    return false;
+  }
+}
+
+// target[i * stride_target] += the gradient of operand 0 or 1 flowing from
+// grad[i], for i < n.
+template <typename DType>
+void binary_backward(BinaryOp op, int operand, const DType *grad,
+                     const DType *a, int stride_a, const DType *b,
+                     int stride_b, DType *target, int stride_target, int n) {
+  bool reads_a = grad_reads_operand(op, operand, 0);
+  bool reads_b = grad_reads_operand(op, operand, 1);
+  for (int i = 0; i < n; i++)
+    target[i * stride_target] += apply_grad(
+        op, operand, grad[i], reads_a ? a[i * stride_a] : DType(0),
+        reads_b ? b[i * stride_b] : DType(0));
+}
+
+// Sum over i < n of the gradient of operand 0 or 1 flowing from grad[i], for a
+// gradient that is broadcast along the whole run.
+template <typename DType>
+DType binary_backward_sum(BinaryOp op, int operand, const DType *grad,
+                          const DType *a, int stride_a, const DType *b,
+                          int stride_b, int n) {
+  bool reads_a = grad_reads_operand(op, operand, 0);
+  bool reads_b = grad_reads_operand(op, operand, 1);
+  DType sum = 0;
+  for (int i = 0; i < n; i++)
+    sum += apply_grad(op, operand, grad[i],
+                      reads_a ? a[i * stride_a] : DType(0),
+                      reads_b ? b[i * stride_b] : DType(0));
+  return sum;
+}
+
+// Vectorized versions for float, used whenever the operands are contiguous or
+// broadcast scalars within the run.
+void binary(BinaryOp op, const float *a, int stride_a, const float *b,
+            int stride_b, float *out, int n);
+
+void binary_backward(BinaryOp op, int operand, const float *grad,
+                     const float *a, int stride_a, const float *b,
+                     int stride_b, float *target, int stride_target, int n);
+
+float binary_backward_sum(BinaryOp op, int operand, const float *grad,
+                          const float *a, int stride_a, const float *b,
+                          int stride_b, int n);
+
+} // namespace kernels
+
+#endif // ELEMENTWISE_H
@@ -0,0 +1,73 @@
+#include "gemm.h"
+#include "blas.h"
+#include "dispatch.h"
+#include "unary.h"
+#include <algorithm>
+
+namespace kernels {
+
+// gemm_bias_activation on the blas backend: the bias is copied into C ahead
+// of the product and the activation runs over C afterwards.
+static bool blas_gemm_bias_activation(int m, int n, int k, const float *a,
+                                      int a_row, int a_col, const float *b,
+                                      int b_row, int b_col, const float *bias,
+                                      Activation activation, float *c, int ldc,
+                                      float *pre) {
+  if (bias != nullptr)
+    for (int i = 0; i < m; i++)
+      std::copy(bias, bias + n, c + (long)i * ldc);
+  if (!blas_gemm(m, n, k, a, a_row, a_col, b, b_row, b_col, c, ldc,
+                 bias != nullptr))
+    return false;
+  for (int i = 0; i < m; i++) {
+    float *row = c + (long)i * ldc;
+    switch (activation) {
+    case Activation::None:
+      break;
+    case Activation::ReLU:
+      for (int j = 0; j < n; j++)
+        row[j] = std::max(row[j], 0.0f);
+      break;
+    case Activation::Tanh:
+      unary(UnaryOp::Tanh, row, row, n);
+      break;
+    case Activation::Gelu:
+      std::copy(row, row + n, pre + (long)i * ldc);
+      unary(UnaryOp::Gelu, row, row, n);
+      break;
+    }
+  }
+  return true;
+}
+
+void gemm(int m, int n, int k, const float *a, int a_row, int a_col,
+          const float *b, int b_row, int b_col, float *c, int ldc,
+          bool accumulate) {
+  if (get_gemm_backend() == GemmBackend::Blas &&
+      blas_gemm(m, n, k, a, a_row, a_col, b, b_row, b_col, c, ldc, accumulate))
+    return;
+  cpu_kernels().gemm(m, n, k, a, a_row, a_col, b, b_row, b_col, c, ldc,
+                     accumulate);
+}
+
+void gemm_bias_activation(int m, int n, int k, const float *a, int a_row,
+                          int a_col, const float *b, int b_row, int b_col,
+                          const float *bias, Activation activation, float *c,
+                          int ldc, float *pre) {
+  if (get_gemm_backend() == GemmBackend::Blas &&
+      blas_gemm_bias_activation(m, n, k, a, a_row, a_col, b, b_row, b_col,
+                                bias, activation, c, ldc, pre))
+    return;
+  cpu_kernels().gemm_bias_activation(m, n, k, a, a_row, a_col, b, b_row, b_col,
+                                     bias, activation, c, ldc, pre,
+                                     fast_math_enabled());
+}
+
+void activation_backward(int m, int n, Activation activation,
+                         const float *grad, const float *out, const float *pre,
+                         float *grad_pre, float *bias_grad) {
+  cpu_kernels().activation_backward(m, n, activation, grad, out, pre, grad_pre,
+                                    bias_grad);
+}
+
+} // namespace kernels
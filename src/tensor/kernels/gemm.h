@@ -0,0 +1,119 @@
+#ifndef GEMM_H
+#define GEMM_H
+
+#include "unary.h"
+#include <cmath>
+
+namespace kernels {
+
+// Activations that gemm_bias_activation applies to C as it leaves registers.
+enum class Activation { None, ReLU, Tanh, Gelu };
+
+template <typename DType> inline DType activate(Activation op, DType x) {
+  switch (op) {
+  case Activation::None:
+    return x;
+  case Activation::ReLU:
+    return x > 0 ? x : 0;
+  case Activation::Tanh:
+    return apply(UnaryOp::Tanh, x);
+  case Activation::Gelu:
+    return apply(UnaryOp::Gelu, x);
+  }
+  return x;
+}
+
+// The derivative of activate at pre, given out = activate(op, pre).
+template <typename DType>
+inline DType activate_grad(Activation op, DType pre, DType out) {
+  switch (op) {
+  case Activation::None:
+    return 1;
+  case Activation::ReLU:
+    return out > 0;
+  case Activation::Tanh:
+    return 1 - out * out;
+  case Activation::Gelu:
+    return apply_grad(UnaryOp::Gelu, DType(1), pre, out);
+  }
+  return 1;
+}
+
+// C = A * B, or C += A * B when accumulate is set, for an m x k matrix A and a
+// k x n matrix B. Element (i, p) of A is read from a[i * a_row + p * a_col]
+// and likewise for B, so a transposed operand is passed by swapping its
+// strides. C is row-major with leading dimension ldc.
+template <typename DType>
+void gemm(int m, int n, int k, const DType *a, int a_row, int a_col,
+          const DType *b, int b_row, int b_col, DType *c, int ldc,
+          bool accumulate) {
+  for (int i = 0; i < m; i++) {
+    for (int j = 0; j < n; j++) {
+      DType sum = 0;
+      for (int p = 0; p < k; p++)
+        sum += a[i * a_row + p * a_col] * b[p * b_row + j * b_col];
+      c[i * ldc + j] = accumulate ? c[i * ldc + j] + sum : sum;
+    }
+  }
+}
+
+// C = activation(A * B + bias), with bias[j] added to column j, or nothing
+// when bias is null. For Gelu, whose derivative needs its input, pre receives
+// A * B + bias with the same leading dimension as C; the other activations
+// leave pre alone, which may then be null.
+template <typename DType>
+void gemm_bias_activation(int m, int n, int k, const DType *a, int a_row,
+                          int a_col, const DType *b, int b_row, int b_col,
+                          const DType *bias, Activation activation, DType *c,
+                          int ldc, DType *pre) {
+  gemm(m, n, k, a, a_row, a_col, b, b_row, b_col, c, ldc, false);
+  for (int i = 0; i < m; i++) {
+    for (int j = 0; j < n; j++) {
+      DType value = c[i * ldc + j] + (bias != nullptr ? bias[j] : 0);
+      if (activation == Activation::Gelu)
+        pre[i * ldc + j] = value;
+      c[i * ldc + j] = activate(activation, value);
+    }
+  }
+}
+
+// The backward of gemm_bias_activation's epilogue for an m x n gradient of C,
+// all matrices contiguous: grad_pre = grad * activation'(pre), from out (ReLU,
+// Tanh) or pre (Gelu), and bias_grad[j] += the sum of column j of grad_pre.
+// Either output may be null, and so may whichever of out and pre is not read.
+template <typename DType>
+void activation_backward(int m, int n, Activation activation,
+                         const DType *grad, const DType *out, const DType *pre,
+                         DType *grad_pre, DType *bias_grad) {
+  bool uses_out =
+      activation == Activation::ReLU || activation == Activation::Tanh;
+  for (long i = 0; i < (long)m * n; i++) {
+    DType input = activation == Activation::Gelu ? pre[i] : DType(0);
+    DType output = uses_out ? out[i] : DType(0);
+    DType value = grad[i] * activate_grad(activation, input, output);
+    if (grad_pre != nullptr)
+      grad_pre[i] = value;
+    if (bias_grad != nullptr)
+      bias_grad[i % n] += value;
+  }
+}
+
+// Packed, register-blocked versions for float. The epilogue of
+// gemm_bias_activation runs on each tile of C while it is still in registers,
+// and activation_backward makes one pass over the gradient.
+void gemm(int m, int n, int k, const float *a, int a_row, int a_col,
+          const float *b, int b_row, int b_col, float *c, int ldc,
+          bool accumulate);
+
+void gemm_bias_activation(int m, int n, int k, const float *a, int a_row,
+                          int a_col, const float *b, int b_row, int b_col,
+                          const float *bias, Activation activation, float *c,
+                          int ldc, float *pre);
+
+void activation_backward(int m, int n, Activation activation,
+                         const float *grad, const float *out, const float *pre,
+                         float *grad_pre, float *bias_grad);
+
+} // namespace kernels
+
+#endif // GEMM_H
@@ -0,0 +1,298 @@
+#include "gemm_tuning.h"
+#include "../parallel/parallel.h"
+#include "dispatch.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <utility>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+namespace kernels {
+
+namespace {
+
+using Key = std::pair<CPUCapability, int>;
+using Blockings = std::map<Key, GemmBlocking>;
+
+std::string default_cache_path();
+Blockings read_cache(const std::string &path);
+
+// The blockings are never changed in place: tuning and loading publish a new
+// map under the mutex and bump the generation, so that lookups can keep using
+// the map they hold without the lock.
+struct Cache {
+  Cache()
+      : path(default_cache_path()),
+        blockings(std::make_shared<const Blockings>(read_cache(path))) {}
+
+  std::mutex mutex;
+  std::string path;
+  std::shared_ptr<const Blockings> blockings;
+  std::atomic<unsigned> generation = 1;
+};
+
+// The map of each thread, refreshed when the generation moves on. The gemm
+// runs on many pool workers at once, which would all contend on the mutex.
+struct Snapshot {
+  unsigned generation = 0;
+  std::shared_ptr<const Blockings> blockings;
+};
+thread_local Snapshot snapshot;
+
+// Set while tune_gemm times a candidate, so that the kernel uses it.
+thread_local const GemmBlocking *candidate = nullptr;
+
+// Serializes tuning, which can take seconds, apart from the lookups.
+std::mutex tuning_mutex;
+
+int size_class(int size) {
+  return size < 64 ? 0 : size < 256 ? 1 : size < 1024 ? 2 : 3;
+}
+
+int bucket(int m, int n, int k) {
+  return (size_class(m) * 4 + size_class(n)) * 4 + size_class(k);
+}
+
+std::string default_cache_path() {
+  namespace fs = std::filesystem;
+  if (const char *path = std::getenv(GEMM_CACHE_ENV))
+    return path;
+  fs::path directory;
+  if (const char *cache = std::getenv("XDG_CACHE_HOME"))
+    directory = cache;
+  else if (const char *home = std::getenv("HOME"))
+    directory = fs::path(home) / ".cache";
+  else if (const char *local = std::getenv("LOCALAPPDATA"))
+    directory = local;
+  else
+    return "";
+  return (directory / "ctorch" / "gemm_blocking").string();
+}
+
+// Reads the entries for this CPU from the file at path; later lines win.
+Blockings read_cache(const std::string &path) {
+  auto blockings = Blockings();
+  std::ifstream file(path);
+  std::string model = cpu_model();
+  std::string line;
+  while (std::getline(file, line)) {
+    std::istringstream fields(line);
+    std::string entry_model, capability_name;
+    std::getline(fields, entry_model, '\t');
+    std::getline(fields, capability_name, '\t');
+    int m, n, k;
+    GemmBlocking blocking;
+    if (!(fields >> m >> n >> k >> blocking.mc >> blocking.kc >> blocking.nc >>
+          blocking.grain_work) ||
+        entry_model != model)
+      continue;
+    for (auto capability : {CPUCapability::DEFAULT, CPUCapability::AVX2,
+                            CPUCapability::AVX512})
+      if (cpu_capability_name(capability) == capability_name)
+        blockings[{capability, (m * 4 + n) * 4 + k}] = blocking;
+  }
+  return blockings;
+}
+
+void append_to_cache(const std::string &path, CPUCapability capability,
+                     int m, int n, int k, const GemmBlocking &blocking) {
+  if (path.empty())
+    return;
+  std::error_code error;
+  auto parent = std::filesystem::path(path).parent_path();
+  if (!parent.empty())
+    std::filesystem::create_directories(parent, error);
+  std::ofstream file(path, std::ios::app);
+  file << cpu_model() << '\t' << cpu_capability_name(capability) << '\t'
+       << size_class(m) << ' ' << size_class(n) << ' ' << size_class(k)
+       << ' ' << blocking.mc << ' ' << blocking.kc << ' ' << blocking.nc
+       << ' ' << blocking.grain_work << '\n';
+  if (!file)
+    std::cerr << "Could not save the GEMM blocking to " << path << std::endl;
+}
+
+Cache &cache() {
+  static Cache instance;
+  return instance;
+}
+
+const Blockings &published(Cache &instance) {
+  if (snapshot.generation !=
+      instance.generation.load(std::memory_order_acquire)) {
+    std::lock_guard<std::mutex> lock(instance.mutex);
+    snapshot.blockings = instance.blockings;
+    snapshot.generation = instance.generation.load(std::memory_order_relaxed);
+  }
+  return *snapshot.blockings;
+}
+
+// Publishes blockings, with the mutex held.
+void publish_locked(Cache &instance, Blockings blockings) {
+  instance.blockings = std::make_shared<const Blockings>(std::move(blockings));
+  instance.generation.fetch_add(1, std::memory_order_release);
+}
+
+void publish(Cache &instance, const Key &key, const GemmBlocking &blocking) {
+  std::lock_guard<std::mutex> lock(instance.mutex);
+  auto blockings = *instance.blockings;
+  blockings[key] = blocking;
+  publish_locked(instance, std::move(blockings));
+}
+
+const GemmBlocking *find(const Blockings &blockings, const Key &key) {
+  auto found = blockings.find(key);
+  return found != blockings.end() ? &found->second : nullptr;
+}
+
+bool tune_on_first_use() {
+  static bool enabled = [] {
+    const char *env = std::getenv(GEMM_TUNE_ENV);
+    return env != nullptr && std::string(env) == "1";
+  }();
+  return enabled;
+}
+
+// Fastest time of a few runs of the packed gemm with blocking.
+double time_gemm(int m, int n, int k, const std::vector<float> &a,
+                 const std::vector<float> &b, std::vector<float> &c,
+                 const GemmBlocking &blocking) {
+  using clock = std::chrono::steady_clock;
+  candidate = &blocking;
+  double best = std::numeric_limits<double>::infinity();
+  double total = 0;
+  for (int run = 0; run < 3 || (run < 20 && total < 0.05); run++) {
+    auto start = clock::now();
+    cpu_kernels().gemm(m, n, k, a.data(), k, 1, b.data(), n, 1, c.data(), n,
+                       false);
+    double seconds =
+        std::chrono::duration<double>(clock::now() - start).count();
+    best = std::min(best, seconds);
+    total += seconds;
+  }
+  candidate = nullptr;
+  return best;
+}
+
+// Coordinate descent over the fields, starting from the defaults. A candidate
+// has to be 2% faster to win, so that noise does not move the blocking.
+GemmBlocking measure(int m, int n, int k) {
+  m = std::min(m, 1024);
+  n = std::min(n, 1024);
+  k = std::min(k, 1024);
+  auto a = std::vector<float>((size_t)m * k);
+  auto b = std::vector<float>((size_t)k * n);
+  auto c = std::vector<float>((size_t)m * n);
+  for (size_t i = 0; i < a.size(); i++)
+    a[i] = (i % 17) * 0.1f - 0.8f;
+  for (size_t i = 0; i < b.size(); i++)
+    b[i] = (i % 13) * 0.1f - 0.6f;
+
+  GemmBlocking best;
+  double best_time = time_gemm(m, n, k, a, b, c, best);
+  auto try_values = [&](auto field, std::initializer_list<long> values) {
+    for (long value : values) {
+      GemmBlocking blocking = best;
+      blocking.*field = value;
+      double time = time_gemm(m, n, k, a, b, c, blocking);
+      if (time < best_time * 0.98) {
+        best = blocking;
+        best_time = time;
+      }
+    }
+  };
+  try_values(&GemmBlocking::kc, {128, 192, 256, 384, 512});
+  try_values(&GemmBlocking::mc, {48, 96, 192, 384});
+  try_values(&GemmBlocking::nc, {1024, 2048, 4096, 8192});
+  try_values(&GemmBlocking::grain_work, {1 << 15, 1 << 16, 1 << 18, 1 << 19});
+  return best;
+}
+
+// tune_gemm with tuning_mutex held.
+GemmBlocking tune_locked(int m, int n, int k) {
+  GemmBlocking blocking = measure(m, n, k);
+  Cache &instance = cache();
+  publish(instance, {get_cpu_capability(), bucket(m, n, k)}, blocking);
+  std::string path;
+  {
+    std::lock_guard<std::mutex> lock(instance.mutex);
+    path = instance.path;
+  }
+  append_to_cache(path, get_cpu_capability(), m, n, k, blocking);
+  return blocking;
+}
+
+} // namespace
+
+bool operator==(const GemmBlocking &a, const GemmBlocking &b) {
+  return a.mc == b.mc && a.kc == b.kc && a.nc == b.nc &&
+         a.grain_work == b.grain_work;
+}
+
+GemmBlocking gemm_blocking(int m, int n, int k) {
+  if (candidate != nullptr)
+    return *candidate;
+  Cache &instance = cache();
+  Key key = {get_cpu_capability(), bucket(m, n, k)};
+  if (auto found = find(published(instance), key))
+    return *found;
+  if (!tune_on_first_use() || parallel::in_parallel_region())
+    return GemmBlocking();
+  std::lock_guard<std::mutex> tuning(tuning_mutex);
+  if (auto found = find(published(instance), key))
+    return *found;
+  return tune_locked(m, n, k);
+}
+
+void set_gemm_blocking(int m, int n, int k, const GemmBlocking &blocking) {
+  publish(cache(), {get_cpu_capability(), bucket(m, n, k)}, blocking);
+}
+
+GemmBlocking tune_gemm(int m, int n, int k) {
+  std::lock_guard<std::mutex> tuning(tuning_mutex);
+  return tune_locked(m, n, k);
+}
+
+void load_gemm_cache(const std::string &path) {
+  Cache &instance = cache();
+  std::string file = path.empty() ? default_cache_path() : path;
+  auto blockings = read_cache(file);
+  std::lock_guard<std::mutex> lock(instance.mutex);
+  instance.path = file;
+  publish_locked(instance, std::move(blockings));
+}
+
+std::string cpu_model() {
+  static std::string model = [] {
+    std::string name;
+#if defined(__x86_64__) || defined(__i386__)
+    unsigned int brand[12] = {};
+    if (__get_cpuid_max(0x80000000, nullptr) >= 0x80000004)
+      for (unsigned int i = 0; i < 3; i++)
+        __get_cpuid(0x80000002 + i, &brand[4 * i], &brand[4 * i + 1],
+                    &brand[4 * i + 2], &brand[4 * i + 3]);
+    name.assign(reinterpret_cast<const char *>(brand), sizeof(brand));
+    name = name.c_str();
+#endif
+    std::replace(name.begin(), name.end(), '\t', ' ');
+    auto first = name.find_first_not_of(' ');
+    auto last = name.find_last_not_of(' ');
+    if (first == std::string::npos)
+      return std::string("unknown");
+    return name.substr(first, last - first + 1);
+  }();
+  return model;
+}
+
+} // namespace kernels
@@ -0,0 +1,53 @@
+#ifndef GEMM_TUNING_H
+#define GEMM_TUNING_H
+
+#include <string>
+
+// File the tuned blockings are kept in. Defaults to ctorch/gemm_blocking
+// under $XDG_CACHE_HOME, ~/.cache or %LOCALAPPDATA%.
+#define GEMM_CACHE_ENV "CTORCH_GEMM_CACHE"
+
+// Set to 1 to tune each shape bucket the first time a product falls in it.
+#define GEMM_TUNE_ENV "CTORCH_GEMM_TUNE"
+
+namespace kernels {
+
+// Cache blocking of the packed float gemm: B is packed in kc x nc panels and
+// A in mc x kc blocks, rounded up to the register tile, and every thread gets
+// at least grain_work multiply-adds. Zero fields take the kernel's defaults.
+struct GemmBlocking {
+  int mc = 0;
+  int kc = 0;
+  int nc = 0;
+  long grain_work = 0;
+};
+
+bool operator==(const GemmBlocking &a, const GemmBlocking &b);
+
+// Blocking for an m x k times k x n product with the active capability: the
+// tuned one for its shape bucket on this CPU, if any. Each dimension falls in
+// one of four buckets, split at 64, 256 and 1024. Without a tuned blocking
+// the bucket is tuned first when GEMM_TUNE_ENV is set, outside parallel
+// regions; otherwise the defaults are used. The cache file is read on first
+// use.
+GemmBlocking gemm_blocking(int m, int n, int k);
+
+// Uses blocking for the bucket of this shape from now on, without saving it.
+void set_gemm_blocking(int m, int n, int k, const GemmBlocking &blocking);
+
+// Times the packed gemm on this shape, clamped to 1024 in each dimension,
+// for candidate values of each field in turn, keeps the fastest blocking for
+// the bucket and appends it to the cache file.
+GemmBlocking tune_gemm(int m, int n, int k);
+
+// Forgets the blockings in use and reads them from the cache file at path,
+// or the default one when path is empty; tune_gemm saves there from then
+// on. Like set_num_threads it must not race with running kernels.
+void load_gemm_cache(const std::string &path = "");
+
+// The CPU model the cache entries are keyed by.
+std::string cpu_model();
+
+} // namespace kernels
+
+#endif // GEMM_TUNING_H
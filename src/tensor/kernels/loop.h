@@ -0,0 +1,153 @@
+#ifndef LOOP_H
+#define LOOP_H
+
+#include "../parallel/parallel.h"
+#include <algorithm>
+#include <array>
+#include <vector>
+
+// Threads are only woken for at least this many elements each.
+#define ELEMENTWISE_GRAIN_SIZE 32768
+// Same for loops that evaluate a polynomial per element.
+#define TRANSCENDENTAL_GRAIN_SIZE 4096
+
+namespace kernels {
+
+// Shape of an elementwise loop and, for each of its N operands, the strides
+// (in elements, 0 along broadcast dimensions) and offset it is read or written
+// with.
+template <int N> struct Layout {
+  std::vector<int> shape;
+  std::array<std::vector<int>, N> strides;
+  std::array<int, N> offsets{};
+};
+
+// Drops size-1 dimensions and merges neighbouring dimensions that every
+// operand walks contiguously, so that the innermost run is as long as
+// possible. A same-shape loop over contiguous operands collapses to one run.
+template <int N> void coalesce(Layout<N> &layout) {
+  std::vector<int> shape;
+  std::array<std::vector<int>, N> strides;
+  for (int d = 0; d < layout.shape.size(); d++) {
+    int size = layout.shape[d];
+    if (size == 1)
+      continue;
+    bool mergeable = !shape.empty();
+    for (int o = 0; o < N && mergeable; o++)
+      mergeable = strides[o].back() == layout.strides[o][d] * size;
+    if (mergeable) {
+      shape.back() *= size;
+      for (int o = 0; o < N; o++)
+        strides[o].back() = layout.strides[o][d];
+      continue;
+    }
+    shape.push_back(size);
+    for (int o = 0; o < N; o++)
+      strides[o].push_back(layout.strides[o][d]);
+  }
+  layout.shape = shape;
+  layout.strides = strides;
+}
+
+// How for_each_run may divide a large loop between threads. Runs hands each
+// thread whole runs and is safe when no two runs write the same element;
+// Inner hands each thread a slice of every run and is safe when the innermost
+// dimension is never reduced over; Any picks whichever gives enough work.
+enum class Split { None, Runs, Inner, Any };
+
+// Calls run(offsets, strides, length) for every run along the innermost
+// dimension, where offsets are the operands' positions at the start of the run
+// and strides their steps within it.
+template <int N, typename Run>
+void for_each_run(const Layout<N> &layout, Run run,
+                  Split split = Split::Any) {
+  const std::vector<int> &shape = layout.shape;
+  int rank = shape.size();
+  long numel = 1;
+  for (int size : shape)
+    numel *= size;
+  if (numel == 0)
+    return;
+
+  int inner = rank > 0 ? shape[rank - 1] : 1;
+  std::array<int, N> inner_strides{};
+  for (int o = 0; rank > 0 && o < N; o++)
+    inner_strides[o] = layout.strides[o][rank - 1];
+  long runs = numel / inner;
+
+  auto run_range = [&](long begin, long end, auto &&callback) {
+    std::vector<int> index(rank > 0 ? rank - 1 : 0);
+    std::array<int, N> offsets = layout.offsets;
+    long rest = begin;
+    for (int d = rank - 2; d >= 0; d--) {
+      index[d] = rest % shape[d];
+      rest /= shape[d];
+      for (int o = 0; o < N; o++)
+        offsets[o] += index[d] * layout.strides[o][d];
+    }
+    for (long r = begin; r < end; r++) {
+      callback(offsets);
+      for (int d = rank - 2; d >= 0; d--) {
+        index[d]++;
+        for (int o = 0; o < N; o++)
+          offsets[o] += layout.strides[o][d];
+        if (index[d] < shape[d])
+          break;
+        for (int o = 0; o < N; o++)
+          offsets[o] -= layout.strides[o][d] * shape[d];
+        index[d] = 0;
+      }
+    }
+  };
+
+  if (split == Split::None || numel < 2 * ELEMENTWISE_GRAIN_SIZE) {
+    run_range(0, runs, [&](const std::array<int, N> &offsets) {
+      run(offsets, inner_strides, inner);
+    });
+    return;
+  }
+  if (split == Split::Any)
+    split = runs >= parallel::get_num_threads() ? Split::Runs : Split::Inner;
+
+  if (split == Split::Runs) {
+    long grain = std::max<long>(1, ELEMENTWISE_GRAIN_SIZE / inner);
+    parallel::parallel_for(0, runs, grain, [&](long begin, long end) {
+      run_range(begin, end, [&](const std::array<int, N> &offsets) {
+        run(offsets, inner_strides, inner);
+      });
+    });
+    return;
+  }
+
+  long grain = std::max<long>(1, ELEMENTWISE_GRAIN_SIZE / runs);
+  parallel::parallel_for(0, inner, grain, [&](long begin, long end) {
+    run_range(0, runs, [&](std::array<int, N> offsets) {
+      for (int o = 0; o < N; o++)
+        offsets[o] += begin * inner_strides[o];
+      run(offsets, inner_strides, end - begin);
+    });
+  });
+}
+
+// Sums partial(begin, end) over consecutive chunks of [0, n), one chunk per
+// thread for large n. The result only depends on the number of threads.
+template <typename DType, typename Partial>
+DType parallel_sum(long n, Partial partial) {
+  long chunks = std::min<long>(parallel::get_num_threads(),
+                               n / ELEMENTWISE_GRAIN_SIZE);
+  if (chunks <= 1 || parallel::in_parallel_region())
+    return partial(0, n);
+  std::vector<DType> sums(chunks);
+  parallel::parallel_for(0, chunks, 1, [&](long begin, long end) {
+    for (long c = begin; c < end; c++)
+      sums[c] = partial(n * c / chunks, n * (c + 1) / chunks);
+  });
+  DType total = 0;
+  for (DType sum : sums)
+    total += sum;
+  return total;
+}
+
+} // namespace kernels
+
+#endif // LOOP_H
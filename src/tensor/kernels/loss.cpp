@@ -0,0 +1,23 @@
+#include "loss.h"
+#include "dispatch.h"
+
+namespace kernels {
+
+void loss(LossOp op, const float *input, const float *target, float delta,
+          float *out, long n) {
+  cpu_kernels().loss(op, input, target, delta, out, n);
+}
+
+float loss_sum(LossOp op, const float *input, const float *target,
+               float delta, long n) {
+  return cpu_kernels().loss_sum(op, input, target, delta, n);
+}
+
+void loss_backward(LossOp op, const float *grad, long grad_stride,
+                   const float *input, const float *target, float delta,
+                   float *input_grad, float *target_grad, long n) {
+  cpu_kernels().loss_backward(op, grad, grad_stride, input, target, delta,
+                              input_grad, target_grad, n);
+}
+
+} // namespace kernels
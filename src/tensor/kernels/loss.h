@@ -0,0 +1,111 @@
+#ifndef KERNELS_LOSS_H
+#define KERNELS_LOSS_H
+
+#include <algorithm>
+#include <cmath>
+
+namespace kernels {
+
+// Elementwise losses of an input x against a target y:
+//   BCE            -(y log x + (1 - y) log(1 - x)), logs clamped at -100
+//   BCEWithLogits  BCE of sigmoid(x), as max(x, 0) - x y + log(1 + e^-|x|)
+//   MSE            (x - y)^2
+//   L1             |x - y|
+//   Huber          (x - y)^2 / 2 within delta of y, linear beyond
+enum class LossOp { BCE, BCEWithLogits, MSE, L1, Huber };
+
+template <typename DType> inline DType clamped_log(DType x) {
+  return std::max(std::log(x), DType(-100));
+}
+
+template <typename DType>
+inline DType loss_value(LossOp op, DType x, DType y, DType delta) {
+  DType d = x - y;
+  switch (op) {
+  case LossOp::BCE:
+    return -(y * clamped_log(x) + (1 - y) * clamped_log(1 - x));
+  case LossOp::BCEWithLogits:
+    return std::max(x, DType(0)) - x * y +
+           std::log1p(std::exp(-std::abs(x)));
+  case LossOp::MSE:
+    return d * d;
+  case LossOp::L1:
+    return std::abs(d);
+  case LossOp::Huber:
+    return std::abs(d) <= delta ? d * d / 2
+                                : delta * (std::abs(d) - delta / 2);
+  }
+  return d;
+}
+
+// Derivative of the loss with respect to x (operand 0) or y (operand 1).
+template <typename DType>
+inline DType loss_grad(LossOp op, int operand, DType x, DType y, DType delta) {
+  DType d = x - y;
+  switch (op) {
+  case LossOp::BCE:
+    if (operand == 0)
+      return d / std::max(x * (1 - x), DType(1e-12));
+    return clamped_log(1 - x) - clamped_log(x);
+  case LossOp::BCEWithLogits:
+    return operand == 0 ? 1 / (1 + std::exp(-x)) - y : -x;
+  case LossOp::MSE:
+    return operand == 0 ? 2 * d : -2 * d;
+  case LossOp::L1:
+    return (operand == 0 ? 1 : -1) * DType((d > 0) - (d < 0));
+  case LossOp::Huber: {
+    DType clipped = std::min(std::max(d, -delta), delta);
+    return operand == 0 ? clipped : -clipped;
+  }
+  }
+  return d;
+}
+
+// out[i] = the loss of input[i] against target[i], for i < n.
+template <typename DType>
+void loss(LossOp op, const DType *input, const DType *target, DType delta,
+          DType *out, long n) {
+  for (long i = 0; i < n; i++)
+    out[i] = loss_value(op, input[i], target[i], delta);
+}
+
+// The sum of the losses, without storing them.
+template <typename DType>
+DType loss_sum(LossOp op, const DType *input, const DType *target,
+               DType delta, long n) {
+  DType sum = 0;
+  for (long i = 0; i < n; i++)
+    sum += loss_value(op, input[i], target[i], delta);
+  return sum;
+}
+
+// input_grad[i] and target_grad[i] += grad[i * grad_stride] times the
+// derivatives of loss i. A grad_stride of 0 broadcasts one gradient, as for a
+// summed loss. Either gradient may be null.
+template <typename DType>
+void loss_backward(LossOp op, const DType *grad, long grad_stride,
+                   const DType *input, const DType *target, DType delta,
+                   DType *input_grad, DType *target_grad, long n) {
+  for (long i = 0; i < n; i++) {
+    DType g = grad[i * grad_stride];
+    if (input_grad != nullptr)
+      input_grad[i] += g * loss_grad(op, 0, input[i], target[i], delta);
+    if (target_grad != nullptr)
+      target_grad[i] += g * loss_grad(op, 1, input[i], target[i], delta);
+  }
+}
+
+// Vectorized versions for float, parallel across elements.
+void loss(LossOp op, const float *input, const float *target, float delta,
+          float *out, long n);
+
+float loss_sum(LossOp op, const float *input, const float *target,
+               float delta, long n);
+
+void loss_backward(LossOp op, const float *grad, long grad_stride,
+                   const float *input, const float *target, float delta,
+                   float *input_grad, float *target_grad, long n);
+
+} // namespace kernels
+
+#endif // KERNELS_LOSS_H
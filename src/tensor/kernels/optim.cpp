@@ -0,0 +1,17 @@
+#include "optim.h"
+#include "dispatch.h"
+
+namespace kernels {
+
+void sgd_step(float *data, const float *grad, float learning_rate, long n) {
+  cpu_kernels().sgd_step(data, grad, learning_rate, n);
+}
+
+void adam_step(float *data, const float *grad, float *m, float *v,
+               float learning_rate, float beta_1, float beta_2, float eps,
+               float bias_correction_1, float bias_correction_2, long n) {
+  cpu_kernels().adam_step(data, grad, m, v, learning_rate, beta_1, beta_2, eps,
+                          bias_correction_1, bias_correction_2, n);
+}
+
+} // namespace kernels
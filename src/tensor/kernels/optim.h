@@ -0,0 +1,17 @@
+#ifndef OPTIM_H
+#define OPTIM_H
+
+namespace kernels {
+
+// data[i] -= learning_rate * grad[i]
+void sgd_step(float *data, const float *grad, float learning_rate, long n);
+
+// One Adam update of data and its first and second moments m and v.
+// bias_correction_1 and _2 are 1 - beta_1^t and 1 - beta_2^t.
+void adam_step(float *data, const float *grad, float *m, float *v,
+               float learning_rate, float beta_1, float beta_2, float eps,
+               float bias_correction_1, float bias_correction_2, long n);
+
+} // namespace kernels
+
+#endif // OPTIM_H
@@ -0,0 +1,21 @@
+#include "reduce.h"
+#include "dispatch.h"
+
+namespace kernels {
+
+void reduce(ReduceOp op, const Reduction &reduction, const float *in,
+            const float *center, float *out) {
+  cpu_kernels().reduce(op, reduction, in, center, out);
+}
+
+void arg_reduce(bool max, const Reduction &reduction, const float *in,
+                float *out, int *indices) {
+  cpu_kernels().arg_reduce(max, reduction, in, out, indices);
+}
+
+void reduce_backward(const Reduction &reduction, const float *coef,
+                     const float *in, const float *center, float *grad_in) {
+  cpu_kernels().reduce_backward(reduction, coef, in, center, grad_in);
+}
+
+} // namespace kernels
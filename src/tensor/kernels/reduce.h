@@ -0,0 +1,178 @@
+#ifndef REDUCE_H
+#define REDUCE_H
+
+#include <cassert>
+#include <limits>
+#include <vector>
+
+namespace kernels {
+
+enum class ReduceOp { Sum, SumSquares, Max, Min };
+
+// A reduction of a contiguous tensor, with its dimensions split into the kept
+// ones, which index the outputs, and the reduced ones, which index the
+// elements combined into each output. Neighbouring dimensions of the same kind
+// are merged and size-1 dimensions dropped. Strides are in elements of the
+// input; both lists are walked row-major.
+struct Reduction {
+  std::vector<int> kept_shape, kept_strides;
+  std::vector<int> reduced_shape, reduced_strides;
+  long outputs = 1;
+  long size = 1;
+};
+
+// reduce[d] marks the dimensions of shape to reduce.
+inline Reduction make_reduction(const std::vector<int> &shape,
+                                const std::vector<bool> &reduce) {
+  Reduction reduction;
+  std::vector<int> strides(shape.size());
+  int stride = 1;
+  for (int d = shape.size() - 1; d >= 0; d--) {
+    strides[d] = stride;
+    stride *= shape[d];
+  }
+  bool previous_reduced = false;
+  for (int d = 0; d < static_cast<int>(shape.size()); d++) {
+    if (shape[d] == 1)
+      continue;
+    auto &dims = reduce[d] ? reduction.reduced_shape : reduction.kept_shape;
+    auto &dim_strides =
+        reduce[d] ? reduction.reduced_strides : reduction.kept_strides;
+    if (!dims.empty() && previous_reduced == reduce[d] &&
+        dim_strides.back() == shape[d] * strides[d]) {
+      dims.back() *= shape[d];
+      dim_strides.back() = strides[d];
+    } else {
+      dims.push_back(shape[d]);
+      dim_strides.push_back(strides[d]);
+    }
+    previous_reduced = reduce[d];
+    (reduce[d] ? reduction.size : reduction.outputs) *= shape[d];
+  }
+  if (reduction.reduced_shape.empty()) {
+    reduction.reduced_shape = {1};
+    reduction.reduced_strides = {1};
+  }
+  return reduction;
+}
+
+// Offset of the index-th position of a row-major walk over shape.
+inline long walk_offset(const std::vector<int> &shape,
+                        const std::vector<int> &strides, long index) {
+  long offset = 0;
+  for (int d = shape.size() - 1; d >= 0; d--) {
+    offset += index % shape[d] * strides[d];
+    index /= shape[d];
+  }
+  return offset;
+}
+
+template <typename DType> DType reduce_identity(ReduceOp op) {
+  switch (op) {
+  case ReduceOp::Max:
+    return std::numeric_limits<DType>::lowest();
+  case ReduceOp::Min:
+    return std::numeric_limits<DType>::max();
+  default:
+    return 0;
+  }
+}
+
+// out[o] = op over the elements reduced into output o. With center given,
+// SumSquares sums (x - center[o])^2 instead of x^2.
+template <typename DType>
+void reduce(ReduceOp op, const Reduction &reduction, const DType *in,
+            const DType *center, DType *out) {
+  for (long o = 0; o < reduction.outputs; o++) {
+    const DType *base =
+        in + walk_offset(reduction.kept_shape, reduction.kept_strides, o);
+    DType result = reduce_identity<DType>(op);
+    for (long p = 0; p < reduction.size; p++) {
+      DType x = base[walk_offset(reduction.reduced_shape,
+                                 reduction.reduced_strides, p)];
+      switch (op) {
+      case ReduceOp::Sum:
+        result += x;
+        break;
+      case ReduceOp::SumSquares:
+        if (center != nullptr)
+          x -= center[o];
+        result += x * x;
+        break;
+      case ReduceOp::Max:
+        result = x > result ? x : result;
+        break;
+      case ReduceOp::Min:
+        result = x < result ? x : result;
+        break;
+      }
+    }
+    out[o] = result;
+  }
+}
+
+// Max (or min) of each output and the position of its first occurrence in
+// the row-major walk over the reduced dimensions.
+template <typename DType>
+void arg_reduce(bool max, const Reduction &reduction, const DType *in,
+                DType *out, int *indices) {
+  assert(reduction.size > 0);
+  for (long o = 0; o < reduction.outputs; o++) {
+    const DType *base =
+        in + walk_offset(reduction.kept_shape, reduction.kept_strides, o);
+    int best = 0;
+    for (long p = 1; p < reduction.size; p++) {
+      DType x = base[walk_offset(reduction.reduced_shape,
+                                 reduction.reduced_strides, p)];
+      DType current = base[walk_offset(reduction.reduced_shape,
+                                       reduction.reduced_strides, best)];
+      if (max ? x > current : x < current)
+        best = p;
+    }
+    out[o] = base[walk_offset(reduction.reduced_shape,
+                              reduction.reduced_strides, best)];
+    indices[o] = best;
+  }
+}
+
+// grad_in[i] += coef[o] for every element i reduced into output o, or
+// coef[o] * (in[i] - center[o]) when in is given; a null center counts as 0.
+template <typename DType>
+void reduce_backward(const Reduction &reduction, const DType *coef,
+                     const DType *in, const DType *center, DType *grad_in) {
+  for (long o = 0; o < reduction.outputs; o++) {
+    long base = walk_offset(reduction.kept_shape, reduction.kept_strides, o);
+    for (long p = 0; p < reduction.size; p++) {
+      long i = base + walk_offset(reduction.reduced_shape,
+                                  reduction.reduced_strides, p);
+      if (in == nullptr)
+        grad_in[i] += coef[o];
+      else
+        grad_in[i] += coef[o] * (in[i] - (center ? center[o] : 0));
+    }
+  }
+}
+
+// grad_in[i] += grad[o] for the element i that arg_reduce picked for o.
+template <typename DType>
+void arg_reduce_backward(const Reduction &reduction, const DType *grad,
+                         const int *indices, DType *grad_in) {
+  for (long o = 0; o < reduction.outputs; o++)
+    grad_in[walk_offset(reduction.kept_shape, reduction.kept_strides, o) +
+            walk_offset(reduction.reduced_shape, reduction.reduced_strides,
+                        indices[o])] += grad[o];
+}
+
+// Vectorized versions for float, parallel across outputs.
+void reduce(ReduceOp op, const Reduction &reduction, const float *in,
+            const float *center, float *out);
+
+void arg_reduce(bool max, const Reduction &reduction, const float *in,
+                float *out, int *indices);
+
+void reduce_backward(const Reduction &reduction, const float *coef,
+                     const float *in, const float *center, float *grad_in);
+
+} // namespace kernels
+
+#endif // REDUCE_H
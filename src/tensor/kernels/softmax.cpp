@@ -0,0 +1,45 @@
+#include "softmax.h"
+#include "dispatch.h"
+
+namespace kernels {
+
+void softmax(const SoftmaxDims &dims, const float *in, float *out, bool log) {
+  cpu_kernels().softmax(dims, in, out, log);
+}
+
+void softmax_backward(const SoftmaxDims &dims, const float *grad,
+                      const float *out, float *grad_in, bool log) {
+  cpu_kernels().softmax_backward(dims, grad, out, grad_in, log);
+}
+
+void cross_entropy(const SoftmaxDims &dims, const float *logits,
+                   const float *target, float smoothing, float *loss,
+                   float *log_sum) {
+  cpu_kernels().cross_entropy(dims, logits, target, smoothing, loss, log_sum);
+}
+
+void cross_entropy_backward(const SoftmaxDims &dims, const float *grad,
+                            const float *logits, const float *target,
+                            float smoothing, const float *log_sum,
+                            float *logits_grad, float *target_grad) {
+  cpu_kernels().cross_entropy_backward(dims, grad, logits, target, smoothing,
+                                       log_sum, logits_grad, target_grad);
+}
+
+void cross_entropy_classes(const SoftmaxDims &dims, const float *logits,
+                           const int *classes, float smoothing, float *loss,
+                           float *log_sum) {
+  cpu_kernels().cross_entropy_classes(dims, logits, classes, smoothing, loss,
+                                      log_sum);
+}
+
+void cross_entropy_classes_backward(const SoftmaxDims &dims, const float *grad,
+                                    const float *logits, const int *classes,
+                                    float smoothing, const float *log_sum,
+                                    float *logits_grad) {
+  cpu_kernels().cross_entropy_classes_backward(dims, grad, logits, classes,
+                                               smoothing, log_sum,
+                                               logits_grad);
+}
+
+} // namespace kernels
@@ -0,0 +1,227 @@
+#ifndef KERNELS_SOFTMAX_H
+#define KERNELS_SOFTMAX_H
+
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace kernels {
+
+// A contiguous tensor seen as [outer, size, inner], with the softmax taken
+// along the middle dimension. Element (o, j, i) is at (o * size + j) * inner
+// + i, and the per-softmax results (o, i) at o * inner + i.
+struct SoftmaxDims {
+  long outer = 1;
+  long size = 1;
+  long inner = 1;
+};
+
+inline SoftmaxDims make_softmax_dims(const std::vector<int> &shape, int dim) {
+  SoftmaxDims dims;
+  for (int d = 0; d < static_cast<int>(shape.size()); d++)
+    (d < dim ? dims.outer : d == dim ? dims.size : dims.inner) *= shape[d];
+  return dims;
+}
+
+// Max of the softmax at x, and the log of the sum of e^(x - max): the
+// log-sum-exp split in two so that neither overflows nor cancels.
+template <typename DType>
+DType log_sum_exp(const SoftmaxDims &dims, const DType *x, DType &max) {
+  max = std::numeric_limits<DType>::lowest();
+  for (long j = 0; j < dims.size; j++)
+    max = x[j * dims.inner] > max ? x[j * dims.inner] : max;
+  DType sum = 0;
+  for (long j = 0; j < dims.size; j++)
+    sum += std::exp(x[j * dims.inner] - max);
+  return std::log(sum);
+}
+
+// out = softmax(in), or log_softmax(in) with log.
+template <typename DType>
+void softmax(const SoftmaxDims &dims, const DType *in, DType *out, bool log) {
+  for (long o = 0; o < dims.outer; o++) {
+    for (long i = 0; i < dims.inner; i++) {
+      long base = o * dims.size * dims.inner + i;
+      DType max;
+      DType log_sum = log_sum_exp(dims, in + base, max);
+      for (long j = 0; j < dims.size; j++) {
+        long k = base + j * dims.inner;
+        DType shifted = in[k] - max - log_sum;
+        out[k] = log ? shifted : std::exp(shifted);
+      }
+    }
+  }
+}
+
+// grad_in += the gradient flowing from grad through out = softmax(in), or
+// log_softmax(in) with log. Only the output is needed:
+//   softmax:     grad_in += out * (grad - sum(grad * out))
+//   log_softmax: grad_in += grad - e^out * sum(grad)
+template <typename DType>
+void softmax_backward(const SoftmaxDims &dims, const DType *grad,
+                      const DType *out, DType *grad_in, bool log) {
+  for (long o = 0; o < dims.outer; o++) {
+    for (long i = 0; i < dims.inner; i++) {
+      long base = o * dims.size * dims.inner + i;
+      DType total = 0;
+      for (long j = 0; j < dims.size; j++) {
+        long k = base + j * dims.inner;
+        total += log ? grad[k] : grad[k] * out[k];
+      }
+      for (long j = 0; j < dims.size; j++) {
+        long k = base + j * dims.inner;
+        grad_in[k] += log ? grad[k] - std::exp(out[k]) * total
+                          : out[k] * (grad[k] - total);
+      }
+    }
+  }
+}
+
+// loss = -sum(target * log_softmax(logits)) for every softmax, computed as
+// log_sum * sum(target) - sum(target * (logits - max)) without forming
+// log_softmax. Label smoothing replaces target with
+// (1 - smoothing) * target + smoothing / size. log_sum, as returned by
+// log_sum_exp, is kept for the backward.
+template <typename DType>
+void cross_entropy(const SoftmaxDims &dims, const DType *logits,
+                   const DType *target, DType smoothing, DType *loss,
+                   DType *log_sum) {
+  for (long o = 0; o < dims.outer; o++) {
+    for (long i = 0; i < dims.inner; i++) {
+      long base = o * dims.size * dims.inner + i;
+      long r = o * dims.inner + i;
+      DType max;
+      log_sum[r] = log_sum_exp(dims, logits + base, max);
+      DType target_sum = 0;
+      DType dot = 0;
+      DType shifted_sum = 0;
+      for (long j = 0; j < dims.size; j++) {
+        long k = base + j * dims.inner;
+        target_sum += target[k];
+        dot += target[k] * (logits[k] - max);
+        shifted_sum += logits[k] - max;
+      }
+      loss[r] = log_sum[r] * ((1 - smoothing) * target_sum + smoothing) -
+                (1 - smoothing) * dot - smoothing * shifted_sum / dims.size;
+    }
+  }
+}
+
+// Gradients of cross_entropy for a loss gradient grad, in one pass over the
+// logits after finding their max and the target sum:
+//   logits_grad += grad * (softmax(logits) * sum(target) - target)
+//   target_grad += grad * -log_softmax(logits)
+// with target smoothed as in the forward; for the logits this is
+// softmax - target when the target sums to one. Either gradient may be null.
+template <typename DType>
+void cross_entropy_backward(const SoftmaxDims &dims, const DType *grad,
+                            const DType *logits, const DType *target,
+                            DType smoothing, const DType *log_sum,
+                            DType *logits_grad, DType *target_grad) {
+  for (long o = 0; o < dims.outer; o++) {
+    for (long i = 0; i < dims.inner; i++) {
+      long base = o * dims.size * dims.inner + i;
+      long r = o * dims.inner + i;
+      DType max = std::numeric_limits<DType>::lowest();
+      DType target_sum = 0;
+      for (long j = 0; j < dims.size; j++) {
+        long k = base + j * dims.inner;
+        max = logits[k] > max ? logits[k] : max;
+        target_sum += target[k];
+      }
+      target_sum = (1 - smoothing) * target_sum + smoothing;
+      for (long j = 0; j < dims.size; j++) {
+        long k = base + j * dims.inner;
+        DType shifted = logits[k] - max - log_sum[r];
+        DType smoothed = (1 - smoothing) * target[k] + smoothing / dims.size;
+        if (logits_grad != nullptr)
+          logits_grad[k] +=
+              grad[r] * (std::exp(shifted) * target_sum - smoothed);
+        if (target_grad != nullptr)
+          target_grad[k] -= grad[r] * (1 - smoothing) * shifted;
+      }
+    }
+  }
+}
+
+// cross_entropy against class indices instead of class probabilities:
+// classes[r] is the class of softmax r, or negative to ignore it, which
+// gives a loss and gradient of 0. The one-hot target is never formed.
+template <typename DType>
+void cross_entropy_classes(const SoftmaxDims &dims, const DType *logits,
+                           const int *classes, DType smoothing, DType *loss,
+                           DType *log_sum) {
+  for (long o = 0; o < dims.outer; o++) {
+    for (long i = 0; i < dims.inner; i++) {
+      long base = o * dims.size * dims.inner + i;
+      long r = o * dims.inner + i;
+      DType max;
+      log_sum[r] = log_sum_exp(dims, logits + base, max);
+      if (classes[r] < 0) {
+        loss[r] = 0;
+        continue;
+      }
+      DType shifted_sum = 0;
+      for (long j = 0; j < dims.size; j++)
+        shifted_sum += logits[base + j * dims.inner] - max;
+      DType picked = logits[base + classes[r] * dims.inner] - max;
+      loss[r] = log_sum[r] - (1 - smoothing) * picked -
+                smoothing * shifted_sum / dims.size;
+    }
+  }
+}
+
+// logits_grad += grad * (softmax(logits) - smoothed one-hot target).
+template <typename DType>
+void cross_entropy_classes_backward(const SoftmaxDims &dims, const DType *grad,
+                                    const DType *logits, const int *classes,
+                                    DType smoothing, const DType *log_sum,
+                                    DType *logits_grad) {
+  for (long o = 0; o < dims.outer; o++) {
+    for (long i = 0; i < dims.inner; i++) {
+      long base = o * dims.size * dims.inner + i;
+      long r = o * dims.inner + i;
+      if (classes[r] < 0)
+        continue;
+      DType max = std::numeric_limits<DType>::lowest();
+      for (long j = 0; j < dims.size; j++) {
+        long k = base + j * dims.inner;
+        max = logits[k] > max ? logits[k] : max;
+      }
+      for (long j = 0; j < dims.size; j++) {
+        long k = base + j * dims.inner;
+        DType shifted = logits[k] - max - log_sum[r];
+        logits_grad[k] += grad[r] * (std::exp(shifted) - smoothing / dims.size);
+      }
+      logits_grad[base + classes[r] * dims.inner] -= grad[r] * (1 - smoothing);
+    }
+  }
+}
+
+// Vectorized versions for float, parallel across softmaxes.
+void softmax(const SoftmaxDims &dims, const float *in, float *out, bool log);
+
+void softmax_backward(const SoftmaxDims &dims, const float *grad,
+                      const float *out, float *grad_in, bool log);
+
+void cross_entropy(const SoftmaxDims &dims, const float *logits,
+                   const float *target, float smoothing, float *loss,
+                   float *log_sum);
+
+void cross_entropy_backward(const SoftmaxDims &dims, const float *grad,
+                            const float *logits, const float *target,
+                            float smoothing, const float *log_sum,
+                            float *logits_grad, float *target_grad);
+
+void cross_entropy_classes(const SoftmaxDims &dims, const float *logits,
+                           const int *classes, float smoothing, float *loss,
+                           float *log_sum);
+
+void cross_entropy_classes_backward(const SoftmaxDims &dims, const float *grad,
+                                    const float *logits, const int *classes,
+                                    float smoothing, const float *log_sum,
+                                    float *logits_grad);
+
+} // namespace kernels
+
+#endif // KERNELS_SOFTMAX_H
@@ -0,0 +1,30 @@
+#include "unary.h"
+#include "dispatch.h"
+#include <atomic>
+#include <cstdlib>
+#include <string>
+
+namespace kernels {
+
+static std::atomic<bool> &fast_math() {
+  static std::atomic<bool> enabled = [] {
+    const char *env = std::getenv(FAST_MATH_ENV);
+    return env != nullptr && std::string(env) == "1";
+  }();
+  return enabled;
+}
+
+bool fast_math_enabled() { return fast_math(); }
+
+void set_fast_math(bool enabled) { fast_math() = enabled; }
+
+void unary(UnaryOp op, const float *in, float *out, long n) {
+  cpu_kernels().unary(op, in, out, n, fast_math());
+}
+
+void unary_backward(UnaryOp op, const float *grad, const float *in,
+                    const float *out, float *target, long n) {
+  cpu_kernels().unary_backward(op, grad, in, out, target, n);
+}
+
+} // namespace kernels
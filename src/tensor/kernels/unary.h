@@ -0,0 +1,100 @@
+#ifndef UNARY_H
+#define UNARY_H
+
+#include <cmath>
+
+// Set to 1 to start with fast_math enabled.
+#define FAST_MATH_ENV "CTORCH_FAST_MATH"
+
+// sqrt(2 / pi) and the cubic coefficient of the tanh form of GELU.
+#define GELU_SCALE 0.7978845608f
+#define GELU_CUBIC 0.044715f
+
+namespace kernels {
+
+// GELU uses the tanh approximation
+// 0.5 x (1 + tanh(sqrt(2 / pi) (x + 0.044715 x^3))), written as x * sigmoid(2u)
+// so that it does not cancel for negative x.
+enum class UnaryOp { Exp, Log, Tanh, Sigmoid, Gelu };
+
+template <typename DType> inline DType apply(UnaryOp op, DType x) {
+  switch (op) {
+  case UnaryOp::Exp:
+    return std::exp(x);
+  case UnaryOp::Log:
+    return std::log(x);
+  case UnaryOp::Tanh:
+    return std::tanh(x);
+  case UnaryOp::Sigmoid:
+    return 1 / (1 + std::exp(-x));
+  case UnaryOp::Gelu:
+    return x / (1 + std::exp(-2 * GELU_SCALE * (x + GELU_CUBIC * x * x * x)));
+  }
+  return x;
+}
+
+// Derivative at x times grad, given y = apply(op, x).
+template <typename DType>
+inline DType apply_grad(UnaryOp op, DType grad, DType x, DType y) {
+  switch (op) {
+  case UnaryOp::Exp:
+    return grad * y;
+  case UnaryOp::Log:
+    return grad / x;
+  case UnaryOp::Tanh:
+    return grad * (1 - y * y);
+  case UnaryOp::Sigmoid:
+    return grad * y * (1 - y);
+  case UnaryOp::Gelu: {
+    DType inner = 2 * GELU_SCALE * (x + GELU_CUBIC * x * x * x);
+    DType s = 1 / (1 + std::exp(-inner));
+    DType slope = 2 * GELU_SCALE * (1 + 3 * GELU_CUBIC * x * x);
+    return grad * (s + x * s * (1 - s) * slope);
+  }
+  }
+  return grad;
+}
+
+// out[i] = op(in[i]) for i < n.
+template <typename DType>
+void unary(UnaryOp op, const DType *in, DType *out, long n) {
+  for (long i = 0; i < n; i++)
+    out[i] = apply(op, in[i]);
+}
+
+// Whether the gradient of op is computed from the output rather than the
+// input; the backward functions below do not read the other one, which may be
+// null.
+inline bool grad_uses_output(UnaryOp op) {
+  return op == UnaryOp::Exp || op == UnaryOp::Tanh || op == UnaryOp::Sigmoid;
+}
+
+// target[i] += the gradient flowing from grad[i] through out[i] = op(in[i]).
+template <typename DType>
+void unary_backward(UnaryOp op, const DType *grad, const DType *in,
+                    const DType *out, DType *target, long n) {
+  bool uses_output = grad_uses_output(op);
+  for (long i = 0; i < n; i++)
+    target[i] += apply_grad(op, grad[i], uses_output ? DType(0) : in[i],
+                            uses_output ? out[i] : DType(0));
+}
+
+// Polynomial versions for float. With fast_math off, exp, log and tanh are
+// within 2 ulp of the exact result and sigmoid within 3 ulp, over the whole
+// float range including subnormals, infinities and NaN. GELU is within 4 ulp
+// for x >= -1; below that the cubic amplifies the rounding of x (16 ulp at
+// x = -3). With fast_math on, exp and sigmoid have a relative error below
+// 1e-5, tanh an absolute error below 2e-6, GELU a relative error below 1e-5
+// for x >= -3, and log skips the special cases, so it is only correct for
+// positive normal inputs.
+void unary(UnaryOp op, const float *in, float *out, long n);
+
+void unary_backward(UnaryOp op, const float *grad, const float *in,
+                    const float *out, float *target, long n);
+
+bool fast_math_enabled();
+void set_fast_math(bool enabled);
+
+} // namespace kernels
+
+#endif // UNARY_H
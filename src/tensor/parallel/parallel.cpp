@@ -0,0 +1,163 @@
+#include "parallel.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace parallel {
+
+static thread_local bool in_parallel = false;
+
+// Workers sleep until run() publishes a batch of tasks, then claim task
+// indices one at a time alongside the thread that called run().
+class ThreadPool {
+public:
+  explicit ThreadPool(int threads) {
+    for (int i = 1; i < threads; i++)
+      workers.emplace_back([this]() { work(); });
+  }
+
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread &worker : workers)
+      worker.join();
+  }
+
+  // Runs task(i) for every i in [0, count) and returns once all are done.
+  // Only one batch runs at a time; a second caller runs its tasks inline.
+  void run(int count, const std::function<void(int)> &task) {
+    std::unique_lock<std::mutex> busy(run_mutex, std::try_to_lock);
+    if (!busy.owns_lock()) {
+      for (int i = 0; i < count; i++)
+        task(i);
+      return;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    current = &task;
+    tasks = count;
+    next = 0;
+    pending = count;
+    error = nullptr;
+    wake.notify_all();
+    while (next < tasks)
+      execute(lock);
+    done.wait(lock, [this]() { return pending == 0; });
+    current = nullptr;
+    tasks = 0;
+    next = 0;
+    if (error)
+      std::rethrow_exception(error);
+  }
+
+private:
+  std::vector<std::thread> workers;
+  std::mutex run_mutex;
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::condition_variable done;
+  const std::function<void(int)> *current = nullptr;
+  int tasks = 0;
+  int next = 0;
+  int pending = 0;
+  std::exception_ptr error;
+  bool stopping = false;
+
+  void work() {
+    in_parallel = true;
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+      wake.wait(lock, [this]() { return stopping || next < tasks; });
+      if (stopping)
+        return;
+      execute(lock);
+    }
+  }
+
+  // Claims and runs the next task; called and returns with `lock` held.
+  void execute(std::unique_lock<std::mutex> &lock) {
+    int index = next++;
+    const std::function<void(int)> *task = current;
+    lock.unlock();
+    bool was_parallel = in_parallel;
+    in_parallel = true;
+    std::exception_ptr thrown = nullptr;
+    try {
+      (*task)(index);
+    } catch (...) {
+      thrown = std::current_exception();
+    }
+    in_parallel = was_parallel;
+    lock.lock();
+    if (thrown && !error)
+      error = thrown;
+    if (--pending == 0)
+      done.notify_all();
+  }
+};
+
+static std::mutex pool_mutex;
+static std::unique_ptr<ThreadPool> pool;
+static std::atomic<int> num_threads = 0;
+
+static int default_num_threads() {
+  if (const char *value = std::getenv(NUM_THREADS_ENV)) {
+    int threads = std::atoi(value);
+    if (threads > 0)
+      return threads;
+  }
+  return std::max(1u, std::thread::hardware_concurrency());
+}
+
+int get_num_threads() {
+  int threads = num_threads.load(std::memory_order_relaxed);
+  if (threads > 0)
+    return threads;
+  std::lock_guard<std::mutex> lock(pool_mutex);
+  if (num_threads == 0)
+    num_threads = default_num_threads();
+  return num_threads;
+}
+
+static ThreadPool &get_pool() {
+  int threads = get_num_threads();
+  std::lock_guard<std::mutex> lock(pool_mutex);
+  if (!pool)
+    pool = std::make_unique<ThreadPool>(threads);
+  return *pool;
+}
+
+void set_num_threads(int threads) {
+  std::lock_guard<std::mutex> lock(pool_mutex);
+  num_threads = std::max(1, threads);
+  pool.reset();
+}
+
+bool in_parallel_region() { return in_parallel; }
+
+void parallel_for(long begin, long end, long grain_size,
+                  const std::function<void(long, long)> &func) {
+  if (begin >= end)
+    return;
+  long range = end - begin;
+  long chunks = range / std::max(1L, grain_size);
+  chunks = std::min<long>(chunks, get_num_threads());
+  if (chunks <= 1 || in_parallel) {
+    func(begin, end);
+    return;
+  }
+  get_pool().run(chunks, [&](int chunk) {
+    func(begin + range * chunk / chunks, begin + range * (chunk + 1) / chunks);
+  });
+}
+
+} // namespace parallel
@@ -0,0 +1,29 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <functional>
+
+// Overrides the default number of threads (one per hardware thread).
+#define NUM_THREADS_ENV "CTORCH_NUM_THREADS"
+
+namespace parallel {
+
+// Size of the process-wide intra-op pool, counting the calling thread.
+// Changing it restarts the workers, so it must not race with a parallel_for.
+int get_num_threads();
+void set_num_threads(int threads);
+
+// True on a thread that is executing a chunk of a parallel_for.
+bool in_parallel_region();
+
+// Calls func(chunk_begin, chunk_end) over [begin, end) split into at most
+// get_num_threads() chunks of at least grain_size iterations each. Ranges
+// below two grains, and calls made from inside another parallel_for, run
+// inline on the calling thread. The first exception thrown by a chunk is
+// rethrown once all chunks have finished.
+void parallel_for(long begin, long end, long grain_size,
+                  const std::function<void(long, long)> &func);
+
+} // namespace parallel
+
+#endif // PARALLEL_H
@@ -0,0 +1,32 @@
+#include "allocator.h"
+#include "caching_allocator.h"
+#include <new>
+
+namespace storage {
+
+void *CPUAllocator::allocate(size_t bytes) {
+  if (bytes == 0)
+    return nullptr;
+  return ::operator new(bytes, std::align_val_t(STORAGE_ALIGNMENT));
+}
+
+void CPUAllocator::deallocate(void *ptr, size_t bytes) {
+  if (ptr == nullptr)
+    return;
+  ::operator delete(ptr, std::align_val_t(STORAGE_ALIGNMENT));
+}
+
+static Allocator *default_allocator = nullptr;
+
+Allocator *get_default_allocator() {
+  if (default_allocator == nullptr)
+    return get_caching_allocator();
+  return default_allocator;
+}
+
+// Passing nullptr restores the caching allocator.
+void set_default_allocator(Allocator *allocator) {
+  default_allocator = allocator;
+}
+
+} // namespace storage
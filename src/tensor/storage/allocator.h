@@ -0,0 +1,30 @@
+#ifndef ALLOCATOR_H
+#define ALLOCATOR_H
+
+#include <cstddef>
+
+#define STORAGE_ALIGNMENT 64
+
+namespace storage {
+
+class Allocator {
+public:
+  virtual ~Allocator() = default;
+  virtual void *allocate(size_t bytes) = 0;
+  virtual void deallocate(void *ptr, size_t bytes) = 0;
+};
+
+// Plain aligned heap allocation, one call to the system allocator per buffer.
+class CPUAllocator : public Allocator {
+public:
+  void *allocate(size_t bytes) override;
+  void deallocate(void *ptr, size_t bytes) override;
+};
+
+// The caching allocator unless replaced through set_default_allocator.
+Allocator *get_default_allocator();
+void set_default_allocator(Allocator *allocator);
+
+} // namespace storage
+
+#endif // ALLOCATOR_H
@@ -0,0 +1,123 @@
+#include "caching_allocator.h"
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <new>
+#include <unordered_map>
+#include <vector>
+
+namespace storage {
+
+static std::atomic<size_t> hits = 0;
+static std::atomic<size_t> misses = 0;
+static std::atomic<size_t> bytes_cached = 0;
+static std::atomic<size_t> bytes_in_use = 0;
+
+static void *system_allocate(size_t bytes) {
+  return ::operator new(bytes, std::align_val_t(STORAGE_ALIGNMENT));
+}
+
+static void system_deallocate(void *ptr) {
+  ::operator delete(ptr, std::align_val_t(STORAGE_ALIGNMENT));
+}
+
+namespace {
+
+struct FreeLists {
+  std::unordered_map<size_t, std::vector<void *>> blocks;
+
+  void clear() {
+    for (auto &[size, list] : blocks) {
+      for (void *ptr : list) {
+        system_deallocate(ptr);
+      }
+      bytes_cached -= size * list.size();
+    }
+    blocks.clear();
+  }
+
+  ~FreeLists();
+};
+
+// Storages can outlive the thread_local free lists (e.g. tensors destroyed
+// during static destruction), so deallocation checks this flag first.
+thread_local bool free_lists_destroyed = false;
+
+FreeLists::~FreeLists() {
+  free_lists_destroyed = true;
+  clear();
+}
+
+FreeLists &free_lists() {
+  thread_local FreeLists lists;
+  return lists;
+}
+
+} // namespace
+
+size_t CachingAllocator::round_size(size_t bytes) {
+  if (bytes <= STORAGE_ALIGNMENT)
+    return STORAGE_ALIGNMENT;
+  // Four size classes per power of two keeps the rounding waste under 25%.
+  size_t step = std::max<size_t>(std::bit_floor(bytes - 1) / 4,
+                                 STORAGE_ALIGNMENT);
+  return (bytes + step - 1) / step * step;
+}
+
+void *CachingAllocator::allocate(size_t bytes) {
+  if (bytes == 0)
+    return nullptr;
+  size_t size = round_size(bytes);
+  bytes_in_use += size;
+
+  auto &list = free_lists().blocks[size];
+  if (!list.empty()) {
+    void *ptr = list.back();
+    list.pop_back();
+    hits++;
+    bytes_cached -= size;
+    return ptr;
+  }
+  misses++;
+  return system_allocate(size);
+}
+
+void CachingAllocator::deallocate(void *ptr, size_t bytes) {
+  if (ptr == nullptr)
+    return;
+  size_t size = round_size(bytes);
+  bytes_in_use -= size;
+
+  if (free_lists_destroyed) {
+    system_deallocate(ptr);
+    return;
+  }
+  free_lists().blocks[size].push_back(ptr);
+  bytes_cached += size;
+}
+
+AllocatorStats CachingAllocator::stats() const {
+  AllocatorStats result;
+  result.hits = hits;
+  result.misses = misses;
+  result.bytes_cached = bytes_cached;
+  result.bytes_in_use = bytes_in_use;
+  return result;
+}
+
+void CachingAllocator::reset_stats() {
+  hits = 0;
+  misses = 0;
+}
+
+void CachingAllocator::empty_cache() {
+  if (!free_lists_destroyed)
+    free_lists().clear();
+}
+
+CachingAllocator *get_caching_allocator() {
+  static CachingAllocator allocator;
+  return &allocator;
+}
+
+} // namespace storage
@@ -0,0 +1,77 @@
+#ifndef STORAGE_H
+#define STORAGE_H
+
+#include "allocator.h"
+#include <cstring>
+#include <functional>
+#include <vector>
+
+namespace storage {
+
+// Selects the Storage constructor that leaves the memory uninitialized, for
+// op outputs the kernels overwrite completely.
+struct Uninitialized {};
+inline constexpr Uninitialized uninitialized{};
+
+// Refcounted (through std::shared_ptr) flat buffer behind one or more
+// variables. The memory either comes from an Allocator, is adopted from a
+// std::vector, or is owned externally and released through a deleter.
+template <typename DType> class Storage {
+public:
+  Storage(size_t size, Allocator *allocator = get_default_allocator());
+  Storage(size_t size, Uninitialized,
+          Allocator *allocator = get_default_allocator());
+  Storage(std::vector<DType> data);
+  Storage(DType *ptr, size_t size, std::function<void(DType *)> deleter);
+  ~Storage();
+
+  Storage(const Storage &) = delete;
+  Storage &operator=(const Storage &) = delete;
+
+  DType *data() const { return ptr; }
+  size_t size() const { return length; }
+  size_t nbytes() const { return length * sizeof(DType); }
+  Allocator *allocator() const { return alloc; }
+
+private:
+  DType *ptr = nullptr;
+  size_t length = 0;
+  Allocator *alloc = nullptr;
+  std::vector<DType> owned;
+  std::function<void(DType *)> deleter;
+};
+
+template <typename DType>
+Storage<DType>::Storage(size_t size, Allocator *allocator)
+    : Storage(size, uninitialized, allocator) {
+  if (ptr != nullptr)
+    std::memset(ptr, 0, nbytes());
+}
+
+template <typename DType>
+Storage<DType>::Storage(size_t size, Uninitialized, Allocator *allocator)
+    : length(size), alloc(allocator) {
+  ptr = static_cast<DType *>(alloc->allocate(nbytes()));
+}
+
+template <typename DType>
+Storage<DType>::Storage(std::vector<DType> data)
+    : length(data.size()), owned(std::move(data)) {
+  ptr = owned.data();
+}
+
+template <typename DType>
+Storage<DType>::Storage(DType *ptr, size_t size,
+                        std::function<void(DType *)> deleter)
+    : ptr(ptr), length(size), deleter(deleter) {}
+
+template <typename DType> Storage<DType>::~Storage() {
+  if (alloc != nullptr)
+    alloc->deallocate(ptr, nbytes());
+  else if (deleter)
+    deleter(ptr);
+}
+
+} // namespace storage
+
+#endif // STORAGE_H
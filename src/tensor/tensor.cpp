@@ -2,6 +2,7 @@
 #include "variable/variable.h"
 #include <cassert>
 #include <memory>
+#include <stdexcept>
 #include <vector>
 
 using namespace variable;
@@ -10,19 +11,39 @@ namespace tensor {
 
 Tensor::Tensor(std::vector<float> data, std::vector<int> shape,
                std::string name)
-    : var(std::make_shared<Variable<>>(data, shape, name)) {}
+    : var(Variable<>::handle(
+          std::make_shared<Variable<>>(std::move(data), shape, name))) {}
 
 Tensor::Tensor(std::vector<float> data, std::vector<int> shape,
                std::vector<Tensor> prev, std::string name)
-    : var(std::make_shared<Variable<>>(data, shape, name)) {
+    : var(Variable<>::handle(
+          std::make_shared<Variable<>>(std::move(data), shape, name))) {
   for (auto &tensor : prev) {
-    var->prev.push_back(tensor.var);
+    var->prev.push_back(tensor.var->shared_from_this());
   }
 }
 
 float &Tensor::get(std::initializer_list<int> args) { return var->get(args); }
 
-Tensor::Tensor(std::shared_ptr<Variable<>> var) : var(var) {}
+Tensor::Tensor(std::shared_ptr<Variable<>> var)
+    : var(Variable<>::handle(var)) {}
+
+std::vector<float> Tensor::data() {
+  if (var->is_contiguous())
+    return var->data;
+  auto values = std::vector<float>(numel());
+  for (int i = 0; i < values.size(); i++)
+    values[i] = var->at(i);
+  return values;
+}
+
+std::vector<float> Tensor::grad() { return grad_span(); }
+
+Span<float> &Tensor::data_span() {
+  if (!var->is_contiguous())
+    throw std::runtime_error("data_span() of a view that is not contiguous");
+  return var->data;
+}
 
 void Tensor::print(bool print_prev) { var->print(print_prev); }
 
@@ -52,6 +73,40 @@ Tensor Tensor::operator>(float value) {
 
 void Tensor::view(std::vector<int> shape) { var->view(shape); }
 
-void Tensor::backward() { var->backward(); }
+void Tensor::backward(bool retain_graph) {
+  var->backward(retain_graph);
+}
+
+void Tensor::backward(Tensor &gradient, bool retain_graph) {
+  if (gradient.shape() != shape())
+    throw std::runtime_error("Gradient shape mismatch");
+  var->backward(gradient.data_span(), retain_graph);
+}
+
+Tensor Tensor::reshape(std::vector<int> shape) {
+  return Tensor(Variable<>::reshape(var, shape));
+}
+
+Tensor Tensor::transpose(int dim0, int dim1) {
+  return Tensor(Variable<>::transpose(var, dim0, dim1));
+}
+
+Tensor Tensor::permute(std::vector<int> dims) {
+  return Tensor(Variable<>::permute(var, dims));
+}
+
+Tensor Tensor::slice(int dim, int start, int end, int step) {
+  return Tensor(Variable<>::slice(var, dim, start, end, step));
+}
+
+Tensor Tensor::narrow(int dim, int start, int length) {
+  return Tensor(Variable<>::narrow(var, dim, start, length));
+}
+
+Tensor Tensor::expand(std::vector<int> shape) {
+  return Tensor(Variable<>::expand(var, shape));
+}
+
+Tensor Tensor::contiguous() { return Tensor(Variable<>::contiguous(var)); }
 
 } // namespace tensor
@@ -1,6 +1,9 @@
 #ifndef TENSOR_H
 #define TENSOR_H
 
+#include "kernels/blas.h"
+#include "kernels/dispatch.h"
+#include "kernels/unary.h"
 #include "variable/variable.h"
 #include <memory>
 #include <string>
@@ -8,8 +11,26 @@
 
 namespace tensor {
 
+using kernels::blas_available;
+using kernels::cpu_capability_name;
+using kernels::CPUCapability;
+using kernels::fast_math_enabled;
+using kernels::gemm_backend_name;
+using kernels::GemmBackend;
+using kernels::get_cpu_capability;
+using kernels::get_gemm_backend;
+using kernels::set_cpu_capability;
+using kernels::set_fast_math;
+using kernels::set_gemm_backend;
+using parallel::get_num_threads;
+using parallel::set_num_threads;
+using variable::InferenceModeGuard;
+using variable::NoGradGuard;
+
 class Tensor {
 public:
+  // A handle, see Variable::handle(): the data is released once no tensor
+  // holds the variable any more, unless the backward of an op saved it.
   std::shared_ptr<variable::Variable<>> var;
   Tensor(std::vector<float> data, std::vector<int> shape,
          std::string name = "");
@@ -19,15 +40,30 @@ public:
 
   float &get(std::initializer_list<int> args);
 
-  std::vector<float> &data() { return var->data; }
-  std::vector<float> &grad() { return var->grad; }
+  // Copies of the elements and of the gradient in row-major order.
+  std::vector<float> data();
+  std::vector<float> grad();
+  // The elements and the gradient in place, without copying them. The spans
+  // do not own them, so keep the tensor alive while using them; views that
+  // are not contiguous throw from data_span(), call contiguous() first.
+  variable::Span<float> &data_span();
+  variable::Span<float> &grad_span() {
+    var->allocate_grad();
+    return var->grad;
+  }
   std::vector<int> &shape() { return var->shape; }
+  int numel() { return var->numel(); }
 
-  float &data(int index) { return var->data[index]; }
-  float &grad(int index) { return var->grad[index]; }
+  float &data(int index) { return var->at(index); }
+  float &grad(int index) {
+    var->allocate_grad();
+    return var->grad[index];
+  }
   int &shape(int index) { return var->shape[index]; }
 
   std::string &name() { return var->name; }
+  std::string full_name() { return var->full_name(); }
+  bool &requires_grad() { return var->requires_grad; }
 
   Tensor operator+(Tensor &other);
   Tensor operator-(Tensor &other);
@@ -38,7 +74,18 @@ public:
 
   void print(bool print_prev = false);
   void view(std::vector<int> shape);
-  void backward();
+  void backward(bool retain_graph = false);
+  // Backward with the gradient of this tensor seeded from gradient.
+  void backward(Tensor &gradient, bool retain_graph = false);
+
+  Tensor reshape(std::vector<int> shape);
+  Tensor transpose(int dim0, int dim1);
+  Tensor permute(std::vector<int> dims);
+  Tensor slice(int dim, int start, int end, int step = 1);
+  Tensor narrow(int dim, int start, int length);
+  Tensor expand(std::vector<int> shape);
+  Tensor contiguous();
+  bool is_contiguous() { return var->is_contiguous(); }
 
 private:
 };
@@ -1,4 +1,6 @@
+#include "tensor_create.h"
 #include "tensor.h"
+#include "storage/storage.h"
 #include "variable/variable.h"
 #include <numeric>
 #include <random>
@@ -7,46 +9,73 @@ using namespace tensor;
 
 namespace tensor {
 
-Tensor zeros(std::vector<int> shape) {
+Tensor zeros(std::vector<int> shape, bool requires_grad) {
   int size =
       std::accumulate(shape.begin(), shape.end(), 1, std::multiplies<int>());
-  auto data = std::vector<float>(size);
-  return Tensor(data, shape, "zeros");
+  auto storage = std::make_shared<storage::Storage<float>>(size);
+  auto result = Tensor(std::make_shared<variable::Variable<>>(
+      storage, 0, shape, variable::Variable<>::compute_strides(shape),
+      std::vector<std::shared_ptr<variable::Variable<>>>(), "zeros"));
+  result.requires_grad() = requires_grad;
+  return result;
 }
 
-Tensor zeros_like(Tensor tensor) { return zeros(tensor.shape()); }
+Tensor zeros_like(Tensor tensor, bool requires_grad) {
+  return zeros(tensor.shape(), requires_grad);
+}
+
+Tensor from_vector(std::vector<float> data, std::vector<int> shape,
+                   bool requires_grad) {
+  auto result = Tensor(std::move(data), shape);
+  result.requires_grad() = requires_grad;
+  return result;
+}
 
 Tensor one_hot(int num, int num_classes) {
-  auto data = std::vector<float>(num_classes, 0);
-  data[num] = 1;
+  auto result = zeros({num_classes});
+  result.data(num) = 1;
+  result.var->op = "one_hot";
+  return result;
+}
 
-  return Tensor(data, {num_classes}, "");
+std::minstd_rand &generator() {
+  thread_local std::minstd_rand gen(std::random_device{}());
+  return gen;
 }
 
-Tensor rand_n(std::vector<int> shape) {
-  std::random_device rd;
-  std::minstd_rand gen(rd());
+void manual_seed(unsigned int seed) { generator().seed(seed); }
+
+Tensor rand_n(std::vector<int> shape, bool requires_grad) {
   std::normal_distribution<> distr(0.0f, 1.0f);
-  int size =
-      std::accumulate(shape.begin(), shape.end(), 1, std::multiplies<int>());
-  auto data = std::vector<float>(size);
-  for (int i = 0; i < size; i++) {
-    data[i] = distr(gen);
+  auto result = zeros(shape, requires_grad);
+  for (auto &value : result.data_span()) {
+    value = distr(generator());
   }
-  return Tensor(data, shape, "rand_n");
+  result.var->op = "rand_n";
+  return result;
 }
 
-Tensor uniform(std::vector<int> shape, float low, float high) {
-  std::random_device rd;
-  std::minstd_rand gen(rd());
+Tensor uniform(std::vector<int> shape, float low, float high,
+               bool requires_grad) {
   std::uniform_real_distribution<> distr(low, high);
+  auto result = zeros(shape, requires_grad);
+  for (auto &value : result.data_span()) {
+    value = distr(generator());
+  }
+  result.var->op = "uniform";
+  return result;
+}
+
+Tensor from_blob(float *data, std::vector<int> shape,
+                 std::function<void(float *)> deleter, bool requires_grad) {
   int size =
       std::accumulate(shape.begin(), shape.end(), 1, std::multiplies<int>());
-  auto data = std::vector<float>(size);
-  for (int i = 0; i < size; i++) {
-    data[i] = distr(gen);
-  }
-  return Tensor(data, shape, "uniform");
+  auto storage = std::make_shared<storage::Storage<float>>(data, size, deleter);
+  auto result = Tensor(std::make_shared<variable::Variable<>>(
+      storage, 0, shape, variable::Variable<>::compute_strides(shape),
+      std::vector<std::shared_ptr<variable::Variable<>>>(), "from_blob"));
+  result.requires_grad() = requires_grad;
+  return result;
 }
 
 } // namespace tensor
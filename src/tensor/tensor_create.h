@@ -2,15 +2,34 @@
 #define TENSOR_CREATE_H
 
 #include "tensor.h"
+#include <functional>
+#include <random>
 #include <vector>
 
 namespace tensor {
 
+// Tensors made here are inputs, masks and constants unless requires_grad is
+// set, as for parameters, and ops on them record no graph.
 tensor::Tensor one_hot(int num, int num_classes);
-tensor::Tensor uniform(std::vector<int> shape, float low, float high);
-tensor::Tensor zeros(std::vector<int> shape);
-tensor::Tensor zeros_like(Tensor tensor);
-tensor::Tensor rand_n(std::vector<int> shape);
+tensor::Tensor uniform(std::vector<int> shape, float low, float high,
+                       bool requires_grad = false);
+tensor::Tensor zeros(std::vector<int> shape, bool requires_grad = false);
+tensor::Tensor zeros_like(Tensor tensor, bool requires_grad = false);
+tensor::Tensor rand_n(std::vector<int> shape, bool requires_grad = false);
+// Takes data over as the tensor's storage, like the Tensor constructor, which
+// makes a tensor that requires grad.
+tensor::Tensor from_vector(std::vector<float> data, std::vector<int> shape,
+                           bool requires_grad = false);
+// The generator uniform and rand_n draw from, one per thread, seeded from
+// std::random_device on first use. A copy of it saves its state, so that
+// assigning the copy back replays the same numbers.
+std::minstd_rand &generator();
+void manual_seed(unsigned int seed);
+// Wraps an externally owned buffer without copying. `deleter` (if any) runs
+// once the last tensor referencing the buffer is destroyed.
+tensor::Tensor from_blob(float *data, std::vector<int> shape,
+                         std::function<void(float *)> deleter = nullptr,
+                         bool requires_grad = false);
 
 } // namespace tensor
 
@@ -7,6 +7,12 @@ namespace tensor {
 
 Tensor tanh(Tensor &tensor) { return Tensor(variable::tanh(tensor.var)); }
 
+Tensor sigmoid(Tensor &tensor) {
+  return Tensor(variable::sigmoid(tensor.var));
+}
+
+Tensor gelu(Tensor &tensor) { return Tensor(variable::gelu(tensor.var)); }
+
 Tensor relu(Tensor &tensor) { return Tensor(variable::relu(tensor.var)); }
 
 Tensor exp(Tensor &tensor) { return Tensor(variable::exp(tensor.var)); }
@@ -17,6 +23,77 @@ Tensor sum(Tensor &tensor, std::optional<int> dim, bool keepdim) {
   return Tensor(variable::sum(tensor.var, dim, keepdim));
 }
 
-Tensor mean(Tensor &tensor) { return Tensor(variable::mean(tensor.var)); }
+Tensor sum(Tensor &tensor, std::vector<int> dims, bool keepdim) {
+  return Tensor(variable::sum(tensor.var, dims, keepdim));
+}
+
+Tensor mean(Tensor &tensor, std::vector<int> dims, bool keepdim) {
+  return Tensor(variable::mean(tensor.var, dims, keepdim));
+}
+
+Tensor max(Tensor &tensor, std::vector<int> dims, bool keepdim) {
+  return Tensor(variable::max(tensor.var, dims, keepdim));
+}
+
+Tensor min(Tensor &tensor, std::vector<int> dims, bool keepdim) {
+  return Tensor(variable::min(tensor.var, dims, keepdim));
+}
+
+Tensor argmax(Tensor &tensor, std::optional<int> dim, bool keepdim) {
+  return Tensor(variable::argmax(tensor.var, dim, keepdim));
+}
+
+Tensor argmin(Tensor &tensor, std::optional<int> dim, bool keepdim) {
+  return Tensor(variable::argmin(tensor.var, dim, keepdim));
+}
+
+Tensor var(Tensor &tensor, std::vector<int> dims, bool keepdim,
+           int correction) {
+  return Tensor(variable::var(tensor.var, dims, keepdim, correction));
+}
+
+Tensor norm(Tensor &tensor, std::vector<int> dims, bool keepdim) {
+  return Tensor(variable::norm(tensor.var, dims, keepdim));
+}
+
+Tensor softmax(Tensor &tensor, std::optional<int> dim) {
+  return Tensor(variable::softmax(tensor.var, dim));
+}
+
+Tensor log_softmax(Tensor &tensor, std::optional<int> dim) {
+  return Tensor(variable::log_softmax(tensor.var, dim));
+}
+
+Tensor softmax_cross_entropy(Tensor &logits, Tensor &target,
+                             float label_smoothing) {
+  return Tensor(
+      variable::softmax_cross_entropy(logits.var, target.var, label_smoothing));
+}
+
+Tensor class_cross_entropy(Tensor &logits, Tensor &target,
+                           float label_smoothing, int ignore_index) {
+  return Tensor(variable::class_cross_entropy(logits.var, target.var,
+                                              label_smoothing, ignore_index));
+}
+
+Tensor nll(Tensor &input, Tensor &target, int ignore_index) {
+  return Tensor(variable::nll(input.var, target.var, ignore_index));
+}
+
+Tensor pointwise_loss(Tensor &input, Tensor &target, kernels::LossOp op,
+                      std::string reduction, float delta) {
+  return Tensor(
+      variable::pointwise_loss(input.var, target.var, op, reduction, delta));
+}
+
+Tensor linear(Tensor &input, Tensor &weight, kernels::Activation activation) {
+  return Tensor(
+      variable::linear<float>(input.var, weight.var, nullptr, activation));
+}
+
+Tensor linear(Tensor &input, Tensor &weight, Tensor &bias,
+              kernels::Activation activation) {
+  return Tensor(variable::linear(input.var, weight.var, bias.var, activation));
+}
 
 } // namespace tensor
@@ -1,18 +1,64 @@
 #ifndef TENSOR_FUNC_H
 #define TENSOR_FUNC_H
 
+#include "kernels/gemm.h"
+#include "kernels/loss.h"
 #include "tensor.h"
 #include <optional>
+#include <vector>
 
 namespace tensor {
 
 Tensor tanh(Tensor &tensor);
+Tensor sigmoid(Tensor &tensor);
+Tensor gelu(Tensor &tensor);
 Tensor relu(Tensor &tensor);
 Tensor log(Tensor &tensor);
 Tensor exp(Tensor &tensor);
+
+// Reductions take a list of dims, counting negative ones from the end, and
+// reduce every dim when it is empty. keepdim leaves the reduced dims in place
+// with size 1.
 Tensor sum(Tensor &tensor, std::optional<int> dim = std::nullopt,
            bool keepdim = false);
-Tensor mean(Tensor &tensor);
+Tensor sum(Tensor &tensor, std::vector<int> dims, bool keepdim = false);
+Tensor mean(Tensor &tensor, std::vector<int> dims = {}, bool keepdim = false);
+Tensor max(Tensor &tensor, std::vector<int> dims = {}, bool keepdim = false);
+Tensor min(Tensor &tensor, std::vector<int> dims = {}, bool keepdim = false);
+Tensor argmax(Tensor &tensor, std::optional<int> dim = std::nullopt,
+              bool keepdim = false);
+Tensor argmin(Tensor &tensor, std::optional<int> dim = std::nullopt,
+              bool keepdim = false);
+Tensor var(Tensor &tensor, std::vector<int> dims = {}, bool keepdim = false,
+           int correction = 1);
+Tensor norm(Tensor &tensor, std::vector<int> dims = {}, bool keepdim = false);
+
+// Softmax along dim, or over every element without dim.
+Tensor softmax(Tensor &tensor, std::optional<int> dim = std::nullopt);
+Tensor log_softmax(Tensor &tensor, std::optional<int> dim = std::nullopt);
+// Per-sample cross-entropy of logits [N, C, ...] against class probabilities
+// of the same shape; the result is shaped [N, ...]. label_smoothing mixes the
+// target with the uniform distribution.
+Tensor softmax_cross_entropy(Tensor &logits, Tensor &target,
+                             float label_smoothing = 0.0f);
+// The same against class indices of shape [N, ...], skipping samples of
+// class ignore_index.
+Tensor class_cross_entropy(Tensor &logits, Tensor &target,
+                           float label_smoothing = 0.0f,
+                           int ignore_index = -100);
+// -input[n, target[n], ...] for log-probabilities input [N, C, ...] and class
+// indices target [N, ...].
+Tensor nll(Tensor &input, Tensor &target, int ignore_index = -100);
+// The elementwise loss op of input against a target of the same shape,
+// reduced by "mean", "sum" or "none".
+Tensor pointwise_loss(Tensor &input, Tensor &target, kernels::LossOp op,
+                      std::string reduction = "mean", float delta = 1.0f);
+// activation(input & weight + bias) for input [..., in], weight [in, out] and
+// bias [out], as one product with the bias and activation fused into it.
+Tensor linear(Tensor &input, Tensor &weight,
+              kernels::Activation activation = kernels::Activation::None);
+Tensor linear(Tensor &input, Tensor &weight, Tensor &bias,
+              kernels::Activation activation = kernels::Activation::None);
 
 } // namespace tensor
 
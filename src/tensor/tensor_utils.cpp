@@ -1,5 +1,7 @@
 #include "tensor_utils.h"
 #include "tensor.h"
+#include "tensor_create.h"
+#include <algorithm>
 #include <cassert>
 #include <vector>
 
@@ -10,14 +12,20 @@ Tensor stack(std::vector<Tensor> tensors) {
   for (auto size : tensors[0].shape()) {
     shape.push_back(size);
   }
-  auto data = std::vector<float>(tensors[0].data().size() * tensors.size());
+  auto result = zeros(shape);
+  result.var->op = "stack";
+  result.requires_grad() = std::any_of(
+      tensors.begin(), tensors.end(),
+      [](Tensor &tensor) { return tensor.requires_grad(); });
+  int size = tensors[0].var->numel();
   for (int i = 0; i < tensors.size(); i++) {
     assert(tensors[i].shape() == tensors[0].shape());
-    for (int j = 0; j < tensors[i].data().size(); j++) {
-      data[i * tensors[i].data().size() + j] = tensors[i].data()[j];
-    }
+    auto tensor = tensors[i].contiguous();
+    auto values = tensor.data_span();
+    std::copy(values.begin(), values.end(),
+              result.data_span().begin() + i * size);
   }
-  return Tensor(data, shape);
+  return result;
 }
 
 } // namespace tensor
@@ -0,0 +1,62 @@
+#ifndef GRAD_MODE_H
+#define GRAD_MODE_H
+
+namespace variable {
+
+// Thread-local switches consulted whenever an op creates its result.
+class GradMode {
+public:
+  static bool is_enabled() { return enabled; }
+  static void set_enabled(bool value) { enabled = value; }
+
+  static bool is_inference() { return inference; }
+  static void set_inference(bool value) { inference = value; }
+
+private:
+  inline static thread_local bool enabled = true;
+  inline static thread_local bool inference = false;
+};
+
+// While alive, op results are leaves: no backward closure, no links to their
+// inputs and no gradient buffer.
+class NoGradGuard {
+public:
+  NoGradGuard() : previous(GradMode::is_enabled()) {
+    GradMode::set_enabled(false);
+  }
+  ~NoGradGuard() { GradMode::set_enabled(previous); }
+
+  NoGradGuard(const NoGradGuard &) = delete;
+  NoGradGuard &operator=(const NoGradGuard &) = delete;
+
+private:
+  bool previous;
+};
+
+// Stricter NoGradGuard for pure forward passes. Results are additionally
+// marked as inference tensors, which may not be used by an op that records
+// a graph once grad mode is back on.
+class InferenceModeGuard {
+public:
+  InferenceModeGuard()
+      : previous_enabled(GradMode::is_enabled()),
+        previous_inference(GradMode::is_inference()) {
+    GradMode::set_enabled(false);
+    GradMode::set_inference(true);
+  }
+  ~InferenceModeGuard() {
+    GradMode::set_enabled(previous_enabled);
+    GradMode::set_inference(previous_inference);
+  }
+
+  InferenceModeGuard(const InferenceModeGuard &) = delete;
+  InferenceModeGuard &operator=(const InferenceModeGuard &) = delete;
+
+private:
+  bool previous_enabled;
+  bool previous_inference;
+};
+
+} // namespace variable
+
+#endif // GRAD_MODE_H
@@ -0,0 +1,52 @@
+#ifndef SPAN_H
+#define SPAN_H
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <initializer_list>
+#include <vector>
+
+namespace variable {
+
+// Non-owning window over a tensor buffer. Behaves like a fixed-size vector:
+// assigning a list or vector copies the values into the window, while copying
+// a Span only rebinds it.
+template <typename DType> class Span {
+public:
+  Span() : ptr(nullptr), length(0) {}
+  Span(DType *ptr, size_t length) : ptr(ptr), length(length) {}
+
+  DType *data() const { return ptr; }
+  size_t size() const { return length; }
+  bool empty() const { return length == 0; }
+
+  DType &operator[](size_t index) const { return ptr[index]; }
+
+  DType *begin() const { return ptr; }
+  DType *end() const { return ptr + length; }
+
+  Span &operator=(std::initializer_list<DType> values) {
+    assert(values.size() == length);
+    std::copy(values.begin(), values.end(), ptr);
+    return *this;
+  }
+
+  Span &operator=(const std::vector<DType> &values) {
+    assert(values.size() == length);
+    std::copy(values.begin(), values.end(), ptr);
+    return *this;
+  }
+
+  operator std::vector<DType>() const {
+    return std::vector<DType>(ptr, ptr + length);
+  }
+
+private:
+  DType *ptr;
+  size_t length;
+};
+
+} // namespace variable
+
+#endif // SPAN_H
@@ -2,42 +2,108 @@
 #define VARIABLE_H
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <functional>
 #include <iostream>
 #include <memory>
 #include <numeric>
+#include <stdexcept>
 #include <string>
 #include <type_traits>
-#include <unordered_set>
+#include <utility>
 #include <vector>
 
-#define ROW_COL_PARALLEL_INNER_TILING_TILE_SIZE 16
-#define EPS 0.0000001f
+#include "../kernels/elementwise.h"
+#include "../kernels/gemm.h"
+#include "../kernels/loop.h"
+#include "../parallel/parallel.h"
+#include "../storage/storage.h"
+#include "grad_mode.h"
+#include "span.h"
 
 namespace variable {
 
 template <typename DType>
 concept Numeric = std::is_arithmetic_v<DType>;
 
-template <Numeric DType = float> class Variable {
+template <Numeric DType = float>
+class Variable : public std::enable_shared_from_this<Variable<DType>> {
 public:
-  std::vector<DType> data;
+  // Views share the storage of the variable they were taken from; `data`
+  // starts at `offset` and is only laid out row-major if is_contiguous().
+  // The gradient has its own contiguous storage, allocated on the first
+  // accumulation into it.
+  std::shared_ptr<storage::Storage<DType>> storage;
+  std::shared_ptr<storage::Storage<DType>> grad_storage;
+  int offset = 0;
+  Span<DType> data;
   std::vector<int> shape;
   std::vector<int> strides;
-  std::vector<DType> grad;
+  Span<DType> grad;
+  bool requires_grad = true;
+  bool is_inference = false;
+  // User-assigned label. Op results leave it empty and are described by
+  // `op` and their inputs, see full_name().
   std::string name = "";
+  const char *op = "";
+  // Passes grad on to the inputs. It refers to this variable and its inputs
+  // by plain pointer, as they are kept alive by prev and by whatever holds
+  // this variable, and reads their data only through what it saved.
   std::function<void(void)> back;
   std::vector<std::shared_ptr<Variable<DType>>> prev;
 
-  Variable<DType>(std::vector<DType> data, std::vector<int> shape,
-                  std::string name = "");
-  Variable<DType>(std::vector<DType> data, std::vector<int> shape,
-                  std::vector<std::shared_ptr<Variable<DType>>> prev,
-                  std::string name = "");
+  Variable(std::vector<DType> data, std::vector<int> shape,
+           std::string name = "");
+  Variable(std::vector<DType> data, std::vector<int> shape,
+           std::vector<std::shared_ptr<Variable<DType>>> prev,
+           std::string name = "");
+  // The result of an op, whose data is left uninitialized for the op to
+  // write.
+  Variable(std::vector<int> shape,
+           std::vector<std::shared_ptr<Variable<DType>>> prev,
+           const char *op = "");
+  Variable(std::shared_ptr<storage::Storage<DType>> storage, int offset,
+           std::vector<int> shape, std::vector<int> strides,
+           std::vector<std::shared_ptr<Variable<DType>>> prev,
+           const char *op = "");
+  ~Variable();
+
+  // Data a closure keeps for the backward, which outlives the variable's own
+  // reference to it; empty if nothing was saved.
+  struct Saved {
+    std::shared_ptr<storage::Storage<DType>> storage;
+    int offset = 0;
+
+    const DType *data() const {
+      return storage != nullptr ? storage->data() + offset : nullptr;
+    }
+  };
+
+  // Saves the data of this variable if needed, so an op can declare what its
+  // backward reads: inputs, output, or nothing.
+  Saved save(bool needed = true) const;
+
+  // The pointer tensors hold a variable by, shared by all of them. The graph
+  // refers to variables by other pointers, so once the last handle is gone
+  // nothing can read the data any more and it is released, unless a closure
+  // saved it.
+  static std::shared_ptr<Variable<DType>>
+  handle(std::shared_ptr<Variable<DType>> variable);
+
+  // Graph naming costs nothing until full_name() is called; turning it off
+  // also stops full_name() from walking the graph.
+  inline static bool naming_enabled = true;
 
   DType &get(std::initializer_list<int> args);
+  // The element at position index of the view in row-major order.
+  DType &at(int index);
+
+  int numel() const;
+  bool is_contiguous() const;
+  void allocate_grad();
 
+  std::string full_name() const;
   void print(bool print_prev = false);
 
   static std::shared_ptr<Variable<DType>>
@@ -65,52 +131,191 @@ public:
 
   void view(std::vector<int> shape);
 
-  void backward();
+  static std::shared_ptr<Variable<DType>>
+  reshape(std::shared_ptr<Variable<DType>> variable, std::vector<int> shape);
+
+  static std::shared_ptr<Variable<DType>>
+  transpose(std::shared_ptr<Variable<DType>> variable, int dim0, int dim1);
 
-private:
+  static std::shared_ptr<Variable<DType>>
+  permute(std::shared_ptr<Variable<DType>> variable, std::vector<int> dims);
+
+  static std::shared_ptr<Variable<DType>>
+  slice(std::shared_ptr<Variable<DType>> variable, int dim, int start, int end,
+        int step = 1);
+
+  static std::shared_ptr<Variable<DType>>
+  narrow(std::shared_ptr<Variable<DType>> variable, int dim, int start,
+         int length);
+
+  static std::shared_ptr<Variable<DType>>
+  expand(std::shared_ptr<Variable<DType>> variable, std::vector<int> shape);
+
+  static std::shared_ptr<Variable<DType>>
+  contiguous(std::shared_ptr<Variable<DType>> variable);
+
+  // Seeds the gradient of this variable with ones and runs the backward pass
+  // of the graph below it. Unless retain_graph is set, every result drops its
+  // closure and inputs once it has passed its gradient on, so the graph is
+  // freed as the pass goes and cannot be run through again.
+  void backward(bool retain_graph = false);
+  // The same with the gradient of this variable seeded from gradient, which
+  // holds numel() values, e.g. the gradient flowing into a recomputed graph.
+  void backward(const Span<DType> &gradient, bool retain_graph = false);
   static std::vector<int> compute_strides(std::vector<int> shape);
 
-  static std::tuple<std::vector<int>, std::vector<int>, std::vector<int>>
+private:
+  std::weak_ptr<Variable<DType>> handle_ref;
+
+  void release_data();
+
+  // Number of the last traversal that reached this variable, which stands in
+  // for a visited set.
+  unsigned long visit = 0;
+  inline static std::atomic<unsigned long> traversals = 0;
 
-  compute_broadcast_strides(Variable<DType> &first, Variable<DType> &second);
+  // The variables below this one, each ahead of its inputs.
+  std::vector<std::shared_ptr<Variable<DType>>> topological_order();
+  static void propagate(Variable<DType> *t, bool retain_graph);
+  // The backward pass from the gradient this variable was seeded with.
+  void propagate_graph(bool retain_graph);
+
+  template <typename Restride>
+  static std::shared_ptr<Variable<DType>>
+  as_view(std::shared_ptr<Variable<DType>> variable, std::vector<int> shape,
+          Restride restride, const char *op);
+
+  template <typename Func>
+  static void for_each_offset(const std::vector<int> &shape,
+                              const std::vector<int> &strides, int offset,
+                              Func func);
+
+  static std::vector<int> broadcast_shape(const std::vector<int> &shape1,
+                                          const std::vector<int> &shape2);
+
+  static std::vector<int> broadcast_strides(const std::vector<int> &shape,
+                                            const std::vector<int> &strides,
+                                            const std::vector<int> &out_shape);
 
   static std::shared_ptr<Variable<DType>>
   transform(std::shared_ptr<Variable<DType>> first,
-            std::shared_ptr<Variable<DType>> second,
-            void (*front)(Variable<DType> *, Variable<DType> *,
-                          Variable<DType> *, int, int, int),
-            void (*back)(Variable<DType> *, Variable<DType> *,
-                         Variable<DType> *, int, int, int),
-            std::string name = "");
-
-  static void transform_rec(int, int, int, int, Variable<DType> *,
-                            Variable<DType> *, Variable<DType> *,
-                            std::vector<int> &, std::vector<int> &,
-                            void (*front)(Variable<DType> *, Variable<DType> *,
-                                          Variable<DType> *, int, int, int));
-
-  // https://siboehm.com/articles/22/Fast-MMM-on-CPU
-  template <bool transpose1 = false, bool transpose2 = false,
-            bool transpose3 = false>
-  static inline void
-  fast_mat_mul(const DType *left, const DType *right, DType *result, int rows,
-               int columns, int inners,
-               int tileSize = ROW_COL_PARALLEL_INNER_TILING_TILE_SIZE);
+            std::shared_ptr<Variable<DType>> second, kernels::BinaryOp op,
+            const char *name = "");
+
+  static void transform_backward(kernels::BinaryOp op, int operand,
+                                 Variable<DType> *first,
+                                 Variable<DType> *second, const DType *a,
+                                 const DType *b, Variable<DType> *out);
 };
 
 template <Numeric DType>
 Variable<DType>::Variable(std::vector<DType> data, std::vector<int> shape,
                           std::string name)
-    : data(data), shape(shape), strides(compute_strides(shape)), name(name),
-      prev(std::vector<std::shared_ptr<Variable<DType>>>()),
-      grad(std::vector<DType>(data.size())), back([]() {}) {}
+    : Variable(std::move(data), shape,
+               std::vector<std::shared_ptr<Variable<DType>>>(), name) {}
 
 template <Numeric DType>
 Variable<DType>::Variable(std::vector<DType> data, std::vector<int> shape,
                           std::vector<std::shared_ptr<Variable<DType>>> prev,
                           std::string name)
-    : data(data), shape(shape), strides(compute_strides(shape)), name(name),
-      prev(prev), grad(std::vector<DType>(data.size())), back([]() {}) {}
+    : Variable(std::make_shared<storage::Storage<DType>>(std::move(data)), 0,
+               shape, compute_strides(shape), prev) {
+  this->name = name;
+}
+
+template <Numeric DType>
+Variable<DType>::Variable(std::vector<int> shape,
+                          std::vector<std::shared_ptr<Variable<DType>>> prev,
+                          const char *op)
+    : Variable(std::make_shared<storage::Storage<DType>>(
+                   std::accumulate(shape.begin(), shape.end(), 1,
+                                   std::multiplies<int>()),
+                   storage::uninitialized),
+               0, shape, compute_strides(shape), prev, op) {}
+
+template <Numeric DType>
+Variable<DType>::Variable(std::shared_ptr<storage::Storage<DType>> storage,
+                          int offset, std::vector<int> shape,
+                          std::vector<int> strides,
+                          std::vector<std::shared_ptr<Variable<DType>>> prev,
+                          const char *op)
+    : storage(storage), offset(offset), shape(shape), strides(strides), op(op),
+      prev(prev), back([]() {}) {
+  int size = numel();
+  int extent = size == 0 ? 0 : 1;
+  for (int i = 0; i < shape.size(); i++) {
+    extent += (shape[i] - 1) * strides[i];
+  }
+  assert(offset + extent <= static_cast<int>(storage->size()));
+  data = Span<DType>(storage->data() + offset, extent);
+  // Handles passed in are replaced by the variables they point to.
+  for (auto &p : this->prev)
+    p = p->shared_from_this();
+
+  // Leaves require grad unless told otherwise; results only do if grad mode
+  // is on and one of their inputs does, and otherwise drop the link to them.
+  is_inference = GradMode::is_inference();
+  if (!prev.empty()) {
+    requires_grad =
+        GradMode::is_enabled() &&
+        std::any_of(prev.begin(), prev.end(),
+                    [](auto &p) { return p->requires_grad; });
+    if (requires_grad &&
+        std::any_of(prev.begin(), prev.end(),
+                    [](auto &p) { return p->is_inference; }))
+      throw std::runtime_error(
+          "Inference tensors cannot be saved for backward");
+    if (!requires_grad)
+      this->prev.clear();
+  }
+}
+
+template <Numeric DType> Variable<DType>::~Variable() {
+  // Inputs held by nothing else are released here one at a time, rather than
+  // through nested destructors that a long chain would overflow the stack
+  // with. Closures refer to their inputs by plain pointer.
+  auto pending = std::move(prev);
+  back = nullptr;
+  while (!pending.empty()) {
+    auto p = std::move(pending.back());
+    pending.pop_back();
+    if (p.use_count() != 1)
+      continue;
+    p->back = nullptr;
+    for (auto &q : p->prev)
+      pending.push_back(std::move(q));
+    p->prev.clear();
+  }
+}
+
+template <Numeric DType>
+typename Variable<DType>::Saved Variable<DType>::save(bool needed) const {
+  if (!needed)
+    return Saved();
+  return Saved{storage, offset};
+}
+
+template <Numeric DType>
+std::shared_ptr<Variable<DType>>
+Variable<DType>::handle(std::shared_ptr<Variable<DType>> variable) {
+  if (auto existing = variable->handle_ref.lock())
+    return existing;
+  auto node = variable->shared_from_this();
+  // The deleter lives as long as handle_ref does, so it lets go of the
+  // variable once it has run.
+  auto owner = std::shared_ptr<void>(nullptr, [node](void *) mutable {
+    node->release_data();
+    node.reset();
+  });
+  auto result = std::shared_ptr<Variable<DType>>(owner, node.get());
+  node->handle_ref = result;
+  return result;
+}
+
+template <Numeric DType> void Variable<DType>::release_data() {
+  storage = nullptr;
+  data = Span<DType>();
+}
 
 template <Numeric DType>
 DType &Variable<DType>::get(std::initializer_list<int> args) {
@@ -123,8 +328,50 @@ DType &Variable<DType>::get(std::initializer_list<int> args) {
   return data[index];
 }
 
+template <Numeric DType> DType &Variable<DType>::at(int index) {
+  assert(index >= 0 && index < numel());
+  int position = 0;
+  for (int d = static_cast<int>(shape.size()) - 1; d >= 0; d--) {
+    position += index % shape[d] * strides[d];
+    index /= shape[d];
+  }
+  return data[position];
+}
+
+template <Numeric DType> int Variable<DType>::numel() const {
+  return std::accumulate(shape.begin(), shape.end(), 1,
+                         std::multiplies<int>());
+}
+
+template <Numeric DType> bool Variable<DType>::is_contiguous() const {
+  int expected = 1;
+  for (int i = static_cast<int>(shape.size()) - 1; i >= 0; i--) {
+    if (shape[i] != 1 && strides[i] != expected)
+      return false;
+    expected *= shape[i];
+  }
+  return true;
+}
+
+template <Numeric DType> void Variable<DType>::allocate_grad() {
+  if (grad_storage != nullptr)
+    return;
+  grad_storage = std::make_shared<storage::Storage<DType>>(numel());
+  grad = Span<DType>(grad_storage->data(), numel());
+}
+
+template <Numeric DType> std::string Variable<DType>::full_name() const {
+  if (!name.empty())
+    return name;
+  if (!naming_enabled || prev.empty())
+    return op;
+  if (prev.size() == 2)
+    return prev[0]->full_name() + " " + op + " " + prev[1]->full_name();
+  return std::string(op) + "(" + prev[0]->full_name() + ")";
+}
+
 template <Numeric DType> void Variable<DType>::print(bool print_prev) {
-  std::cout << name;
+  std::cout << full_name();
   std::cout << std::endl << "Data: ";
   for (int i = 0; i < std::min(static_cast<int>(this->data.size()), 10); i++) {
     std::cout << this->data[i] << " ";
@@ -157,101 +404,179 @@ template <Numeric DType>
 std::shared_ptr<Variable<DType>>
 Variable<DType>::add(std::shared_ptr<Variable<DType>> first,
                      std::shared_ptr<Variable<DType>> second) {
-  auto front = [](Variable<DType> *first, Variable<DType> *second,
-                  Variable<DType> *out, int i, int j,
-                  int k) { out->data[k] = first->data[i] + second->data[j]; };
-  auto back = [](Variable<DType> *first, Variable<DType> *second,
-                 Variable<DType> *out, int i, int j, int k) {
-    first->grad[i] += out->grad[k];
-    second->grad[j] += out->grad[k];
-  };
-  return transform(first, second, front, back, "+");
+  return transform(first, second, kernels::BinaryOp::Add, "+");
 }
 
 template <Numeric DType>
 std::shared_ptr<Variable<DType>>
 Variable<DType>::sub(std::shared_ptr<Variable<DType>> first,
                      std::shared_ptr<Variable<DType>> second) {
-  auto front = [](Variable<DType> *first, Variable<DType> *second,
-                  Variable<DType> *out, int i, int j,
-                  int k) { out->data[k] = first->data[i] - second->data[j]; };
-  auto back = [](Variable<DType> *first, Variable<DType> *second,
-                 Variable<DType> *out, int i, int j, int k) {
-    first->grad[i] += out->grad[k];
-    second->grad[j] -= out->grad[k];
-  };
-  return transform(first, second, front, back, "-");
+  return transform(first, second, kernels::BinaryOp::Sub, "-");
 }
 
 template <Numeric DType>
 std::shared_ptr<Variable<DType>>
 Variable<DType>::mul(std::shared_ptr<Variable<DType>> first,
                      std::shared_ptr<Variable<DType>> second) {
-  auto front = [](Variable<DType> *first, Variable<DType> *second,
-                  Variable<DType> *out, int i, int j,
-                  int k) { out->data[k] = first->data[i] * second->data[j]; };
-  auto back = [](Variable<DType> *first, Variable<DType> *second,
-                 Variable<DType> *out, int i, int j, int k) {
-    first->grad[i] += second->data[j] * out->grad[k];
-    second->grad[j] += first->data[i] * out->grad[k];
-  };
-  return transform(first, second, front, back, "*");
+  return transform(first, second, kernels::BinaryOp::Mul, "*");
 }
 
 template <Numeric DType>
 std::shared_ptr<Variable<DType>>
 Variable<DType>::div(std::shared_ptr<Variable<DType>> first,
                      std::shared_ptr<Variable<DType>> second) {
-  auto front = [](Variable<DType> *first, Variable<DType> *second,
-                  Variable<DType> *out, int i, int j, int k) {
-    out->data[k] = first->data[i] / (second->data[j] + EPS);
-  };
-  auto back = [](Variable<DType> *first, Variable<DType> *second,
-                 Variable<DType> *out, int i, int j, int k) {
-    first->grad[i] += 1.0 / (second->data[j]) * out->grad[k] + EPS;
-    second->grad[j] +=
-        -first->data[i] / (second->data[j] * second->data[j]) * out->grad[k] +
-        EPS;
-  };
-  return transform(first, second, front, back, "/");
+  return transform(first, second, kernels::BinaryOp::Div, "/");
 }
 
 template <Numeric DType>
 std::shared_ptr<Variable<DType>>
 Variable<DType>::mat_mul(std::shared_ptr<Variable<DType>> first,
                          std::shared_ptr<Variable<DType>> second) {
-  assert(first->shape.back() == second->shape.front());
-  auto shape1 = std::vector<int>{
-      static_cast<int>(first->data.size() / first->shape.back()),
-      first->shape.back()};
-  auto shape2 = std::vector<int>{
-      second->shape.front(),
-      static_cast<int>(second->data.size() / second->shape.front())};
-
-  auto shape = std::vector<int>(first->shape.size() + second->shape.size() - 2);
-  for (int i = 0; i < shape.size(); i++) {
-    if (i < first->shape.size() - 1)
-      shape[i] = first->shape[i];
-    else {
-      int j = i - first->shape.size() + 2;
-      shape[i] = second->shape[j];
-    }
+  // Vectors take part as a single row (left) or column (right), and that
+  // dimension is dropped from the result. Everything before the last two
+  // dimensions is a batch dimension and is broadcast.
+  auto shape1 = first->shape, strides1 = first->strides;
+  auto shape2 = second->shape, strides2 = second->strides;
+  if (shape1.size() == 1) {
+    shape1.insert(shape1.begin(), 1);
+    strides1.insert(strides1.begin(), 0);
+  }
+  if (shape2.size() == 1) {
+    shape2.push_back(1);
+    strides2.push_back(0);
   }
-  auto data = std::vector<float>(shape1[0] * shape2[1], 0);
-  fast_mat_mul(first->data.data(), second->data.data(), data.data(), shape1[0],
-               shape2[1], shape1[1]);
+  int rank1 = shape1.size(), rank2 = shape2.size();
+  assert(shape1[rank1 - 1] == shape2[rank2 - 2]);
+  int rows = shape1[rank1 - 2], inners = shape1[rank1 - 1];
+  int columns = shape2[rank2 - 1];
+  int row1 = strides1[rank1 - 2], col1 = strides1[rank1 - 1];
+  int row2 = strides2[rank2 - 2], col2 = strides2[rank2 - 1];
+
+  auto batch1 = std::vector<int>(shape1.begin(), shape1.end() - 2);
+  auto batch2 = std::vector<int>(shape2.begin(), shape2.end() - 2);
+  auto batch = broadcast_shape(batch1, batch2);
+  auto shape = batch;
+  if (first->shape.size() > 1)
+    shape.push_back(rows);
+  if (second->shape.size() > 1)
+    shape.push_back(columns);
   auto prev = std::vector<std::shared_ptr<Variable<DType>>>{first, second};
-  auto out = std::make_shared<Variable<DType>>(
-      data, shape, prev, first->name + " & " + second->name);
+  auto out = std::make_shared<Variable<DType>>(shape, prev, "&");
+
+  // A contiguous left operand times a matrix is a single product with the
+  // batch folded into the rows.
+  if (batch2.empty() && first->is_contiguous()) {
+    int total_rows = columns > 0 ? out->numel() / columns : 0;
+    kernels::gemm(total_rows, columns, inners, first->data.data(), inners, 1,
+                  second->data.data(), row2, col2, out->data.data(), columns,
+                  false);
+    if (!out->requires_grad)
+      return out;
 
-  auto backward = [out, first, second, shape1, shape2]() {
-    fast_mat_mul<false, true, false>(out->grad.data(), second->data.data(),
-                                     first->grad.data(), shape1[0], shape1[1],
-                                     shape2[1]);
+    // Each operand is only needed for the gradient of the other one.
+    auto backward = [out = out.get(), first = first.get(),
+                     second = second.get(),
+                     a = first->save(second->requires_grad),
+                     b = second->save(first->requires_grad), total_rows,
+                     inners, columns, row2, col2]() {
+      // dL/dfirst += dL/dout * second^T and dL/dsecond += first^T * dL/dout,
+      // with the transposes read by the packing routines rather than copied.
+      if (first->requires_grad)
+        kernels::gemm(total_rows, inners, columns, out->grad.data(), columns,
+                      1, b.data(), col2, row2, first->grad.data(), inners,
+                      true);
+      if (second->requires_grad)
+        kernels::gemm(inners, columns, total_rows, a.data(), 1, inners,
+                      out->grad.data(), columns, 1, second->grad.data(),
+                      columns, true);
+    };
+    out->back = backward;
+    return out;
+  }
 
-    fast_mat_mul<true, false, false>(first->data.data(), out->grad.data(),
-                                     second->grad.data(), shape1[1], shape2[1],
-                                     shape1[0]);
+  // Offsets of every matrix in the batch, for the output, both inputs and
+  // both input gradients.
+  auto head = [](const std::vector<int> &strides, int rank) {
+    return std::vector<int>(strides.begin(), strides.begin() + rank);
+  };
+  auto grad_strides1 = compute_strides(shape1);
+  auto grad_strides2 = compute_strides(shape2);
+  kernels::Layout<5> layout = {
+      batch,
+      {head(out->strides, batch.size()),
+       broadcast_strides(batch1, head(strides1, batch1.size()), batch),
+       broadcast_strides(batch2, head(strides2, batch2.size()), batch),
+       broadcast_strides(batch1, head(grad_strides1, batch1.size()), batch),
+       broadcast_strides(batch2, head(grad_strides2, batch2.size()), batch)},
+      {0, first->offset, second->offset, 0, 0}};
+  auto offsets = std::vector<std::array<int, 5>>();
+  kernels::for_each_run(
+      layout,
+      [&](std::array<int, 5> start, const std::array<int, 5> &strides, int n) {
+        for (int i = 0; i < n; i++) {
+          offsets.push_back(start);
+          for (int o = 0; o < 5; o++)
+            start[o] += strides[o];
+        }
+      },
+      kernels::Split::None);
+  int count = offsets.size();
+  // Small matrices are spread over threads by batch, large ones by tiles
+  // inside gemm.
+  bool by_batch = count >= parallel::get_num_threads();
+
+  DType *result = out->storage->data();
+  const DType *a = first->storage->data();
+  const DType *b = second->storage->data();
+  parallel::parallel_for(0, count, by_batch ? 1 : count, [&](long begin,
+                                                             long end) {
+    for (long i = begin; i < end; i++)
+      kernels::gemm(rows, columns, inners, a + offsets[i][1], row1, col1,
+                    b + offsets[i][2], row2, col2, result + offsets[i][0],
+                    columns, false);
+  });
+
+  if (!out->requires_grad)
+    return out;
+
+  // Gradients of an operand broadcast over the batch are summed over it, so
+  // those products must not run concurrently.
+  bool broadcast1 = first->numel() < rows * inners * count;
+  bool broadcast2 = second->numel() < inners * columns * count;
+  // The offsets include those of the operands, so the whole storage is
+  // saved.
+  auto backward = [out = out.get(), first = first.get(),
+                   second = second.get(),
+                   saved_a = Saved{second->requires_grad ? first->storage
+                                                         : nullptr},
+                   saved_b = Saved{first->requires_grad ? second->storage
+                                                        : nullptr},
+                   offsets, rows, inners, columns, row1, col1, row2, col2,
+                   by_batch, broadcast1, broadcast2]() {
+    int count = offsets.size();
+    const DType *out_grad = out->grad.data();
+    const DType *a = saved_a.data();
+    const DType *b = saved_b.data();
+    if (first->requires_grad) {
+      DType *grad = first->grad.data();
+      long grain = by_batch && !broadcast1 ? 1 : count;
+      parallel::parallel_for(0, count, grain, [&](long begin, long end) {
+        for (long i = begin; i < end; i++)
+          kernels::gemm(rows, inners, columns, out_grad + offsets[i][0],
+                        columns, 1, b + offsets[i][2], col2, row2,
+                        grad + offsets[i][3], inners, true);
+      });
+    }
+    if (second->requires_grad) {
+      DType *grad = second->grad.data();
+      long grain = by_batch && !broadcast2 ? 1 : count;
+      parallel::parallel_for(0, count, grain, [&](long begin, long end) {
+        for (long i = begin; i < end; i++)
+          kernels::gemm(inners, columns, rows, a + offsets[i][1], col1, row1,
+                        out_grad + offsets[i][0], columns, 1,
+                        grad + offsets[i][4], columns, true);
+      });
+    }
   };
   out->back = backward;
 
@@ -261,18 +586,21 @@ Variable<DType>::mat_mul(std::shared_ptr<Variable<DType>> first,
 template <Numeric DType>
 std::shared_ptr<Variable<DType>>
 Variable<DType>::greater(std::shared_ptr<Variable<DType>> variable, float val) {
-  auto data = std::vector<float>(variable->data.size());
+  variable = contiguous(variable);
+  auto prev = std::vector<std::shared_ptr<Variable<DType>>>{variable};
+  auto out = std::make_shared<Variable<DType>>(variable->shape, prev, ">");
   for (int i = 0; i < variable->data.size(); i++) {
-    data[i] = variable->data[i] > val;
+    out->data[i] = variable->data[i] > val;
   }
 
-  auto prev = std::vector<std::shared_ptr<Variable<DType>>>{variable};
-  auto out = std::make_shared<Variable<DType>>(
-      data, variable->shape, prev, std::to_string(val) + "<" + variable->name);
+  if (!out->requires_grad)
+    return out;
 
-  auto backward = [variable, out, val]() {
+  auto backward = [variable = variable.get(), out = out.get(),
+                   result = out->save(), val]() {
+    const DType *data = result.data();
     for (int i = 0; i < out->grad.size(); i++) {
-      if (out->data[i] > val) {
+      if (data[i] > val) {
         variable->grad[i] += out->grad[i];
       }
     }
@@ -284,39 +612,243 @@ Variable<DType>::greater(std::shared_ptr<Variable<DType>> variable, float val) {
 template <Numeric DType> void Variable<DType>::view(std::vector<int> shape) {
   auto dim1 =
       std::accumulate(shape.begin(), shape.end(), 1, std::multiplies<int>());
-  auto dim2 = std::accumulate(this->shape.begin(), this->shape.end(), 1,
-                              std::multiplies<int>());
-  assert(dim1 == dim2);
+  assert(dim1 == numel());
+  // Strides over the storage of a strided view would read the wrong elements.
+  if (!is_contiguous())
+    throw std::runtime_error("view() of a tensor that is not contiguous");
   this->shape = shape;
+  this->strides = compute_strides(shape);
 }
 
-template <Numeric DType> void Variable<DType>::backward() {
-  auto topo = std::vector<Variable<DType> *>();
-  auto visited = std::unordered_set<Variable<DType> *>();
-  std::function<void(Variable<DType> *)> build_topo = [&](Variable<DType> *t) {
-    if (visited.find(t) != visited.end()) {
-      return;
+template <Numeric DType>
+std::shared_ptr<Variable<DType>>
+Variable<DType>::reshape(std::shared_ptr<Variable<DType>> variable,
+                         std::vector<int> shape) {
+  int known = 1;
+  int inferred = -1;
+  for (int i = 0; i < shape.size(); i++) {
+    if (shape[i] == -1) {
+      assert(inferred == -1);
+      inferred = i;
+    } else {
+      known *= shape[i];
     }
-    visited.insert(t);
-    for (const auto &p : t->prev) {
-      build_topo(p.get());
+  }
+  if (inferred != -1)
+    shape[inferred] = variable->numel() / known;
+  assert(std::accumulate(shape.begin(), shape.end(), 1,
+                         std::multiplies<int>()) == variable->numel());
+
+  if (!variable->is_contiguous())
+    variable = contiguous(variable);
+  auto restride = [shape](std::vector<int> strides, int offset) {
+    return std::make_pair(compute_strides(shape), offset);
+  };
+  return as_view(variable, shape, restride, "reshape");
+}
+
+template <Numeric DType>
+std::shared_ptr<Variable<DType>>
+Variable<DType>::transpose(std::shared_ptr<Variable<DType>> variable, int dim0,
+                           int dim1) {
+  assert(dim0 < variable->shape.size() && dim1 < variable->shape.size());
+  auto shape = variable->shape;
+  std::swap(shape[dim0], shape[dim1]);
+  auto restride = [dim0, dim1](std::vector<int> strides, int offset) {
+    std::swap(strides[dim0], strides[dim1]);
+    return std::make_pair(strides, offset);
+  };
+  return as_view(variable, shape, restride, "transpose");
+}
+
+template <Numeric DType>
+std::shared_ptr<Variable<DType>>
+Variable<DType>::permute(std::shared_ptr<Variable<DType>> variable,
+                         std::vector<int> dims) {
+  assert(dims.size() == variable->shape.size());
+  auto shape = std::vector<int>(dims.size());
+  for (int i = 0; i < dims.size(); i++) {
+    assert(std::count(dims.begin(), dims.end(), i) == 1);
+    shape[i] = variable->shape[dims[i]];
+  }
+  auto restride = [dims](std::vector<int> strides, int offset) {
+    auto permuted = std::vector<int>(dims.size());
+    for (int i = 0; i < dims.size(); i++) {
+      permuted[i] = strides[dims[i]];
+    }
+    return std::make_pair(permuted, offset);
+  };
+  return as_view(variable, shape, restride, "permute");
+}
+
+template <Numeric DType>
+std::shared_ptr<Variable<DType>>
+Variable<DType>::slice(std::shared_ptr<Variable<DType>> variable, int dim,
+                       int start, int end, int step) {
+  assert(dim < variable->shape.size());
+  assert(0 <= start && start <= end && end <= variable->shape[dim]);
+  assert(step > 0);
+  auto shape = variable->shape;
+  shape[dim] = (end - start + step - 1) / step;
+  auto restride = [dim, start, step](std::vector<int> strides, int offset) {
+    offset += start * strides[dim];
+    strides[dim] *= step;
+    return std::make_pair(strides, offset);
+  };
+  return as_view(variable, shape, restride, "slice");
+}
+
+template <Numeric DType>
+std::shared_ptr<Variable<DType>>
+Variable<DType>::narrow(std::shared_ptr<Variable<DType>> variable, int dim,
+                       int start, int length) {
+  return slice(variable, dim, start, start + length);
+}
+
+template <Numeric DType>
+std::shared_ptr<Variable<DType>>
+Variable<DType>::expand(std::shared_ptr<Variable<DType>> variable,
+                        std::vector<int> shape) {
+  assert(shape.size() >= variable->shape.size());
+  int leading = shape.size() - variable->shape.size();
+  for (int i = 0; i < shape.size(); i++) {
+    if (i < leading) {
+      assert(shape[i] >= 0);
+      continue;
+    }
+    int size = variable->shape[i - leading];
+    if (shape[i] == -1)
+      shape[i] = size;
+    assert(shape[i] == size || size == 1);
+  }
+  // Broadcast dimensions get a zero stride, so gradients of repeated
+  // elements are summed back into the same slot.
+  auto source_shape = variable->shape;
+  auto restride = [shape, source_shape, leading](std::vector<int> strides,
+                                                 int offset) {
+    auto expanded = std::vector<int>(shape.size(), 0);
+    for (int i = leading; i < shape.size(); i++) {
+      if (source_shape[i - leading] == shape[i])
+        expanded[i] = strides[i - leading];
+    }
+    return std::make_pair(expanded, offset);
+  };
+  return as_view(variable, shape, restride, "expand");
+}
+
+template <Numeric DType>
+std::shared_ptr<Variable<DType>>
+Variable<DType>::contiguous(std::shared_ptr<Variable<DType>> variable) {
+  if (variable->is_contiguous())
+    return variable;
+
+  auto prev = std::vector<std::shared_ptr<Variable<DType>>>{variable};
+  auto out =
+      std::make_shared<Variable<DType>>(variable->shape, prev, "contiguous");
+
+  const DType *source = variable->storage->data();
+  int k = 0;
+  for_each_offset(variable->shape, variable->strides, variable->offset,
+                  [&](int index) { out->data[k++] = source[index]; });
+
+  // The copy is an intermediate result, released once the caller is done.
+  if (!out->requires_grad)
+    return handle(out);
+
+  auto backward = [variable = variable.get(), out = out.get()]() {
+    for (int i = 0; i < out->grad.size(); i++) {
+      variable->grad[i] += out->grad[i];
     }
-    topo.push_back(t);
   };
+  out->back = backward;
+  return handle(out);
+}
+
+template <Numeric DType>
+std::vector<std::shared_ptr<Variable<DType>>>
+Variable<DType>::topological_order() {
+  // Depth-first with an explicit stack, so that long chains cannot overflow
+  // the call stack. Each entry holds the link to a variable, null for this
+  // one, and the next input to descend into.
+  unsigned long traversal = ++traversals;
+  auto order = std::vector<std::shared_ptr<Variable<DType>>>();
+  using Link = const std::shared_ptr<Variable<DType>> *;
+  auto stack = std::vector<std::pair<Link, size_t>>();
+  visit = traversal;
+  stack.emplace_back(nullptr, 0);
+  while (!stack.empty()) {
+    auto &[link, next] = stack.back();
+    Variable<DType> *t = link != nullptr ? link->get() : this;
+    if (next == t->prev.size()) {
+      if (link != nullptr)
+        order.push_back(*link);
+      stack.pop_back();
+      continue;
+    }
+    const auto &p = t->prev[next++];
+    if (p->visit != traversal) {
+      p->visit = traversal;
+      stack.emplace_back(&p, 0);
+    }
+  }
+  std::reverse(order.begin(), order.end());
+  return order;
+}
 
+template <Numeric DType>
+void Variable<DType>::propagate(Variable<DType> *t, bool retain_graph) {
+  if (!t->back)
+    throw std::runtime_error("Cannot backward through a graph that was freed "
+                             "by an earlier backward");
+  if (t->grad_storage != nullptr && t->requires_grad) {
+    for (const auto &p : t->prev) {
+      if (p->requires_grad)
+        p->allocate_grad();
+    }
+    t->back();
+  }
+  // Leaves keep their no-op closure, as later graphs pass through them.
+  if (!retain_graph && !t->prev.empty()) {
+    t->back = nullptr;
+    t->prev.clear();
+  }
+}
+
+template <Numeric DType>
+void Variable<DType>::backward(bool retain_graph) {
+  allocate_grad();
   for (int i = 0; i < this->grad.size(); i++) {
     this->grad[i] = 1;
   }
-  build_topo(this);
-  std::reverse(topo.begin(), topo.end());
-  for (Variable<DType> *t : topo) {
-    t->back();
+  propagate_graph(retain_graph);
+}
+
+template <Numeric DType>
+void Variable<DType>::backward(const Span<DType> &gradient,
+                               bool retain_graph) {
+  assert(static_cast<int>(gradient.size()) == numel());
+  allocate_grad();
+  std::copy(gradient.begin(), gradient.end(), this->grad.begin());
+  propagate_graph(retain_graph);
+}
+
+template <Numeric DType>
+void Variable<DType>::propagate_graph(bool retain_graph) {
+  auto topo = topological_order();
+  propagate(this, retain_graph);
+  for (auto &t : topo) {
+    propagate(t.get(), retain_graph);
+    // Frees the variable and its gradient unless the caller holds it.
+    if (!retain_graph)
+      t.reset();
   }
 }
 
 template <Numeric DType>
 std::vector<int> Variable<DType>::compute_strides(std::vector<int> shape) {
   std::vector<int> strides(shape.size());
+  if (shape.empty())
+    return strides;
   strides[shape.size() - 1] = 1;
   for (int i = shape.size() - 2; i >= 0; i--) {
     strides[i] = shape[i + 1] * strides[i + 1];
@@ -325,87 +857,157 @@ std::vector<int> Variable<DType>::compute_strides(std::vector<int> shape) {
 }
 
 template <Numeric DType>
-std::tuple<std::vector<int>, std::vector<int>, std::vector<int>>
-Variable<DType>::compute_broadcast_strides(Variable<DType> &first,
-                                           Variable<DType> &second) {
-  std::vector<int> out_shape = std::vector<int>();
-  std::vector<int> shape1 = first.shape;
-  std::vector<int> shape2 = second.shape;
-  while (shape1.size() < shape2.size()) {
-    shape1.insert(shape1.begin(), 1);
+template <typename Restride>
+std::shared_ptr<Variable<DType>>
+Variable<DType>::as_view(std::shared_ptr<Variable<DType>> variable,
+                         std::vector<int> shape, Restride restride,
+                         const char *op) {
+  // The same restride maps the storage layout for the data and the
+  // contiguous layout of the source gradient for the backward pass.
+  auto [strides, offset] = restride(variable->strides, variable->offset);
+  auto prev = std::vector<std::shared_ptr<Variable<DType>>>{variable};
+  auto out = std::make_shared<Variable<DType>>(variable->storage, offset, shape,
+                                               strides, prev, op);
+
+  if (!out->requires_grad)
+    return out;
+
+  auto grad_layout = restride(compute_strides(variable->shape), 0);
+  auto grad_strides = grad_layout.first;
+  auto grad_offset = grad_layout.second;
+  auto backward = [variable = variable.get(), out = out.get(), grad_strides,
+                   grad_offset]() {
+    int k = 0;
+    for_each_offset(out->shape, grad_strides, grad_offset, [&](int index) {
+      variable->grad[index] += out->grad[k++];
+    });
+  };
+  out->back = backward;
+  return out;
+}
+
+template <Numeric DType>
+template <typename Func>
+void Variable<DType>::for_each_offset(const std::vector<int> &shape,
+                                      const std::vector<int> &strides,
+                                      int offset, Func func) {
+  int size =
+      std::accumulate(shape.begin(), shape.end(), 1, std::multiplies<int>());
+  if (size == 0)
+    return;
+  if (shape.empty()) {
+    func(offset);
+    return;
   }
-  while (shape2.size() < shape1.size()) {
-    shape2.insert(shape2.begin(), 1);
+
+  int rank = shape.size();
+  int inner = shape[rank - 1];
+  int inner_stride = strides[rank - 1];
+  auto index = std::vector<int>(rank, 0);
+  for (int done = 0; done < size; done += inner) {
+    for (int i = 0; i < inner; i++) {
+      func(offset + i * inner_stride);
+    }
+    for (int d = rank - 2; d >= 0; d--) {
+      index[d]++;
+      offset += strides[d];
+      if (index[d] < shape[d])
+        break;
+      offset -= strides[d] * shape[d];
+      index[d] = 0;
+    }
   }
-  for (int i = 0; i < shape1.size(); i++) {
-    if (shape1[i] != shape2[i] && shape1[i] != 1 && shape2[i] != 1) {
-      for (int i = 0; i < first.shape.size(); i++)
-        std::cout << first.shape[i] << " ";
+}
+
+template <Numeric DType>
+std::vector<int>
+Variable<DType>::broadcast_shape(const std::vector<int> &shape1,
+                                 const std::vector<int> &shape2) {
+  int rank = std::max(shape1.size(), shape2.size());
+  std::vector<int> out_shape = std::vector<int>(rank);
+  for (int i = 0; i < rank; i++) {
+    int i1 = i - (rank - (int)shape1.size());
+    int i2 = i - (rank - (int)shape2.size());
+    int size1 = i1 >= 0 ? shape1[i1] : 1;
+    int size2 = i2 >= 0 ? shape2[i2] : 1;
+    if (size1 != size2 && size1 != 1 && size2 != 1) {
+      for (int i = 0; i < shape1.size(); i++)
+        std::cout << shape1[i] << " ";
       std::cout << std::endl;
-      for (int i = 0; i < second.shape.size(); i++)
-        std::cout << second.shape[i] << " ";
+      for (int i = 0; i < shape2.size(); i++)
+        std::cout << shape2[i] << " ";
       std::cout << std::endl;
       throw std::runtime_error("Shape missmatch");
     }
-    if (shape1[i] == 1) {
-      out_shape.push_back(shape2[i]);
-    } else {
-      out_shape.push_back(shape1[i]);
-    }
+    out_shape[i] = size1 == 1 ? size2 : size1;
   }
+  return out_shape;
+}
 
-  std::vector<int> s1 = compute_strides(shape1);
-  std::vector<int> s2 = compute_strides(shape2);
-  std::vector<int> stride1 = std::vector<int>(s1.size());
-  std::vector<int> stride2 = std::vector<int>(s2.size());
-  for (int i = 0; i < s1.size(); i++) {
-    if (shape1[i] == shape2[i]) {
-      stride1[i] = s1[i];
-      stride2[i] = s2[i];
-    } else if (shape1[i] == 1) {
-      stride1[i] = 0;
-      stride2[i] = s2[i];
-    } else if (shape2[i] == 1) {
-      stride1[i] = s1[i];
-      stride2[i] = 0;
-    } else {
-      throw std::runtime_error("Invalid shape");
-    }
+// Strides that read a variable of `shape`, laid out with `strides`, at every
+// position of `out_shape`; broadcast dimensions get stride 0.
+template <Numeric DType>
+std::vector<int>
+Variable<DType>::broadcast_strides(const std::vector<int> &shape,
+                                   const std::vector<int> &strides,
+                                   const std::vector<int> &out_shape) {
+  std::vector<int> result = std::vector<int>(out_shape.size(), 0);
+  int lead = out_shape.size() - shape.size();
+  for (int i = 0; i < shape.size(); i++) {
+    if (shape[i] != 1)
+      result[lead + i] = strides[i];
   }
-
-  return std::make_tuple(out_shape, stride1, stride2);
+  return result;
 }
 
 template <Numeric DType>
 std::shared_ptr<Variable<DType>>
 Variable<DType>::transform(std::shared_ptr<Variable<DType>> first,
                            std::shared_ptr<Variable<DType>> second,
-                           void (*front)(Variable<DType> *, Variable<DType> *,
-                                         Variable<DType> *, int, int, int),
-                           void (*back)(Variable<DType> *, Variable<DType> *,
-                                        Variable<DType> *, int, int, int),
-                           std::string name) {
-  auto tuple = compute_broadcast_strides(*first, *second);
-  auto out_shape = std::get<0>(tuple);
-  auto stride1 = std::get<1>(tuple);
-  auto stride2 = std::get<2>(tuple);
-
-  auto data_size = std::accumulate(out_shape.begin(), out_shape.end(), 1,
-                                   std::multiplies<int>());
+                           kernels::BinaryOp op, const char *name) {
+  auto out_shape = broadcast_shape(first->shape, second->shape);
   auto prev = std::vector<std::shared_ptr<Variable<DType>>>{first, second};
-  auto out = std::make_shared<Variable<DType>>(
-      std::vector<DType>(data_size), out_shape, prev,
-      first->name + name + second->name);
-
-  transform_rec(0, 0, 0, 0, out.get(), first.get(), second.get(), stride1,
-                stride2, front);
-
-  auto backward = [first, second, out, back]() {
-    auto tuple = compute_broadcast_strides(*first, *second);
-    auto stride1 = std::get<1>(tuple);
-    auto stride2 = std::get<2>(tuple);
-    transform_rec(0, 0, 0, 0, out.get(), first.get(), second.get(), stride1,
-                  stride2, back);
+  auto out = std::make_shared<Variable<DType>>(out_shape, prev, name);
+
+  kernels::Layout<3> layout = {
+      out_shape,
+      {out->strides,
+       broadcast_strides(first->shape, first->strides, out_shape),
+       broadcast_strides(second->shape, second->strides, out_shape)},
+      {0, first->offset, second->offset}};
+  kernels::coalesce(layout);
+  DType *result = out->storage->data();
+  const DType *a = first->storage->data();
+  const DType *b = second->storage->data();
+  kernels::for_each_run(layout, [&](const std::array<int, 3> &offsets,
+                                    const std::array<int, 3> &strides, int n) {
+    kernels::binary(op, a + offsets[1], strides[1], b + offsets[2],
+                    strides[2], result + offsets[0], n);
+  });
+
+  if (!out->requires_grad)
+    return out;
+
+  // An operand is saved only if the gradient of an operand that requires
+  // grad reads it, e.g. for x * w only x when w alone requires grad. The
+  // offsets in the layout include those of the operands, so the whole storage
+  // is saved.
+  auto needed = [&](int which) {
+    return (first->requires_grad &&
+            kernels::grad_reads_operand(op, 0, which)) ||
+           (second->requires_grad &&
+            kernels::grad_reads_operand(op, 1, which));
+  };
+  auto backward = [first = first.get(), second = second.get(),
+                   saved_a = Saved{needed(0) ? first->storage : nullptr},
+                   saved_b = Saved{needed(1) ? second->storage : nullptr},
+                   out = out.get(), op]() {
+    if (first->requires_grad)
+      transform_backward(op, 0, first, second, saved_a.data(),
+                         saved_b.data(), out);
+    if (second->requires_grad)
+      transform_backward(op, 1, first, second, saved_a.data(),
+                         saved_b.data(), out);
   };
   out->back = backward;
 
@@ -413,64 +1015,77 @@ Variable<DType>::transform(std::shared_ptr<Variable<DType>> first,
 }
 
 template <Numeric DType>
-void Variable<DType>::transform_rec(
-    int dim, int offset1, int offset2, int index, Variable<DType> *out,
-    Variable<DType> *first, Variable<DType> *second, std::vector<int> &stride1,
-    std::vector<int> &stride2,
-    void (*func)(Variable<DType> *, Variable<DType> *, Variable<DType> *, int,
-                 int, int)) {
-  if (dim >= out->shape.size()) {
-    func(first, second, out, offset1, offset2, index);
+void Variable<DType>::transform_backward(kernels::BinaryOp op, int operand,
+                                         Variable<DType> *first,
+                                         Variable<DType> *second,
+                                         const DType *a, const DType *b,
+                                         Variable<DType> *out) {
+  Variable<DType> *target = operand == 0 ? first : second;
+  auto target_strides = broadcast_strides(
+      target->shape, compute_strides(target->shape), out->shape);
+  bool broadcast = false;
+  for (int i = 0; i < out->shape.size(); i++)
+    broadcast |= target_strides[i] == 0 && out->shape[i] != 1;
+
+  kernels::Layout<4> layout = {
+      out->shape,
+      {target_strides, out->strides,
+       broadcast_strides(first->shape, first->strides, out->shape),
+       broadcast_strides(second->shape, second->strides, out->shape)},
+      {0, 0, first->offset, second->offset}};
+  kernels::coalesce(layout);
+  DType *target_grad = target->grad.data();
+  const DType *out_grad = out->grad.data();
+  // a and b are null when op does not read them.
+  auto at = [](const DType *p, long offset) {
+    return p != nullptr ? p + offset : nullptr;
+  };
+  auto accumulate = [&](const std::array<int, 4> &offsets,
+                        const std::array<int, 4> &strides, int n) {
+    kernels::binary_backward(op, operand, out_grad + offsets[1],
+                             at(a, offsets[2]), strides[2], at(b, offsets[3]),
+                             strides[3], target_grad + offsets[0], strides[0],
+                             n);
+  };
+  if (!broadcast) {
+    kernels::for_each_run(layout, accumulate);
     return;
   }
-  int s1 = 0, s2 = 0;
-  for (int i = 0; i < out->shape[dim]; i++) {
-    transform_rec(dim + 1, offset1 + s1, offset2 + s2, index, out, first,
-                  second, stride1, stride2, func);
-    index += out->strides[dim];
-    s1 += stride1[dim];
-    s2 += stride2[dim];
+
+  // Broadcast along outer dimensions only, like a bias row: every run adds
+  // into the same row, so threads take disjoint column slices of it.
+  int inner = layout.shape.size() - 1;
+  if (layout.strides[0][inner] != 0) {
+    kernels::for_each_run(layout, accumulate, kernels::Split::Inner);
+    return;
   }
-};
 
-template <Numeric DType>
-template <bool transpose1, bool transpose2, bool transpose3>
-inline void Variable<DType>::fast_mat_mul(const DType *left, const DType *right,
-                                          DType *result, int rows, int columns,
-                                          int inners, int tileSize) {
-#pragma omp parallel for shared(result, left, right) default(none) collapse(2) \
-    num_threads(8)
-  for (int rowTile = 0; rowTile < rows; rowTile += 256) {
-    for (int columnTile = 0; columnTile < columns; columnTile += 256) {
-      for (int innerTile = 0; innerTile < inners; innerTile += tileSize) {
-        int rowTileEnd = std::min(rows, rowTile + 256);
-        int colTileEnd = std::min(columns, columnTile + 256);
-        int innerTileEnd = std::min(inners, innerTile + tileSize);
-        for (int row = rowTile; row < rowTileEnd; row++) {
-          for (int inner = innerTile; inner < innerTileEnd; inner++) {
-            for (int col = columnTile; col < colTileEnd; col++) {
-              DType l;
-              if (transpose1)
-                l = left[inner * rows + row];
-              else
-                l = left[row * inners + inner];
-
-              DType r;
-              if (transpose2)
-                r = right[col * inners + inner];
-              else
-                r = right[inner * columns + col];
-
-              if (transpose3)
-                result[row * columns + col] += l * r;
-              else
-                result[row * columns + col] += l * r;
-            }
-          }
-        }
-      }
-    }
+  // Broadcast along the innermost dimension: every run sums into one element.
+  auto sum = [&](const std::array<int, 4> &offsets,
+                 const std::array<int, 4> &strides, long begin, long end) {
+    return kernels::binary_backward_sum(
+        op, operand, out_grad + offsets[1] + begin,
+        at(a, offsets[2] + begin * strides[2]), strides[2],
+        at(b, offsets[3] + begin * strides[3]), strides[3], end - begin);
+  };
+  if (inner == 0) {
+    std::array<int, 4> strides;
+    for (int o = 0; o < 4; o++)
+      strides[o] = layout.strides[o][0];
+    target_grad[0] += kernels::parallel_sum<DType>(
+        layout.shape[0], [&](long begin, long end) {
+          return sum(layout.offsets, strides, begin, end);
+        });
+    return;
   }
+  bool disjoint = true;
+  for (int d = 0; d < inner; d++)
+    disjoint &= layout.strides[0][d] != 0;
+  kernels::for_each_run(
+      layout,
+      [&](const std::array<int, 4> &offsets, const std::array<int, 4> &strides,
+          int n) { target_grad[offsets[0]] += sum(offsets, strides, 0, n); },
+      disjoint ? kernels::Split::Runs : kernels::Split::None);
 }
 
 } // namespace variable
@@ -1,45 +1,81 @@
 #ifndef VARIABLE_FUNC_H
 #define VARIABLE_FUNC_H
 
+#include "../kernels/gemm.h"
+#include "../kernels/loss.h"
+#include "../kernels/reduce.h"
+#include "../kernels/softmax.h"
+#include "../kernels/unary.h"
 #include "variable.h"
+#include <algorithm>
+#include <cmath>
 #include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
 
 namespace variable {
 
-template <Numeric DType = float>
+// Elementwise op whose backward needs either the input or the output, and
+// saves only that one.
+template <Numeric DType>
 std::shared_ptr<Variable<DType>>
-tanh(std::shared_ptr<Variable<DType>> variable) {
-  std::vector<DType> data;
-  for (int i = 0; i < variable->data.size(); i++) {
-    data.push_back(std::tanh(variable->data[i]));
-  }
-
+unary(std::shared_ptr<Variable<DType>> variable, kernels::UnaryOp op,
+      const char *name) {
+  variable = Variable<DType>::contiguous(variable);
   auto prev = std::vector<std::shared_ptr<Variable<DType>>>{variable};
-  auto out = std::make_shared<Variable<DType>>(data, variable->shape, prev,
-                                               "tanh(" + variable->name + ")");
-  auto backward = [variable, out]() {
-    for (int i = 0; i < out->grad.size(); i++) {
-      variable->grad[i] += out->grad[i] * (1 - out->data[i] * out->data[i]);
-    }
+  auto out = std::make_shared<Variable<DType>>(variable->shape, prev, name);
+  kernels::unary(op, variable->data.data(), out->data.data(), out->numel());
+
+  if (!out->requires_grad)
+    return out;
+
+  bool uses_output = kernels::grad_uses_output(op);
+  auto backward = [variable = variable.get(), out = out.get(),
+                   input = variable->save(!uses_output),
+                   result = out->save(uses_output), op]() {
+    kernels::unary_backward(op, out->grad.data(), input.data(), result.data(),
+                            variable->grad.data(), out->numel());
   };
   out->back = backward;
   return out;
 }
 
+template <Numeric DType = float>
+std::shared_ptr<Variable<DType>>
+tanh(std::shared_ptr<Variable<DType>> variable) {
+  return unary(variable, kernels::UnaryOp::Tanh, "tanh");
+}
+
+template <Numeric DType = float>
+std::shared_ptr<Variable<DType>>
+sigmoid(std::shared_ptr<Variable<DType>> variable) {
+  return unary(variable, kernels::UnaryOp::Sigmoid, "sigmoid");
+}
+
+template <Numeric DType = float>
+std::shared_ptr<Variable<DType>>
+gelu(std::shared_ptr<Variable<DType>> variable) {
+  return unary(variable, kernels::UnaryOp::Gelu, "GELU");
+}
+
 template <Numeric DType = float>
 std::shared_ptr<Variable<DType>>
 relu(std::shared_ptr<Variable<DType>> variable) {
-  auto data = std::vector<DType>(variable->data.size());
+  variable = Variable<DType>::contiguous(variable);
+  auto prev = std::vector<std::shared_ptr<Variable<DType>>>{variable};
+  auto out = std::make_shared<Variable<DType>>(variable->shape, prev, "ReLU");
   for (int i = 0; i < variable->data.size(); i++) {
-    data[i] = std::max(0.0f, variable->data[i]);
+    out->data[i] = std::max(static_cast<DType>(0), variable->data[i]);
   }
+  if (!out->requires_grad)
+    return out;
 
-  auto prev = std::vector<std::shared_ptr<Variable<DType>>>{variable};
-  auto out = std::make_shared<Variable<DType>>(data, variable->shape, prev,
-                                               "ReLU(" + variable->name + ")");
-  auto backward = [variable, out]() {
+  auto backward = [variable = variable.get(), out = out.get(),
+                   result = out->save()]() {
+    const DType *data = result.data();
     for (int i = 0; i < out->grad.size(); i++) {
-      if (out->data[i] > 0) {
+      if (data[i] > 0) {
         variable->grad[i] += out->grad[i];
       }
     }
@@ -51,92 +87,319 @@ relu(std::shared_ptr<Variable<DType>> variable) {
 template <Numeric DType = float>
 std::shared_ptr<Variable<DType>>
 exp(std::shared_ptr<Variable<DType>> variable) {
-  std::vector<DType> data;
-  for (int i = 0; i < variable->data.size(); i++) {
-    data.push_back(std::exp(variable->data[i]));
+  return unary(variable, kernels::UnaryOp::Exp, "exp");
+}
+
+template <Numeric DType = float>
+std::shared_ptr<Variable<DType>>
+log(std::shared_ptr<Variable<DType>> variable) {
+  return unary(variable, kernels::UnaryOp::Log, "log");
+}
+
+// Marks the dimensions reduced over dims, counting negative dims from the
+// end; every dimension if dims is empty.
+inline std::vector<bool> reduced_dims(const std::vector<int> &shape,
+                                      const std::vector<int> &dims) {
+  std::vector<bool> reduce(shape.size(), dims.empty());
+  for (int dim : dims) {
+    if (dim < 0)
+      dim += shape.size();
+    if (dim < 0 || dim >= static_cast<int>(shape.size()))
+      throw std::runtime_error("Reduction dim out of range");
+    reduce[dim] = true;
+  }
+  return reduce;
+}
+
+inline std::vector<int> reduced_shape(const std::vector<int> &shape,
+                                      const std::vector<bool> &reduce,
+                                      bool keepdim) {
+  std::vector<int> out_shape;
+  for (int d = 0; d < shape.size(); d++) {
+    if (!reduce[d])
+      out_shape.push_back(shape[d]);
+    else if (keepdim)
+      out_shape.push_back(1);
   }
+  if (out_shape.empty())
+    out_shape = {1};
+  return out_shape;
+}
 
+// Sum over dims, divided by the number of reduced elements for mean.
+template <Numeric DType>
+std::shared_ptr<Variable<DType>>
+sum_or_mean(std::shared_ptr<Variable<DType>> variable,
+            const std::vector<int> &dims, bool keepdim, bool average) {
+  variable = Variable<DType>::contiguous(variable);
+  auto reduce = reduced_dims(variable->shape, dims);
+  auto reduction = kernels::make_reduction(variable->shape, reduce);
   auto prev = std::vector<std::shared_ptr<Variable<DType>>>{variable};
-  auto out = std::make_shared<Variable<DType>>(data, variable->shape, prev,
-                                               "exp(" + variable->name + ")");
+  auto out = std::make_shared<Variable<DType>>(
+      reduced_shape(variable->shape, reduce, keepdim), prev,
+      average ? "mean" : "sum");
+  if (reduction.size > 0)
+    kernels::reduce(kernels::ReduceOp::Sum, reduction, variable->data.data(),
+                    static_cast<const DType *>(nullptr), out->data.data());
+  else
+    std::fill(out->data.begin(), out->data.end(), DType(0));
+  DType scale = average ? DType(1) / reduction.size : DType(1);
+  if (average)
+    for (DType &value : out->data)
+      value *= scale;
 
-  auto backward = [variable, out]() {
-    for (int i = 0; i < out->grad.size(); i++) {
-      variable->grad[i] += out->grad[i] * out->data[i];
-    }
+  if (!out->requires_grad)
+    return out;
+
+  auto backward = [variable = variable.get(), out = out.get(), reduction,
+                   scale]() {
+    std::vector<DType> coef(out->grad);
+    for (DType &value : coef)
+      value *= scale;
+    kernels::reduce_backward(reduction, coef.data(),
+                             static_cast<const DType *>(nullptr),
+                             static_cast<const DType *>(nullptr),
+                             variable->grad.data());
   };
   out->back = backward;
   return out;
 }
 
+template <Numeric DType = float>
+std::shared_ptr<Variable<DType>> sum(std::shared_ptr<Variable<DType>> variable,
+                                     const std::vector<int> &dims,
+                                     bool keepdim = false) {
+  return sum_or_mean(variable, dims, keepdim, false);
+}
+
+template <Numeric DType = float>
+std::shared_ptr<Variable<DType>> sum(std::shared_ptr<Variable<DType>> variable,
+                                     std::optional<int> dim, bool keepdim) {
+  if (!dim.has_value())
+    return sum(variable, std::vector<int>{}, false);
+  return sum(variable, std::vector<int>{dim.value()}, keepdim);
+}
+
 template <Numeric DType = float>
 std::shared_ptr<Variable<DType>>
-log(std::shared_ptr<Variable<DType>> variable) {
-  std::vector<DType> data;
-  for (int i = 0; i < variable->data.size(); i++) {
-    data.push_back(std::log(variable->data[i]));
-  }
+mean(std::shared_ptr<Variable<DType>> variable,
+     const std::vector<int> &dims = {}, bool keepdim = false) {
+  return sum_or_mean(variable, dims, keepdim, true);
+}
 
+// Max or min over dims; the gradient flows to the first extreme element.
+template <Numeric DType>
+std::shared_ptr<Variable<DType>>
+extremum(std::shared_ptr<Variable<DType>> variable,
+         const std::vector<int> &dims, bool keepdim, bool max) {
+  variable = Variable<DType>::contiguous(variable);
+  auto reduce = reduced_dims(variable->shape, dims);
+  auto reduction = kernels::make_reduction(variable->shape, reduce);
+  if (reduction.size == 0)
+    throw std::runtime_error("Max or min over an empty dimension");
   auto prev = std::vector<std::shared_ptr<Variable<DType>>>{variable};
-  auto out = std::make_shared<Variable<DType>>(data, variable->shape, prev,
-                                               "log(" + variable->name + ")");
+  auto out = std::make_shared<Variable<DType>>(
+      reduced_shape(variable->shape, reduce, keepdim), prev,
+      max ? "max" : "min");
+  auto indices = std::vector<int>(reduction.outputs);
+  kernels::arg_reduce(max, reduction, variable->data.data(), out->data.data(),
+                      indices.data());
 
-  auto backward = [variable, out]() {
-    for (int i = 0; i < out->grad.size(); i++) {
-      variable->grad[i] += out->grad[i] * 1.0 / (variable->data[i]);
-    }
+  if (!out->requires_grad)
+    return out;
+
+  auto backward = [variable = variable.get(), out = out.get(), reduction,
+                   indices]() {
+    kernels::arg_reduce_backward(reduction, out->grad.data(), indices.data(),
+                                 variable->grad.data());
   };
   out->back = backward;
   return out;
 }
 
 template <Numeric DType = float>
-std::shared_ptr<Variable<DType>> sum(std::shared_ptr<Variable<DType>> variable,
-                                     std::optional<int> dim, bool keepdim) {
-  assert(dim < variable->shape.size());
-  auto shape = std::vector<int>(3, 1);
-  if (!dim.has_value()) {
-    shape = {1, static_cast<int>(variable->data.size()), 1};
+std::shared_ptr<Variable<DType>> max(std::shared_ptr<Variable<DType>> variable,
+                                     const std::vector<int> &dims = {},
+                                     bool keepdim = false) {
+  return extremum(variable, dims, keepdim, true);
+}
+
+template <Numeric DType = float>
+std::shared_ptr<Variable<DType>> min(std::shared_ptr<Variable<DType>> variable,
+                                     const std::vector<int> &dims = {},
+                                     bool keepdim = false) {
+  return extremum(variable, dims, keepdim, false);
+}
+
+// Index of the first max or min along dim, or into the flattened tensor
+// without dim. The result does not require grad.
+template <Numeric DType>
+std::shared_ptr<Variable<DType>>
+arg_extremum(std::shared_ptr<Variable<DType>> variable, std::optional<int> dim,
+             bool keepdim, bool max) {
+  variable = Variable<DType>::contiguous(variable);
+  auto dims = dim.has_value() ? std::vector<int>{dim.value()}
+                              : std::vector<int>{};
+  auto reduce = reduced_dims(variable->shape, dims);
+  auto reduction = kernels::make_reduction(variable->shape, reduce);
+  if (reduction.size == 0)
+    throw std::runtime_error("Argmax or argmin over an empty dimension");
+  auto out = std::make_shared<Variable<DType>>(
+      reduced_shape(variable->shape, reduce, dim.has_value() && keepdim),
+      std::vector<std::shared_ptr<Variable<DType>>>{},
+      max ? "argmax" : "argmin");
+  out->requires_grad = false;
+  auto values = std::vector<DType>(reduction.outputs);
+  auto indices = std::vector<int>(reduction.outputs);
+  kernels::arg_reduce(max, reduction, variable->data.data(), values.data(),
+                      indices.data());
+  for (int i = 0; i < indices.size(); i++)
+    out->data[i] = indices[i];
+  return out;
+}
+
+template <Numeric DType = float>
+std::shared_ptr<Variable<DType>>
+argmax(std::shared_ptr<Variable<DType>> variable,
+       std::optional<int> dim = std::nullopt, bool keepdim = false) {
+  return arg_extremum(variable, dim, keepdim, true);
+}
+
+template <Numeric DType = float>
+std::shared_ptr<Variable<DType>>
+argmin(std::shared_ptr<Variable<DType>> variable,
+       std::optional<int> dim = std::nullopt, bool keepdim = false) {
+  return arg_extremum(variable, dim, keepdim, false);
+}
+
+// Variance over dims, dividing the squared deviations by the number of
+// reduced elements minus correction (1 gives the unbiased estimate).
+template <Numeric DType = float>
+std::shared_ptr<Variable<DType>> var(std::shared_ptr<Variable<DType>> variable,
+                                     const std::vector<int> &dims = {},
+                                     bool keepdim = false,
+                                     int correction = 1) {
+  variable = Variable<DType>::contiguous(variable);
+  auto reduce = reduced_dims(variable->shape, dims);
+  auto reduction = kernels::make_reduction(variable->shape, reduce);
+  auto prev = std::vector<std::shared_ptr<Variable<DType>>>{variable};
+  auto out = std::make_shared<Variable<DType>>(
+      reduced_shape(variable->shape, reduce, keepdim), prev, "var");
+  auto means = std::vector<DType>(reduction.outputs);
+  const DType *data = variable->data.data();
+  if (reduction.size > 0) {
+    kernels::reduce(kernels::ReduceOp::Sum, reduction, data,
+                    static_cast<const DType *>(nullptr), means.data());
+    for (DType &value : means)
+      value /= reduction.size;
+    kernels::reduce(kernels::ReduceOp::SumSquares, reduction, data,
+                    static_cast<const DType *>(means.data()),
+                    out->data.data());
   } else {
-    for (int i = 0; i < variable->shape.size(); i++) {
-      if (i < dim.value())
-        shape[0] *= variable->shape[i];
-      else if (i == dim.value())
-        shape[1] = variable->shape[i];
-      else
-        shape[2] *= variable->shape[i];
-    }
+    std::fill(out->data.begin(), out->data.end(), DType(0));
   }
+  DType divisor = static_cast<DType>(reduction.size - correction);
+  for (DType &value : out->data)
+    value /= divisor;
 
-  auto data = std::vector<DType>(shape[0] * shape[2], 0);
-  for (int i = 0; i < shape[0]; i++) {
-    for (int j = 0; j < shape[1]; j++) {
-      for (int k = 0; k < shape[2]; k++) {
-        int index = i * shape[1] * shape[2] + j * shape[2] + k;
-        data[i * shape[2] + k] += variable->data[index];
-      }
-    }
-  }
+  if (!out->requires_grad)
+    return out;
 
-  std::vector<int> out_shape;
-  if (dim.has_value()) {
-    out_shape = variable->shape;
-    if (!keepdim)
-      out_shape.erase(out_shape.begin() + dim.value());
-    else
-      out_shape[dim.value()] = 1;
-  } else {
-    out_shape = {1};
+  // The means depend on the input too, but their deviations sum to zero.
+  auto backward = [variable = variable.get(), out = out.get(),
+                   input = variable->save(), reduction, means, divisor]() {
+    std::vector<DType> coef(out->grad);
+    for (DType &value : coef)
+      value *= 2 / divisor;
+    kernels::reduce_backward(reduction, coef.data(), input.data(),
+                             means.data(), variable->grad.data());
+  };
+  out->back = backward;
+  return out;
+}
+
+// Euclidean norm over dims.
+template <Numeric DType = float>
+std::shared_ptr<Variable<DType>> norm(std::shared_ptr<Variable<DType>> variable,
+                                      const std::vector<int> &dims = {},
+                                      bool keepdim = false) {
+  variable = Variable<DType>::contiguous(variable);
+  auto reduce = reduced_dims(variable->shape, dims);
+  auto reduction = kernels::make_reduction(variable->shape, reduce);
+  auto prev = std::vector<std::shared_ptr<Variable<DType>>>{variable};
+  auto out = std::make_shared<Variable<DType>>(
+      reduced_shape(variable->shape, reduce, keepdim), prev, "norm");
+  if (reduction.size > 0)
+    kernels::reduce(kernels::ReduceOp::SumSquares, reduction,
+                    variable->data.data(), static_cast<const DType *>(nullptr),
+                    out->data.data());
+  else
+    std::fill(out->data.begin(), out->data.end(), DType(0));
+  for (DType &value : out->data)
+    value = std::sqrt(value);
+
+  if (!out->requires_grad)
+    return out;
+
+  // d|x| / dx = x / |x|, taken as 0 at the origin.
+  auto backward = [variable = variable.get(), out = out.get(),
+                   input = variable->save(), result = out->save(),
+                   reduction]() {
+    std::vector<DType> coef(out->grad);
+    const DType *norms = result.data();
+    for (int i = 0; i < coef.size(); i++)
+      coef[i] = norms[i] == 0 ? 0 : coef[i] / norms[i];
+    kernels::reduce_backward(reduction, coef.data(), input.data(),
+                             static_cast<const DType *>(nullptr),
+                             variable->grad.data());
+  };
+  out->back = backward;
+  return out;
+}
+
+// The shape of a [N, C, ...] tensor without its class dim.
+inline std::vector<int> sample_shape(const std::vector<int> &shape) {
+  auto reduce = std::vector<bool>(shape.size(), false);
+  reduce[1] = true;
+  return reduced_shape(shape, reduce, false);
+}
+
+// The layout of a softmax along dim, or over every element without dim.
+inline kernels::SoftmaxDims softmax_dims(const std::vector<int> &shape,
+                                         std::optional<int> dim) {
+  if (!dim.has_value()) {
+    long numel = 1;
+    for (int size : shape)
+      numel *= size;
+    return kernels::make_softmax_dims({static_cast<int>(numel)}, 0);
   }
+  int d = dim.value() < 0 ? dim.value() + shape.size() : dim.value();
+  if (d < 0 || d >= static_cast<int>(shape.size()))
+    throw std::runtime_error("Softmax dim out of range");
+  return kernels::make_softmax_dims(shape, d);
+}
 
+// Softmax, or log_softmax with log, shifted by the max so that large inputs
+// do not overflow. The backward only needs the output.
+template <Numeric DType>
+std::shared_ptr<Variable<DType>>
+softmax_or_log(std::shared_ptr<Variable<DType>> variable,
+               std::optional<int> dim, bool log) {
+  variable = Variable<DType>::contiguous(variable);
+  auto dims = softmax_dims(variable->shape, dim);
   auto prev = std::vector<std::shared_ptr<Variable<DType>>>{variable};
-  auto out = std::make_shared<Variable<DType>>(data, out_shape, prev,
-                                               "sum(" + variable->name + ")");
+  auto out = std::make_shared<Variable<DType>>(
+      variable->shape, prev, log ? "log_softmax" : "softmax");
+  if (out->numel() > 0)
+    kernels::softmax(dims, variable->data.data(), out->data.data(), log);
 
-  auto backward = [variable, out]() {
-    for (int i = 0; i < out->prev[0]->data.size(); i++) {
-      variable->grad[i] += out->grad[0];
-    }
+  if (!out->requires_grad)
+    return out;
+
+  auto backward = [variable = variable.get(), out = out.get(),
+                   result = out->save(), dims, log]() {
+    kernels::softmax_backward(dims, out->grad.data(), result.data(),
+                              variable->grad.data(), log);
   };
   out->back = backward;
   return out;
@@ -144,25 +407,298 @@ std::shared_ptr<Variable<DType>> sum(std::shared_ptr<Variable<DType>> variable,
 
 template <Numeric DType = float>
 std::shared_ptr<Variable<DType>>
-mean(std::shared_ptr<Variable<DType>> variable) {
-  auto number = static_cast<DType>(variable->data.size());
-  auto data = std::vector<DType>(
-      1, std::accumulate(variable->data.begin(), variable->data.end(), 0.0) /
-             number);
+softmax(std::shared_ptr<Variable<DType>> variable,
+        std::optional<int> dim = std::nullopt) {
+  return softmax_or_log(variable, dim, false);
+}
 
-  auto prev = std::vector<std::shared_ptr<Variable<DType>>>{variable};
-  auto out = std::make_shared<Variable<DType>>(data, std::vector<int>{1}, prev,
-                                               "mean(" + variable->name + ")");
+template <Numeric DType = float>
+std::shared_ptr<Variable<DType>>
+log_softmax(std::shared_ptr<Variable<DType>> variable,
+            std::optional<int> dim = std::nullopt) {
+  return softmax_or_log(variable, dim, true);
+}
 
-  auto backward = [variable, out]() {
-    for (int i = 0; i < variable->grad.size(); i++) {
-      variable->grad[i] += out->grad[0] / variable->data.size();
+// -sum(target * log_softmax(logits)) over the classes in dim 1, with target
+// holding class probabilities of the same shape as logits, mixed with the
+// uniform distribution by smoothing. Returns one loss per sample, shaped like
+// logits without dim 1. Fused so that log_softmax is never materialized and
+// the backward is a single pass.
+template <Numeric DType = float>
+std::shared_ptr<Variable<DType>>
+softmax_cross_entropy(std::shared_ptr<Variable<DType>> logits,
+                      std::shared_ptr<Variable<DType>> target,
+                      DType smoothing = 0) {
+  logits = Variable<DType>::contiguous(logits);
+  target = Variable<DType>::contiguous(target);
+  if (logits->shape.size() < 2)
+    throw std::runtime_error("Cross-entropy needs a batch and a class dim");
+  if (logits->shape != target->shape)
+    throw std::runtime_error("Cross-entropy target shape mismatch");
+  auto dims = kernels::make_softmax_dims(logits->shape, 1);
+  auto prev = std::vector<std::shared_ptr<Variable<DType>>>{logits, target};
+  auto out = std::make_shared<Variable<DType>>(sample_shape(logits->shape),
+                                               prev, "cross_entropy");
+  auto log_sum = std::vector<DType>(out->numel());
+  if (logits->numel() > 0)
+    kernels::cross_entropy(dims, logits->data.data(), target->data.data(),
+                           smoothing, out->data.data(), log_sum.data());
+
+  if (!out->requires_grad)
+    return out;
+
+  auto backward = [logits = logits.get(), target = target.get(),
+                   out = out.get(), saved_logits = logits->save(),
+                   saved_target = target->save(), dims, smoothing,
+                   log_sum]() {
+    kernels::cross_entropy_backward(
+        dims, out->grad.data(), saved_logits.data(), saved_target.data(),
+        smoothing, log_sum.data(),
+        logits->requires_grad ? logits->grad.data() : nullptr,
+        target->requires_grad ? target->grad.data() : nullptr);
+  };
+  out->back = backward;
+  return out;
+}
+
+// The class indices held in target, one per sample of input, with
+// ignore_index mapped to -1.
+template <Numeric DType>
+std::vector<int> class_indices(const std::shared_ptr<Variable<DType>> &input,
+                               const std::shared_ptr<Variable<DType>> &target,
+                               int ignore_index) {
+  if (input->shape.size() < 2)
+    throw std::runtime_error("Class targets need a batch and a class dim");
+  if (target->shape != sample_shape(input->shape))
+    throw std::runtime_error("Class target shape mismatch");
+  auto classes = std::vector<int>(target->numel());
+  int i = 0;
+  for (DType value : target->data) {
+    // Checked as a float first, as converting a NaN or an out of range value
+    // to int is undefined.
+    if (!std::isfinite(static_cast<double>(value)) ||
+        value != std::trunc(value))
+      throw std::runtime_error("Class index out of range");
+    if (value == ignore_index) {
+      classes[i++] = -1;
+      continue;
     }
+    if (value < 0 || value >= input->shape[1])
+      throw std::runtime_error("Class index out of range");
+    classes[i++] = static_cast<int>(value);
+  }
+  return classes;
+}
+
+// softmax_cross_entropy against class indices: target is shaped like logits
+// without dim 1 and holds the class of each sample. With smoothing the target
+// is 1 - smoothing on the class plus smoothing spread over all classes.
+// Samples of class ignore_index get a loss of 0 and no gradient. target gets
+// no gradient.
+template <Numeric DType = float>
+std::shared_ptr<Variable<DType>>
+class_cross_entropy(std::shared_ptr<Variable<DType>> logits,
+                    std::shared_ptr<Variable<DType>> target,
+                    DType smoothing = 0, int ignore_index = -100) {
+  logits = Variable<DType>::contiguous(logits);
+  target = Variable<DType>::contiguous(target);
+  auto classes = class_indices(logits, target, ignore_index);
+  auto dims = kernels::make_softmax_dims(logits->shape, 1);
+  auto prev = std::vector<std::shared_ptr<Variable<DType>>>{logits};
+  auto out = std::make_shared<Variable<DType>>(target->shape, prev,
+                                               "cross_entropy");
+  auto log_sum = std::vector<DType>(out->numel());
+  if (logits->numel() > 0)
+    kernels::cross_entropy_classes(dims, logits->data.data(), classes.data(),
+                                   smoothing, out->data.data(),
+                                   log_sum.data());
+
+  if (!out->requires_grad)
+    return out;
+
+  auto backward = [logits = logits.get(), out = out.get(),
+                   saved_logits = logits->save(), dims, classes, smoothing,
+                   log_sum]() {
+    kernels::cross_entropy_classes_backward(
+        dims, out->grad.data(), saved_logits.data(), classes.data(),
+        smoothing, log_sum.data(), logits->grad.data());
   };
   out->back = backward;
   return out;
 }
 
+// -input[n, target[n], ...] for log-probabilities input, with the class dim
+// in dim 1 and target as in class_cross_entropy.
+template <Numeric DType = float>
+std::shared_ptr<Variable<DType>> nll(std::shared_ptr<Variable<DType>> input,
+                                     std::shared_ptr<Variable<DType>> target,
+                                     int ignore_index = -100) {
+  input = Variable<DType>::contiguous(input);
+  target = Variable<DType>::contiguous(target);
+  auto classes = class_indices(input, target, ignore_index);
+  auto dims = kernels::make_softmax_dims(input->shape, 1);
+  auto prev = std::vector<std::shared_ptr<Variable<DType>>>{input};
+  auto out = std::make_shared<Variable<DType>>(target->shape, prev, "nll");
+  auto positions = std::vector<long>(classes.size(), -1);
+  for (long r = 0; r < classes.size(); r++) {
+    if (classes[r] < 0)
+      continue;
+    long o = r / dims.inner;
+    long i = r % dims.inner;
+    positions[r] = (o * dims.size + classes[r]) * dims.inner + i;
+    out->data[r] = -input->data[positions[r]];
+  }
+
+  if (!out->requires_grad)
+    return out;
+
+  auto backward = [input = input.get(), out = out.get(), positions]() {
+    for (long r = 0; r < positions.size(); r++)
+      if (positions[r] >= 0)
+        input->grad[positions[r]] -= out->grad[r];
+  };
+  out->back = backward;
+  return out;
+}
+// activation(input & weight + bias) for input [..., in] and weight [in, out],
+// with the bias (of shape [out], or null for none) and the activation
+// applied to each tile of the product before it leaves registers. The
+// backward scales the gradient by the activation's derivative and sums it
+// for the bias in one pass before the two products.
+template <Numeric DType = float>
+std::shared_ptr<Variable<DType>>
+linear(std::shared_ptr<Variable<DType>> input,
+       std::shared_ptr<Variable<DType>> weight,
+       std::shared_ptr<Variable<DType>> bias,
+       kernels::Activation activation = kernels::Activation::None) {
+  input = Variable<DType>::contiguous(input);
+  weight = Variable<DType>::contiguous(weight);
+  if (bias != nullptr)
+    bias = Variable<DType>::contiguous(bias);
+  if (input->shape.empty() || weight->shape.size() != 2 ||
+      input->shape.back() != weight->shape[0])
+    throw std::runtime_error("Linear weight shape mismatch");
+  int inners = weight->shape[0];
+  int columns = weight->shape[1];
+  if (bias != nullptr && bias->shape != std::vector<int>{columns})
+    throw std::runtime_error("Linear bias shape mismatch");
+  int rows = 1;
+  for (int d = 0; d + 1 < input->shape.size(); d++)
+    rows *= input->shape[d];
+  auto shape = input->shape;
+  shape.back() = columns;
+  auto prev = std::vector<std::shared_ptr<Variable<DType>>>{input, weight};
+  if (bias != nullptr)
+    prev.push_back(bias);
+  auto out = std::make_shared<Variable<DType>>(shape, prev, "linear");
+  auto pre = std::vector<DType>(
+      activation == kernels::Activation::Gelu ? out->numel() : 0);
+  kernels::gemm_bias_activation(rows, columns, inners, input->data.data(),
+                                inners, 1, weight->data.data(), columns, 1,
+                                bias != nullptr ? bias->data.data() : nullptr,
+                                activation, out->data.data(), columns,
+                                pre.data());
+
+  if (!out->requires_grad)
+    return out;
+
+  // Each operand is only needed for the gradient of the other one, and the
+  // output only for the derivative of ReLU and Tanh.
+  bool uses_out = activation == kernels::Activation::ReLU ||
+                  activation == kernels::Activation::Tanh;
+  auto backward = [input = input.get(), weight = weight.get(),
+                   bias = bias.get(), out = out.get(),
+                   saved_input = input->save(weight->requires_grad),
+                   saved_weight = weight->save(input->requires_grad),
+                   result = out->save(uses_out), pre = std::move(pre), rows,
+                   inners, columns, activation]() {
+    const DType *grad = out->grad.data();
+    DType *bias_grad =
+        bias != nullptr && bias->requires_grad ? bias->grad.data() : nullptr;
+    auto scaled = std::vector<DType>();
+    if (activation != kernels::Activation::None)
+      scaled.resize(out->numel());
+    if (activation != kernels::Activation::None || bias_grad != nullptr)
+      kernels::activation_backward(rows, columns, activation, grad,
+                                   result.data(), pre.data(),
+                                   scaled.empty() ? nullptr : scaled.data(),
+                                   bias_grad);
+    if (!scaled.empty())
+      grad = scaled.data();
+    if (input->requires_grad)
+      kernels::gemm(rows, inners, columns, grad, columns, 1,
+                    saved_weight.data(), 1, columns, input->grad.data(),
+                    inners, true);
+    if (weight->requires_grad)
+      kernels::gemm(inners, columns, rows, saved_input.data(), 1, inners,
+                    grad, columns, 1, weight->grad.data(), columns, true);
+  };
+  out->back = backward;
+  return out;
+}
+
+inline const char *loss_name(kernels::LossOp op) {
+  switch (op) {
+  case kernels::LossOp::BCE:
+    return "binary_cross_entropy";
+  case kernels::LossOp::BCEWithLogits:
+    return "binary_cross_entropy_with_logits";
+  case kernels::LossOp::MSE:
+    return "mse_loss";
+  case kernels::LossOp::L1:
+    return "l1_loss";
+  case kernels::LossOp::Huber:
+    return "huber_loss";
+  }
+  return "loss";
+}
+
+// The elementwise loss op of input against a target of the same shape, in one
+// kernel for the forward and one for the backward. reduction "none" (or "")
+// keeps the input shape; "sum" and "mean" give shape {1} and are reduced
+// without storing the individual losses.
+template <Numeric DType = float>
+std::shared_ptr<Variable<DType>>
+pointwise_loss(std::shared_ptr<Variable<DType>> input,
+               std::shared_ptr<Variable<DType>> target, kernels::LossOp op,
+               const std::string &reduction, DType delta = 1) {
+  input = Variable<DType>::contiguous(input);
+  target = Variable<DType>::contiguous(target);
+  if (input->shape != target->shape)
+    throw std::runtime_error("Loss target shape mismatch");
+  bool reduced = reduction == "sum" || reduction == "mean";
+  if (!reduced && reduction != "none" && reduction != "")
+    throw std::invalid_argument("Invalid reduction");
+  long n = input->numel();
+  auto prev = std::vector<std::shared_ptr<Variable<DType>>>{input, target};
+  auto shape = reduced ? std::vector<int>{1} : input->shape;
+  auto out = std::make_shared<Variable<DType>>(shape, prev, loss_name(op));
+  DType scale = reduction == "mean" && n > 0 ? DType(1) / n : DType(1);
+  if (reduced)
+    out->data[0] = kernels::loss_sum(op, input->data.data(),
+                                     target->data.data(), delta, n) *
+                   scale;
+  else
+    kernels::loss(op, input->data.data(), target->data.data(), delta,
+                  out->data.data(), n);
+
+  if (!out->requires_grad)
+    return out;
+
+  auto backward = [input = input.get(), target = target.get(),
+                   out = out.get(), saved_input = input->save(),
+                   saved_target = target->save(), op, delta, reduced, scale,
+                   n]() {
+    DType coefficient = reduced ? out->grad[0] * scale : DType(0);
+    kernels::loss_backward(
+        op, reduced ? &coefficient : out->grad.data(), reduced ? 0 : 1,
+        saved_input.data(), saved_target.data(), delta,
+        input->requires_grad ? input->grad.data() : nullptr,
+        target->requires_grad ? target->grad.data() : nullptr, n);
+  };
+  out->back = backward;
+  return out;
+}
 } // namespace variable
 
 #endif // VARIABLE_FUNC_H
@@ -18,7 +18,7 @@ tensor::Tensor random_horizontal_flip(tensor::Tensor tensor, float p) {
   std::minstd_rand gen(rd());
   std::uniform_real_distribution<> distr(0, 1);
   if (distr(gen) < p) {
-    auto data = std::vector<float>(tensor.data().size());
+    auto data = std::vector<float>(tensor.numel());
     auto result = tensor::Tensor(data, tensor.shape());
 
     int width = tensor.shape(1);
@@ -42,7 +42,7 @@ tensor::Tensor random_vertical_flip(tensor::Tensor tensor, float p) {
   std::minstd_rand gen(rd());
   std::uniform_real_distribution<> distr(0, 1);
   if (distr(gen) < p) {
-    auto data = std::vector<float>(tensor.data().size());
+    auto data = std::vector<float>(tensor.numel());
     auto result = tensor::Tensor(data, tensor.shape());
 
     int height = tensor.shape(0);
@@ -61,7 +61,7 @@ tensor::Tensor random_vertical_flip(tensor::Tensor tensor, float p) {
 tensor::Tensor random_rotation(tensor::Tensor tensor, float degrees) {
   assert(tensor.shape().size() == 2);
 
-  auto data = std::vector<float>(tensor.data().size(), 0);
+  auto data = std::vector<float>(tensor.numel(), 0);
   auto result = tensor::Tensor(data, tensor.shape());
 
   std::random_device rd;
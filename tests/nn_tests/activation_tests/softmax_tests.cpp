@@ -32,3 +32,17 @@ TEST(SoftmaxTest, Softmax_ForSpecificDim_Works) {
   ExpectVectorsNear(result.data(),
                     std::vector<float>({0.2689, 0.7311, 0.2689, 0.7311}));
 }
+
+TEST(SoftmaxTest, Softmax_ForLargeInputs_DoesNotOverflow) {
+  // arrange
+  auto t1 = tensor::Tensor(std::vector<float>({1000, 1001, -1000, -1001}),
+                           std::vector<int>({2, 2}));
+  auto softmax = nn::activation::Softmax(1);
+
+  // act
+  auto result = softmax.forward(t1);
+
+  // assert
+  ExpectVectorsNear(result.data(),
+                    std::vector<float>({0.2689, 0.7311, 0.7311, 0.2689}));
+}
@@ -0,0 +1,77 @@
+#include "../../../../src/nn/activation/tanh.h"
+#include "../../../../src/nn/containers/checkpoint.h"
+#include "../../../../src/nn/containers/sequential.h"
+#include "../../../../src/nn/dropout/dropout.h"
+#include "../../../../src/nn/linear/linear.h"
+#include "../../../../src/tensor/tensor.h"
+#include "../../../../src/tensor/tensor_create.h"
+#include "../../../../src/tensor/tensor_func.h"
+#include "../../tensor_tests/tensor_utils.h"
+#include <gtest/gtest.h>
+#include <vector>
+
+using namespace tensor;
+
+namespace {
+
+// Output, input gradient and parameter gradients of one training step of
+// Linear, Dropout, Tanh, Linear, Dropout, Linear, with the same weights and
+// dropout masks whatever segment_size is.
+std::vector<std::vector<float>> train_step(int segment_size) {
+  manual_seed(1);
+  auto linear1 = nn::linear::Linear(4, 8);
+  auto dropout1 = nn::dropout::Dropout(0.5);
+  auto activation = nn::activation::Tanh();
+  auto linear2 = nn::linear::Linear(8, 8, true, kernels::Activation::ReLU);
+  auto dropout2 = nn::dropout::Dropout(0.25);
+  auto linear3 = nn::linear::Linear(8, 3);
+  auto model = nn::container::Sequential(
+      {&linear1, &dropout1, &activation, &linear2, &dropout2, &linear3},
+      segment_size);
+  auto input = uniform({5, 4}, -1.0f, 1.0f, true);
+
+  auto output = model.forward(input);
+  auto loss = sum(output);
+  loss.backward();
+
+  auto result = std::vector<std::vector<float>>{output.data(), input.grad()};
+  for (auto parameter : model.parameters())
+    result.push_back(parameter->grad());
+  return result;
+}
+
+} // namespace
+
+TEST(SequentialTest, Checkpointing_GivesTheSameStep) {
+  // arrange
+  auto expected = train_step(0);
+
+  for (int segment_size : {1, 2, 4}) {
+    // act
+    auto result = train_step(segment_size);
+
+    // assert
+    ASSERT_EQ(result.size(), expected.size());
+    for (int i = 0; i < result.size(); i++)
+      ExpectVectorsNear(result[i], expected[i]);
+  }
+}
+
+TEST(SequentialTest, Checkpoint_WithoutGrad_RecordsNoGraph) {
+  // arrange
+  auto linear = nn::linear::Linear(2, 2);
+  auto wrapper = nn::container::Checkpoint(&linear);
+  auto input = Tensor({1.0, 2.0}, {1, 2});
+  auto expected = linear.forward(input);
+
+  // act
+  auto result = [&]() {
+    NoGradGuard guard;
+    return wrapper.forward(input);
+  }();
+
+  // assert
+  ExpectVectorsNear(result.data(), expected.data());
+  EXPECT_TRUE(result.var->prev.empty());
+  EXPECT_FALSE(result.requires_grad());
+}
@@ -1,6 +1,7 @@
 #include "../../../../src/nn/functional/loss.h"
 #include "../../../../src/tensor/tensor.h"
 #include "../../tensor_tests/tensor_utils.h"
+#include <cmath>
 #include <gtest/gtest.h>
 
 TEST(LossTests, MSE_WithMeanReduction_Works) {
@@ -47,3 +48,154 @@ TEST(LossTests, CrossEntropy_Works) {
   ExpectVectorsNear(t1.grad(),
                     {-0.4550, 0.1224, 0.3326, 0.0450, 0.1224, -0.1674});
 }
+
+TEST(LossTests, CrossEntropy_ForLargeLogits_Works) {
+  // arrange
+  auto t1 = tensor::Tensor({1001, 1002, 1003, -1001, -1002, -1003}, {2, 3});
+  auto t2 = tensor::Tensor({1, 0, 0, 0, 0, 1}, {2, 3});
+
+  // act
+  auto result = nn::functional::cross_entropy(t1, t2);
+  result.backward();
+
+  // assert
+  ExpectVectorsNear(result.data(), {2.4076});
+  ExpectVectorsNear(t1.grad(),
+                    {-0.4550, 0.1224, 0.3326, 0.3326, 0.1224, -0.4550});
+}
+
+TEST(LossTests, CrossEntropy_WithClassIndices_MatchesOneHot) {
+  // arrange
+  auto t1 = tensor::Tensor({1, 2, 3, 1, 2, 3}, {2, 3});
+  auto t2 = tensor::Tensor({0, 2}, {2});
+
+  // act
+  auto result = nn::functional::cross_entropy(t1, t2);
+  result.backward();
+
+  // assert
+  ExpectVectorsNear(result.data(), {1.4076});
+  ExpectVectorsNear(t1.grad(),
+                    {-0.4550, 0.1224, 0.3326, 0.0450, 0.1224, -0.1674});
+}
+
+TEST(LossTests, CrossEntropy_WithLabelSmoothingAndIgnoreIndex_Works) {
+  // arrange
+  auto t1 = tensor::Tensor({1, 2, 3, 1, 2, 3, 5, 5, 5}, {3, 3});
+  auto t2 = tensor::Tensor({0, -100, 2}, {3});
+
+  // act
+  auto result = nn::functional::cross_entropy(t1, t2, "mean", 0.3);
+  result.backward();
+
+  // assert
+  // The smoothed targets are {0.8, 0.1, 0.1} and {0.1, 0.1, 0.8}.
+  ExpectVectorsNear(result.data(), {(2.1076 + 1.0986) / 2});
+  ExpectVectorsNear(t1.grad(), {-0.3550, 0.0724, 0.2826, 0, 0, 0, 0.1167,
+                                0.1167, -0.2333});
+}
+
+TEST(LossTests, CrossEntropy_WithInvalidClassIndices_Throws) {
+  // arrange
+  auto t1 = tensor::Tensor({1, 2, 3, 1, 2, 3}, {2, 3});
+  auto nan = tensor::Tensor({0, NAN}, {2});
+  auto large = tensor::Tensor({0, 1e10}, {2});
+  auto fractional = tensor::Tensor({0, -100.5}, {2});
+
+  // act & assert
+  EXPECT_THROW(nn::functional::cross_entropy(t1, nan), std::runtime_error);
+  EXPECT_THROW(nn::functional::cross_entropy(t1, large), std::runtime_error);
+  EXPECT_THROW(nn::functional::cross_entropy(t1, fractional),
+               std::runtime_error);
+}
+
+TEST(LossTests, CrossEntropy_ForSingleSample_KeepsInputShapes) {
+  // arrange
+  auto t1 = tensor::Tensor({1, 2, 3}, {3});
+  auto t2 = tensor::Tensor({1, 0, 0}, {3});
+
+  // act
+  auto result = nn::functional::cross_entropy(t1, t2, "none");
+  result.backward();
+
+  // assert
+  EXPECT_EQ(t1.shape(), std::vector<int>({3}));
+  EXPECT_EQ(t2.shape(), std::vector<int>({3}));
+  EXPECT_EQ(result.shape(), std::vector<int>({1}));
+  ExpectVectorsNear(result.data(), {2.4076});
+  ExpectVectorsNear(t1.grad(), {-0.9100, 0.2447, 0.6652});
+}
+
+TEST(LossTests, NllLoss_Works) {
+  // arrange
+  auto t1 = tensor::Tensor({-1, -2, -3, -4, -5, -6}, {3, 2});
+  auto t2 = tensor::Tensor({1, 0, 1}, {3});
+
+  // act
+  auto result = nn::functional::nll_loss(t1, t2, "sum");
+  result.backward();
+
+  // assert
+  ExpectVectorsNear(result.data(), {2 + 3 + 6});
+  ExpectVectorsNear(t1.grad(), {0, -1, -1, 0, 0, -1});
+}
+
+TEST(LossTests, BinaryCrossEntropy_Works) {
+  // arrange
+  auto t1 = tensor::Tensor({0.5, 0.9, 0.2}, {3});
+  auto t2 = tensor::Tensor({1, 1, 0}, {3});
+
+  // act
+  auto result = nn::functional::binary_cross_entropy(t1, t2);
+  result.backward();
+
+  // assert
+  ExpectVectorsNear(result.data(), {(0.6931 + 0.1054 + 0.2231) / 3});
+  ExpectVectorsNear(t1.grad(), {-2.0f / 3, -1.1111f / 3, 1.25f / 3});
+}
+
+TEST(LossTests, BinaryCrossEntropyWithLogits_ForLargeLogits_Works) {
+  // arrange
+  auto t1 = tensor::Tensor({-1000, 0, 2, 1000}, {4});
+  auto t2 = tensor::Tensor({1, 0.5, 0, 0}, {4});
+
+  // act
+  auto result = nn::functional::binary_cross_entropy_with_logits(t1, t2);
+  result.backward();
+
+  // assert
+  ExpectVectorsNear(result.data(), {(1000 + 0.6931 + 2.1269 + 1000) / 4},
+                    1e-3);
+  ExpectVectorsNear(t1.grad(), {-0.25, 0, 0.2202, 0.25});
+  ExpectVectorsNear(t2.grad(), {250, 0, -0.5, -250});
+}
+
+TEST(LossTests, L1Loss_WithNoReduction_Works) {
+  // arrange
+  auto t1 = tensor::Tensor({1, -2, 3}, {3});
+  auto t2 = tensor::Tensor({0, 0, 3}, {3});
+
+  // act
+  auto result = nn::functional::l1_loss(t1, t2, "none");
+  result.backward();
+
+  // assert
+  EXPECT_EQ(result.shape(), std::vector<int>({3}));
+  ExpectVectorsNear(result.data(), {1, 2, 0});
+  ExpectVectorsNear(t1.grad(), {1, -1, 0});
+}
+
+TEST(LossTests, HuberLoss_Works) {
+  // arrange
+  auto t1 = tensor::Tensor({0, 1, 3}, {3});
+  auto t2 = tensor::Tensor({0.5, 0, 0}, {3});
+
+  // act
+  auto result = nn::functional::huber_loss(t1, t2, "sum", 2);
+  result.backward();
+
+  // assert
+  ExpectVectorsNear(result.data(), {0.125 + 0.5 + 4});
+  ExpectVectorsNear(t1.grad(), {-0.5, 1, 2});
+  ExpectVectorsNear(t2.grad(), {0.5, -1, -2});
+}
@@ -0,0 +1,78 @@
+#include "../../src/tensor/kernels/blas.h"
+#include "../../src/tensor/tensor.h"
+#include "../../src/tensor/tensor_func.h"
+#include "tensor_utils.h"
+#include <gtest/gtest.h>
+#include <vector>
+
+using namespace tensor;
+
+class GemmBackendTest : public ::testing::Test {
+protected:
+  void SetUp() override { previous = get_gemm_backend(); }
+  void TearDown() override { set_gemm_backend(previous); }
+
+  GemmBackend previous;
+};
+
+TEST_F(GemmBackendTest, SetGemmBackend_FallsBackWithoutBlas) {
+  // act
+  set_gemm_backend(GemmBackend::Blas);
+  auto selected = get_gemm_backend();
+
+  // assert
+  EXPECT_EQ(selected,
+            blas_available() ? GemmBackend::Blas : GemmBackend::Builtin);
+  EXPECT_EQ(gemm_backend_name(GemmBackend::Builtin), "builtin");
+}
+
+TEST_F(GemmBackendTest, Products_GiveSameResultForEveryBackend) {
+  // Vector-matrix, matrix-vector, packed and batched products, with the
+  // transposed operands of their backward passes.
+  auto sizes = std::vector<std::vector<int>>(
+      {{1, 1, 70, 33}, {1, 45, 20, 1}, {1, 37, 53, 19}, {3, 24, 130, 96}});
+  for (auto &size : sizes) {
+    // arrange
+    int batch = size[0], rows = size[1], inners = size[2], columns = size[3];
+    std::vector<float> x(batch * rows * inners), w(inners * columns);
+    for (int i = 0; i < x.size(); i++)
+      x[i] = (i % 13) / 13.0f - 0.5f;
+    for (int i = 0; i < w.size(); i++)
+      w[i] = (i % 7) / 7.0f - 0.5f;
+    std::vector<float> b(w.begin(), w.begin() + columns);
+    auto run = [&](kernels::Activation activation) {
+      auto input = batch == 1 ? Tensor(x, {rows, inners})
+                              : Tensor(x, {batch, rows, inners});
+      auto weight = batch == 1 ? Tensor(w, {inners, columns})
+                               : Tensor(w, {1, inners, columns});
+      auto bias = Tensor(b, {columns});
+      auto result = batch == 1 ? linear(input, weight, bias, activation)
+                               : input & weight;
+      result.backward();
+      std::vector<float> values(result.data());
+      auto input_grad = input.grad();
+      auto weight_grad = weight.grad();
+      values.insert(values.end(), input_grad.begin(), input_grad.end());
+      values.insert(values.end(), weight_grad.begin(), weight_grad.end());
+      return values;
+    };
+
+    // Batched products go through matmul rather than linear.
+    auto activations = std::vector<kernels::Activation>(
+        {kernels::Activation::None, kernels::Activation::ReLU,
+         kernels::Activation::Tanh, kernels::Activation::Gelu});
+    if (batch > 1)
+      activations.resize(1);
+    for (auto activation : activations) {
+      set_gemm_backend(GemmBackend::Builtin);
+      auto expected = run(activation);
+
+      // act
+      set_gemm_backend(GemmBackend::Blas);
+      auto actual = run(activation);
+
+      // assert
+      ExpectVectorsNear(actual, expected);
+    }
+  }
+}
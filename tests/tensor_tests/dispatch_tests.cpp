@@ -0,0 +1,61 @@
+#include "../../src/tensor/kernels/dispatch.h"
+#include "../../src/tensor/tensor.h"
+#include "tensor_utils.h"
+#include <gtest/gtest.h>
+#include <vector>
+
+using namespace tensor;
+
+class DispatchTest : public ::testing::Test {
+protected:
+  void SetUp() override { previous = get_cpu_capability(); }
+  void TearDown() override { set_cpu_capability(previous); }
+
+  CPUCapability previous;
+};
+
+TEST_F(DispatchTest, SetCpuCapability_ClampsToDetected) {
+  // act
+  set_cpu_capability(CPUCapability::AVX512);
+  auto best = get_cpu_capability();
+  set_cpu_capability(CPUCapability::DEFAULT);
+
+  // assert
+  EXPECT_GE(best, previous);
+  EXPECT_EQ(get_cpu_capability(), CPUCapability::DEFAULT);
+  EXPECT_EQ(cpu_capability_name(CPUCapability::DEFAULT), "default");
+}
+
+TEST_F(DispatchTest, Ops_GiveSameResultForEveryCapability) {
+  // arrange
+  int rows = 37, columns = 53;
+  std::vector<float> data(rows * columns);
+  for (int i = 0; i < data.size(); i++)
+    data[i] = (i % 13) * 0.5f - 3;
+  auto run = [&]() {
+    auto x = Tensor(data, {rows, columns});
+    auto bias = Tensor(std::vector<float>(columns, 0.25f), {columns});
+    auto weights = Tensor(std::vector<float>(data.begin(),
+                                             data.begin() + columns * 19),
+                          {columns, 19});
+    auto result = ((x * bias) / bias - x) & weights;
+    result.backward();
+    std::vector<float> values(result.data());
+    auto bias_grad = bias.grad();
+    auto weights_grad = weights.grad();
+    values.insert(values.end(), bias_grad.begin(), bias_grad.end());
+    values.insert(values.end(), weights_grad.begin(), weights_grad.end());
+    return values;
+  };
+  set_cpu_capability(CPUCapability::DEFAULT);
+  auto expected = run();
+
+  for (auto capability : {CPUCapability::AVX2, CPUCapability::AVX512}) {
+    // act
+    set_cpu_capability(capability);
+    auto actual = run();
+
+    // assert
+    ExpectVectorsNear(actual, expected);
+  }
+}
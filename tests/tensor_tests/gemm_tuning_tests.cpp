@@ -0,0 +1,84 @@
+#include "../../src/tensor/kernels/gemm_tuning.h"
+#include "../../src/tensor/tensor.h"
+#include "tensor_utils.h"
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace tensor;
+
+class GemmTuningTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    path = (std::filesystem::temp_directory_path() / "ctorch_gemm_test_cache")
+               .string();
+    std::filesystem::remove(path);
+    kernels::load_gemm_cache(path);
+  }
+  void TearDown() override {
+    std::filesystem::remove(path);
+    kernels::load_gemm_cache();
+  }
+
+  std::string path;
+};
+
+TEST_F(GemmTuningTest, SetGemmBlocking_WithOddBlocks_MatchesNaive) {
+  // arrange
+  int rows = 100, inners = 90, columns = 110;
+  std::vector<float> data1(rows * inners), data2(inners * columns);
+  for (int i = 0; i < data1.size(); i++)
+    data1[i] = (i % 13) / 13.0f - 0.5f;
+  for (int i = 0; i < data2.size(); i++)
+    data2[i] = (i % 7) / 7.0f - 0.5f;
+  auto t1 = Tensor(data1, {rows, inners});
+  auto t2 = Tensor(data2, {inners, columns});
+  kernels::set_gemm_blocking(rows, columns, inners, {7, 5, 9, 1 << 12});
+
+  // act
+  auto result = t1 & t2;
+
+  // assert
+  std::vector<float> expected(rows * columns, 0);
+  for (int i = 0; i < rows; i++)
+    for (int p = 0; p < inners; p++)
+      for (int j = 0; j < columns; j++)
+        expected[i * columns + j] +=
+            data1[i * inners + p] * data2[p * columns + j];
+  ExpectVectorsNear(result.data(), expected);
+}
+
+TEST_F(GemmTuningTest, SetGemmBlocking_AfterLookup_IsSeenByAllThreads) {
+  // arrange
+  auto blocking = kernels::GemmBlocking{48, 128, 1024, 1 << 16};
+  auto before = kernels::gemm_blocking(300, 300, 300);
+  auto after = kernels::GemmBlocking();
+
+  // act
+  kernels::set_gemm_blocking(300, 300, 300, blocking);
+  std::thread([&] { after = kernels::gemm_blocking(300, 300, 300); }).join();
+
+  // assert
+  EXPECT_TRUE(before == kernels::GemmBlocking());
+  EXPECT_TRUE(after == blocking);
+  EXPECT_TRUE(kernels::gemm_blocking(300, 300, 300) == blocking);
+}
+
+TEST_F(GemmTuningTest, TuneGemm_SavesBlockingForCpu) {
+  // act
+  auto tuned = kernels::tune_gemm(70, 80, 90);
+  kernels::set_gemm_blocking(70, 80, 90, {});
+  kernels::load_gemm_cache(path);
+
+  // assert
+  auto untuned = kernels::GemmBlocking();
+  EXPECT_TRUE(kernels::gemm_blocking(100, 200, 150) == tuned);
+  EXPECT_TRUE(kernels::gemm_blocking(1000, 200, 150) == untuned);
+  std::ifstream file(path);
+  std::string line;
+  std::getline(file, line);
+  EXPECT_EQ(line.rfind(kernels::cpu_model() + "\t", 0), 0);
+}
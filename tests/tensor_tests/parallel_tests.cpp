@@ -0,0 +1,110 @@
+#include "../../src/tensor/parallel/parallel.h"
+#include "../../src/tensor/tensor.h"
+#include "tensor_utils.h"
+#include <atomic>
+#include <gtest/gtest.h>
+#include <stdexcept>
+#include <vector>
+
+using namespace tensor;
+
+class ParallelTest : public ::testing::Test {
+protected:
+  void SetUp() override { previous = get_num_threads(); }
+  void TearDown() override { set_num_threads(previous); }
+
+private:
+  int previous;
+};
+
+TEST_F(ParallelTest, ParallelFor_CoversRangeExactlyOnce) {
+  // arrange
+  set_num_threads(4);
+  std::vector<std::atomic<int>> visits(1000);
+  std::atomic<int> chunks = 0;
+
+  // act
+  parallel::parallel_for(0, 1000, 10, [&](long begin, long end) {
+    chunks++;
+    for (long i = begin; i < end; i++)
+      visits[i]++;
+  });
+
+  // assert
+  EXPECT_EQ(chunks, 4);
+  for (auto &count : visits)
+    EXPECT_EQ(count, 1);
+}
+
+TEST_F(ParallelTest, ParallelFor_BelowTwoGrains_RunsInline) {
+  // arrange
+  set_num_threads(4);
+  int chunks = 0;
+
+  // act
+  parallel::parallel_for(0, 100, 60, [&](long begin, long end) {
+    chunks++;
+    EXPECT_FALSE(parallel::in_parallel_region());
+  });
+
+  // assert
+  EXPECT_EQ(chunks, 1);
+}
+
+TEST_F(ParallelTest, ParallelFor_Nested_RunsInnerLoopInline) {
+  // arrange
+  set_num_threads(3);
+  std::atomic<int> inner_chunks = 0;
+
+  // act
+  parallel::parallel_for(0, 3, 1, [&](long begin, long end) {
+    parallel::parallel_for(0, 100, 1, [&](long begin, long end) {
+      inner_chunks++;
+      EXPECT_EQ(end - begin, 100);
+    });
+  });
+
+  // assert
+  EXPECT_EQ(inner_chunks, 3);
+}
+
+TEST_F(ParallelTest, ParallelFor_RethrowsChunkException) {
+  // arrange
+  set_num_threads(2);
+
+  // act & assert
+  EXPECT_THROW(parallel::parallel_for(0, 2, 1,
+                                      [&](long begin, long end) {
+                                        if (begin == 1)
+                                          throw std::runtime_error("chunk");
+                                      }),
+               std::runtime_error);
+}
+
+TEST_F(ParallelTest, Ops_GiveSameResultForAnyThreadCount) {
+  // arrange
+  int rows = 300, columns = 301;
+  std::vector<float> data(rows * columns);
+  for (int i = 0; i < data.size(); i++)
+    data[i] = (i % 11) * 0.25f;
+  auto bias = Tensor(std::vector<float>(columns, 1), {columns});
+  auto weights = Tensor(std::vector<float>(columns * 20, 0.5f), {columns, 20});
+  auto run = [&]() {
+    auto x = Tensor(data, {rows, columns});
+    auto result = (x + bias) & weights;
+    result.backward();
+    return std::vector<float>(result.data());
+  };
+
+  // act
+  set_num_threads(1);
+  auto single = run();
+  auto single_grad = std::vector<float>(bias.grad());
+  std::fill(bias.grad_span().begin(), bias.grad_span().end(), 0.0f);
+  set_num_threads(4);
+  auto multi = run();
+
+  // assert
+  ExpectVectorsNear(multi, single);
+  ExpectVectorsNear(bias.grad(), single_grad);
+}
@@ -0,0 +1,143 @@
+#include "../../src/tensor/storage/caching_allocator.h"
+#include "../../src/tensor/storage/storage.h"
+#include "../../src/tensor/tensor.h"
+#include "../../src/tensor/tensor_create.h"
+#include "tensor_utils.h"
+#include <gtest/gtest.h>
+
+using namespace tensor;
+
+class CountingAllocator : public storage::CPUAllocator {
+public:
+  int allocations = 0;
+  int deallocations = 0;
+
+  void *allocate(size_t bytes) override {
+    allocations++;
+    return CPUAllocator::allocate(bytes);
+  }
+  void deallocate(void *ptr, size_t bytes) override {
+    deallocations++;
+    CPUAllocator::deallocate(ptr, bytes);
+  }
+};
+
+TEST(StorageTest, Storage_FromVector_AdoptsBufferWithoutCopy) {
+  // arrange
+  auto data = std::vector<float>({1, 2, 3});
+  const float *pointer = data.data();
+
+  // act
+  auto result = storage::Storage<float>(std::move(data));
+
+  // assert
+  EXPECT_EQ(result.data(), pointer);
+  EXPECT_EQ(result.size(), 3);
+}
+
+TEST(StorageTest, Storage_FromAllocator_IsZeroedAndReleased) {
+  // arrange
+  auto allocator = CountingAllocator();
+
+  // act
+  {
+    auto result = storage::Storage<float>(16, &allocator);
+    EXPECT_EQ(result.data()[15], 0);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(result.data()) % STORAGE_ALIGNMENT,
+              0);
+  }
+
+  // assert
+  EXPECT_EQ(allocator.allocations, 1);
+  EXPECT_EQ(allocator.deallocations, 1);
+}
+
+TEST(StorageTest, FromBlob_AliasesExternalBuffer) {
+  // arrange
+  float buffer[4] = {1, 2, 3, 4};
+  auto t = from_blob(buffer, {2, 2});
+
+  // act
+  auto doubled = t + t;
+  t.data(0) = 10;
+
+  // assert
+  ExpectVectorsNear(doubled.data(), {2, 4, 6, 8});
+  EXPECT_EQ(buffer[0], 10);
+  EXPECT_EQ(t.data_span().data(), buffer);
+}
+
+TEST(StorageTest, FromBlob_RunsDeleterWithLastReference) {
+  // arrange
+  float buffer[4] = {1, 2, 3, 4};
+  bool released = false;
+
+  // act
+  {
+    auto t = from_blob(buffer, {4}, [&](float *) { released = true; });
+    auto copy = t;
+    EXPECT_FALSE(released);
+  }
+
+  // assert
+  EXPECT_TRUE(released);
+}
+
+TEST(StorageTest, Views_ShareStorageWithSource) {
+  // arrange
+  auto t = Tensor({1, 2, 3, 4, 5, 6}, {2, 3});
+
+  // act
+  auto transposed = t.transpose(0, 1);
+  auto row = t.narrow(0, 1, 1);
+
+  // assert
+  EXPECT_EQ(transposed.var->storage, t.var->storage);
+  EXPECT_EQ(row.var->storage, t.var->storage);
+  EXPECT_EQ(row.data_span().data(), t.data_span().data() + 3);
+}
+
+TEST(StorageTest, CachingAllocator_ReusesFreedBlocks) {
+  // arrange
+  auto allocator = storage::get_caching_allocator();
+  allocator->empty_cache();
+  allocator->reset_stats();
+
+  // act
+  void *first = allocator->allocate(1000);
+  allocator->deallocate(first, 1000);
+  void *second = allocator->allocate(990);
+  auto stats = allocator->stats();
+  allocator->deallocate(second, 990);
+
+  // assert
+  EXPECT_EQ(first, second);
+  EXPECT_EQ(stats.misses, 1);
+  EXPECT_EQ(stats.hits, 1);
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(second) % STORAGE_ALIGNMENT, 0);
+}
+
+TEST(StorageTest, CachingAllocator_EmptyCache_ReleasesBlocks) {
+  // arrange
+  auto allocator = storage::get_caching_allocator();
+  allocator->empty_cache();
+  {
+    auto t = zeros({64, 64});
+  }
+  auto cached = allocator->stats().bytes_cached;
+
+  // act
+  allocator->empty_cache();
+
+  // assert
+  EXPECT_GE(cached, 64 * 64 * sizeof(float));
+  EXPECT_EQ(allocator->stats().bytes_cached, 0);
+}
+
+TEST(StorageTest, CachingAllocator_RoundSize_UsesSizeClasses) {
+  EXPECT_EQ(storage::CachingAllocator::round_size(1), 64);
+  EXPECT_EQ(storage::CachingAllocator::round_size(64), 64);
+  EXPECT_EQ(storage::CachingAllocator::round_size(65), 128);
+  EXPECT_EQ(storage::CachingAllocator::round_size(1000), 1024);
+  EXPECT_EQ(storage::CachingAllocator::round_size(4097), 5120);
+}
@@ -1,4 +1,5 @@
 #include "../../src/tensor/tensor.h"
+#include "../../src/tensor/tensor_create.h"
 #include "../../src/tensor/tensor_func.h"
 #include "tensor_utils.h"
 #include <cmath>
@@ -53,6 +54,120 @@ TEST(TensorFunTest, Log_Works) {
                     std::vector<float>({1.0, 1.0 / 2, 1.0 / 3, 1.0 / 4}));
 }
 
+TEST(TensorFunTest, Sigmoid_Works) {
+  // arrange
+  auto t = Tensor({-2.0, 0.0, 1.0, 3.0}, {2, 2});
+
+  // act
+  auto result = sigmoid(t);
+  result.backward();
+
+  // assert
+  ExpectVectorsNear(result.data(),
+                    std::vector<float>({0.1192, 0.5, 0.7311, 0.9526}));
+  ExpectVectorsNear(t.grad(),
+                    std::vector<float>({0.1050, 0.25, 0.1966, 0.0452}));
+}
+
+TEST(TensorFunTest, Gelu_Works) {
+  // arrange
+  auto t = Tensor({-1.0, 0.0, 1.0, 2.0}, {2, 2});
+
+  // act
+  auto result = gelu(t);
+  result.backward();
+
+  // assert
+  ExpectVectorsNear(result.data(),
+                    std::vector<float>({-0.1588, 0.0, 0.8412, 1.9546}));
+  ExpectVectorsNear(t.grad(),
+                    std::vector<float>({-0.0830, 0.5, 1.0830, 1.0861}));
+}
+
+TEST(TensorFunTest, Transcendentals_MatchLibmOverWideRange) {
+  // arrange
+  std::vector<float> data;
+  for (float x = -87; x < 88; x += 0.0731f)
+    data.push_back(x);
+  auto t = Tensor(data, {static_cast<int>(data.size())});
+  auto positive = Tensor(std::vector<float>({1e-40f, 1e-20f, 0.5f, 7.0f,
+                                             1e20f, 3e38f}),
+                         {6});
+  auto expect_ulps = [](float actual, double expected, double ulps) {
+    float rounded = static_cast<float>(expected);
+    double ulp = std::nextafter(std::fabs(rounded), INFINITY) -
+                 std::fabs(rounded);
+    EXPECT_LE(std::fabs(actual - expected), ulps * std::max(ulp, 1e-45));
+  };
+
+  // act
+  std::vector<float> exps = exp(t).data();
+  std::vector<float> tanhs = tanh(t).data();
+  std::vector<float> sigmoids = sigmoid(t).data();
+  std::vector<float> logs = log(positive).data();
+
+  // assert
+  for (int i = 0; i < data.size(); i++) {
+    double x = data[i];
+    expect_ulps(exps[i], std::exp(x), 2);
+    expect_ulps(tanhs[i], std::tanh(x), 2);
+    expect_ulps(sigmoids[i], 1 / (1 + std::exp(-x)), 3);
+  }
+  for (int i = 0; i < logs.size(); i++)
+    expect_ulps(logs[i], std::log(static_cast<double>(positive.data()[i])),
+                2);
+}
+
+TEST(TensorFunTest, Transcendentals_HandleSpecialValues) {
+  // arrange
+  float inf = INFINITY;
+  auto t = Tensor({-inf, -1.0, 0.0, inf, NAN, 100.0}, {6});
+
+  // act
+  std::vector<float> exps = exp(t).data();
+  std::vector<float> logs = log(t).data();
+  std::vector<float> tanhs = tanh(t).data();
+
+  // assert
+  EXPECT_EQ(exps[0], 0);
+  EXPECT_EQ(exps[3], inf);
+  EXPECT_TRUE(std::isnan(exps[4]));
+  EXPECT_EQ(exps[5], inf);
+  EXPECT_TRUE(std::isnan(logs[1]));
+  EXPECT_EQ(logs[2], -inf);
+  EXPECT_EQ(logs[3], inf);
+  EXPECT_TRUE(std::isnan(logs[4]));
+  EXPECT_EQ(tanhs[0], -1);
+  EXPECT_EQ(tanhs[3], 1);
+  EXPECT_TRUE(std::isnan(tanhs[4]));
+}
+
+TEST(TensorFunTest, Transcendentals_WithFastMath_StayClose) {
+  // arrange
+  std::vector<float> data;
+  for (float x = -20; x < 20; x += 0.0173f)
+    data.push_back(x);
+  auto t = Tensor(data, {static_cast<int>(data.size())});
+
+  // act
+  set_fast_math(true);
+  std::vector<float> exps = exp(t).data();
+  std::vector<float> tanhs = tanh(t).data();
+  std::vector<float> gelus = gelu(t).data();
+  set_fast_math(false);
+
+  // assert
+  for (int i = 0; i < data.size(); i++) {
+    double x = data[i];
+    double expected_gelu =
+        x / (1 + std::exp(-2 * 0.7978845608 * (x + 0.044715 * x * x * x)));
+    EXPECT_NEAR(exps[i], std::exp(x), 1e-5 * std::exp(x));
+    EXPECT_NEAR(tanhs[i], std::tanh(x), 2e-6);
+    if (x >= -3)
+      EXPECT_NEAR(gelus[i], expected_gelu, 1e-5 * std::fabs(expected_gelu));
+  }
+}
+
 TEST(TensorFunTest, Sum_Works) {
   // arrange
   auto t = Tensor({1.0, 2.0, 3.0, 4.0}, {2, 2});
@@ -94,3 +209,361 @@ TEST(TensorFunTest, Sum_ForSpecifiedDimWithKeepdim_Works) {
   ExpectVectorsNear(t.grad(), std::vector<float>({1.0, 1.0, 1.0, 1.0}));
   EXPECT_EQ(result.shape(), std::vector<int>({2, 1}));
 }
+
+TEST(TensorFunTest, SumBackward_ForSpecifiedDim_BroadcastsEachGrad) {
+  // arrange
+  auto t = Tensor({1.0, 2.0, 3.0, 4.0}, {2, 2});
+  auto weights = Tensor({1.0, 10.0}, {2});
+
+  // act
+  auto summed = sum(t, 0);
+  auto result = summed * weights;
+  result.backward();
+
+  // assert
+  ExpectVectorsNear(summed.data(), std::vector<float>({4, 6}));
+  ExpectVectorsNear(t.grad(), std::vector<float>({1, 10, 1, 10}));
+}
+
+TEST(TensorFunTest, Sum_ForMultipleDims_Works) {
+  // arrange
+  std::vector<float> data(24);
+  for (int i = 0; i < data.size(); i++)
+    data[i] = i;
+  auto t = Tensor(data, {2, 3, 4});
+  auto weights = Tensor({1.0, 2.0, 3.0}, {3, 1});
+
+  // act
+  auto summed = sum(t, std::vector<int>{0, -1}, true);
+  auto result = summed * weights;
+  result.backward();
+
+  // assert
+  EXPECT_EQ(summed.shape(), std::vector<int>({1, 3, 1}));
+  ExpectVectorsNear(summed.data(), std::vector<float>({60, 92, 124}));
+  for (int i = 0; i < data.size(); i++)
+    EXPECT_FLOAT_EQ(t.grad()[i], i / 4 % 3 + 1);
+}
+
+TEST(TensorFunTest, Reductions_OverEmptyDim_AreZero) {
+  // arrange
+  auto t = zeros({2, 0});
+  auto other = zeros({0, 3});
+
+  // act
+  auto summed = sum(t, 1);
+  auto total = sum(t);
+  auto norms = norm(t, {1});
+  auto product = t & other;
+
+  // assert
+  ExpectVectorsNear(summed.data(), std::vector<float>({0, 0}));
+  ExpectVectorsNear(total.data(), std::vector<float>({0}));
+  ExpectVectorsNear(norms.data(), std::vector<float>({0, 0}));
+  ExpectVectorsNear(product.data(), std::vector<float>(6, 0));
+}
+
+TEST(TensorFunTest, Mean_ForDim_Works) {
+  // arrange
+  auto t = Tensor({1.0, 2.0, 3.0, 4.0, 5.0, 6.0}, {2, 3});
+
+  // act
+  auto result = mean(t, {1});
+  result.backward();
+
+  // assert
+  EXPECT_EQ(result.shape(), std::vector<int>({2}));
+  ExpectVectorsNear(result.data(), std::vector<float>({2, 5}));
+  ExpectVectorsNear(t.grad(), std::vector<float>(6, 1.0f / 3));
+}
+
+TEST(TensorFunTest, Max_ForDim_RoutesGradToFirstMax) {
+  // arrange
+  auto t = Tensor({1.0, 7.0, 7.0, 4.0, -2.0, 3.0}, {2, 3});
+
+  // act
+  auto result = max(t, {1});
+  result.backward();
+  auto smallest = min(t, {0});
+
+  // assert
+  ExpectVectorsNear(result.data(), std::vector<float>({7, 4}));
+  ExpectVectorsNear(t.grad(), std::vector<float>({0, 1, 0, 1, 0, 0}));
+  ExpectVectorsNear(smallest.data(), std::vector<float>({1, -2, 3}));
+}
+
+TEST(TensorFunTest, Argmax_ForDim_Works) {
+  // arrange
+  auto t = Tensor({1.0, 7.0, 7.0, 4.0, -2.0, 3.0}, {2, 3});
+
+  // act
+  auto rows = argmax(t, 1);
+  auto columns = argmin(t, 0, true);
+  auto flat = argmax(t);
+
+  // assert
+  ExpectVectorsNear(rows.data(), std::vector<float>({1, 0}));
+  EXPECT_EQ(columns.shape(), std::vector<int>({1, 3}));
+  ExpectVectorsNear(columns.data(), std::vector<float>({0, 1, 1}));
+  ExpectVectorsNear(flat.data(), std::vector<float>({1}));
+  EXPECT_FALSE(rows.requires_grad());
+}
+
+TEST(TensorFunTest, Var_ForDim_Works) {
+  // arrange
+  auto t = Tensor({1.0, 2.0, 3.0, 4.0, 2.0, 0.0}, {2, 3});
+
+  // act
+  auto result = var(t, {1});
+  result.backward();
+
+  // assert
+  ExpectVectorsNear(result.data(), std::vector<float>({1, 4}));
+  // 2 (x - mean) / (n - 1)
+  ExpectVectorsNear(t.grad(), std::vector<float>({-1, 0, 1, 2, 0, -2}));
+}
+
+TEST(TensorFunTest, Norm_Works) {
+  // arrange
+  auto t = Tensor({3.0, 4.0, 0.0, 0.0}, {2, 2});
+
+  // act
+  auto result = norm(t, {1});
+  result.backward();
+
+  // assert
+  ExpectVectorsNear(result.data(), std::vector<float>({5, 0}));
+  ExpectVectorsNear(t.grad(), std::vector<float>({0.6, 0.8, 0, 0}));
+}
+
+TEST(TensorFunTest, Reductions_ForLargeTensors_MatchNaive) {
+  // arrange
+  std::vector<int> shape = {40, 70, 37};
+  std::vector<float> data(40 * 70 * 37);
+  for (int i = 0; i < data.size(); i++)
+    data[i] = (i * 7919 % 1000) * 0.001f;
+  auto t = Tensor(data, shape);
+  auto strides = std::vector<int>({70 * 37, 37, 1});
+
+  for (auto dims : std::vector<std::vector<int>>{
+           {0}, {1}, {2}, {0, 1}, {0, 2}, {1, 2}, {0, 1, 2}}) {
+    // act
+    auto sums = sum(t, dims, true);
+    auto maxes = max(t, dims, true);
+
+    // assert
+    auto out_shape = sums.shape();
+    std::vector<double> expected(sums.data().size(), 0);
+    std::vector<float> expected_max(sums.data().size(), -1);
+    for (int i = 0; i < data.size(); i++) {
+      int out = 0;
+      for (int d = 0; d < 3; d++) {
+        int index = i / strides[d] % shape[d];
+        if (out_shape[d] == 1)
+          index = 0;
+        out = out * out_shape[d] + index;
+      }
+      expected[out] += data[i];
+      expected_max[out] = std::max(expected_max[out], data[i]);
+    }
+    for (int o = 0; o < expected.size(); o++) {
+      EXPECT_NEAR(sums.data()[o], expected[o], 1e-4 * expected[o]);
+      EXPECT_EQ(maxes.data()[o], expected_max[o]);
+    }
+  }
+}
+
+TEST(TensorFunTest, LogSoftmax_ForLargeInputs_Works) {
+  // arrange
+  auto t = Tensor({1, 2, 3, 1000, 1001, 1002}, {2, 3});
+  auto weights = Tensor({1, 0, 0, 0, 0, 2}, {2, 3});
+  weights.requires_grad() = false;
+
+  // act
+  auto result = log_softmax(t, 1);
+  auto weighted = result * weights;
+  auto loss = sum(weighted);
+  loss.backward();
+
+  // assert
+  ExpectVectorsNear(result.data(),
+                    {-2.4076, -1.4076, -0.4076, -2.4076, -1.4076, -0.4076});
+  ExpectVectorsNear(t.grad(),
+                    {0.9100, -0.2447, -0.6652, -0.1801, -0.4895, 0.6695});
+}
+
+TEST(TensorFunTest, Softmax_ForLargeTensors_MatchesNaive) {
+  // arrange
+  std::vector<int> shape = {5, 37, 19};
+  std::vector<float> data(5 * 37 * 19);
+  for (int i = 0; i < data.size(); i++)
+    data[i] = (i * 7919 % 1000) * 0.1f;
+  auto t = Tensor(data, shape);
+  auto strides = std::vector<int>({37 * 19, 19, 1});
+
+  for (int dim = 0; dim < 3; dim++) {
+    // act
+    auto probabilities = softmax(t, dim);
+    auto logs = log_softmax(t, dim);
+
+    // assert
+    for (int i = 0; i < data.size(); i++) {
+      int first = i - i / strides[dim] % shape[dim] * strides[dim];
+      double sum = 0;
+      for (int j = 0; j < shape[dim]; j++)
+        sum += std::exp(static_cast<double>(data[first + j * strides[dim]]) -
+                        100);
+      double expected = static_cast<double>(data[i]) - 100 - std::log(sum);
+      EXPECT_NEAR(logs.data()[i], expected, 1e-4);
+      EXPECT_NEAR(probabilities.data()[i], std::exp(expected), 1e-6);
+    }
+  }
+}
+
+TEST(TensorFunTest, SoftmaxCrossEntropy_Works) {
+  // arrange
+  auto logits = Tensor({1, 2, 3, 1000, 1001, 1002}, {2, 3});
+  auto target = Tensor({0.5, 0, 0.5, 0, 0, 1}, {2, 3});
+
+  // act
+  auto result = softmax_cross_entropy(logits, target);
+  auto loss = sum(result);
+  loss.backward();
+
+  // assert
+  ExpectVectorsNear(result.data(), {1.4076, 0.4076});
+  ExpectVectorsNear(logits.grad(),
+                    {-0.4100, 0.2447, 0.1652, 0.0900, 0.2447, -0.3348});
+  ExpectVectorsNear(target.grad(), {2.4076, 1.4076, 0.4076, 2.4076, 1.4076,
+                                    0.4076});
+}
+
+TEST(TensorFunTest, ClassCrossEntropy_ForLargeTensors_MatchesDense) {
+  // arrange
+  std::vector<int> shape = {3, 11, 37};
+  std::vector<float> data(3 * 11 * 37);
+  for (int i = 0; i < data.size(); i++)
+    data[i] = (i * 7919 % 1000) * 0.01f;
+  std::vector<float> classes(3 * 37);
+  std::vector<float> one_hot(data.size());
+  for (int r = 0; r < classes.size(); r++) {
+    classes[r] = r % 11;
+    one_hot[(r / 37 * 11 + r % 11) * 37 + r % 37] = 1;
+  }
+  classes[5] = -100;
+  one_hot[(5 % 11) * 37 + 5] = 0;
+  auto dense_logits = Tensor(data, shape);
+  auto class_logits = Tensor(data, shape);
+  auto dense_target = Tensor(one_hot, shape);
+  auto class_target = Tensor(classes, {3, 37});
+
+  // act
+  auto dense = softmax_cross_entropy(dense_logits, dense_target, 0.1);
+  auto dense_loss = sum(dense);
+  dense_loss.backward();
+  auto indexed = class_cross_entropy(class_logits, class_target, 0.1);
+  auto indexed_loss = sum(indexed);
+  indexed_loss.backward();
+
+  // assert
+  for (int r = 0; r < classes.size(); r++)
+    if (r != 5)
+      EXPECT_NEAR(indexed.data()[r], dense.data()[r], 1e-5);
+  EXPECT_EQ(indexed.data()[5], 0);
+  for (int i = 0; i < data.size(); i++)
+    if (i % (11 * 37) % 37 != 5 || i / (11 * 37) != 0)
+      EXPECT_NEAR(class_logits.grad()[i], dense_logits.grad()[i], 1e-6);
+    else
+      EXPECT_EQ(class_logits.grad()[i], 0);
+}
+
+TEST(TensorFunTest, PointwiseLoss_ForLargeTensors_MatchesNaive) {
+  // arrange
+  int n = 70001;
+  std::vector<float> x(n);
+  std::vector<float> y(n);
+  for (int i = 0; i < n; i++) {
+    x[i] = 0.01f + (i * 7919 % 1000) * 0.00098f;
+    y[i] = (i * 104729L % 1000) * 0.001f;
+  }
+  auto ops = {kernels::LossOp::BCE, kernels::LossOp::BCEWithLogits,
+              kernels::LossOp::MSE, kernels::LossOp::L1,
+              kernels::LossOp::Huber};
+
+  for (auto op : ops) {
+    auto input = Tensor(x, {n});
+    auto target = Tensor(y, {n});
+
+    // act
+    auto losses = pointwise_loss(input, target, op, "none", 0.3f);
+    auto total = pointwise_loss(input, target, op, "mean", 0.3f);
+    total.backward();
+
+    // assert
+    double sum = 0;
+    for (int i = 0; i < n; i++) {
+      double expected = kernels::loss_value<double>(op, x[i], y[i], 0.3);
+      EXPECT_NEAR(losses.data()[i], expected, 1e-5);
+      sum += expected;
+      double dx = kernels::loss_grad<double>(op, 0, x[i], y[i], 0.3) / n;
+      double dy = kernels::loss_grad<double>(op, 1, x[i], y[i], 0.3) / n;
+      EXPECT_NEAR(input.grad()[i], dx, 1e-8);
+      EXPECT_NEAR(target.grad()[i], dy, 1e-8);
+    }
+    EXPECT_NEAR(total.data()[0], sum / n, 1e-5);
+  }
+}
+
+TEST(TensorFunTest, Linear_WithBiasAndActivation_MatchesUnfused) {
+  auto sizes = std::vector<std::vector<int>>(
+      {{37, 300, 45}, {3000, 4, 3}, {1, 785, 70}, {5, 300, 1}});
+  auto activations = {kernels::Activation::None, kernels::Activation::ReLU,
+                      kernels::Activation::Tanh, kernels::Activation::Gelu};
+  for (auto &size : sizes) {
+    int rows = size[0], inners = size[1], columns = size[2];
+    std::vector<float> x(rows * inners), w(inners * columns), b(columns);
+    for (int i = 0; i < x.size(); i++)
+      x[i] = (i * 7919 % 1000) * 0.002f - 1;
+    for (int i = 0; i < w.size(); i++)
+      w[i] = ((i * 104729L % 1000) * 0.002f - 1) / std::sqrt(inners);
+    for (int i = 0; i < b.size(); i++)
+      b[i] = i * 0.05f - 1;
+
+    for (auto activation : activations) {
+      // arrange
+      auto fused_x = Tensor(x, {rows, inners});
+      auto fused_w = Tensor(w, {inners, columns});
+      auto fused_b = Tensor(b, {columns});
+      auto plain_x = Tensor(x, {rows, inners});
+      auto plain_w = Tensor(w, {inners, columns});
+      auto plain_b = Tensor(b, {columns});
+
+      // act
+      auto fused = linear(fused_x, fused_w, fused_b, activation);
+      auto fused_loss = sum(fused);
+      fused_loss.backward();
+      auto product = plain_x & plain_w;
+      auto plain = product + plain_b;
+      if (activation == kernels::Activation::ReLU)
+        plain = relu(plain);
+      else if (activation == kernels::Activation::Tanh)
+        plain = tanh(plain);
+      else if (activation == kernels::Activation::Gelu)
+        plain = gelu(plain);
+      auto plain_loss = sum(plain);
+      plain_loss.backward();
+
+      // assert
+      ExpectVectorsNear(fused.data(), plain.data(), 1e-5);
+      ExpectVectorsNear(fused_x.grad(), plain_x.grad(), 1e-4);
+      // The weight and bias gradients sum over thousands of rows, in a
+      // different order in each version.
+      for (int i = 0; i < w.size(); i++)
+        EXPECT_NEAR(fused_w.grad()[i], plain_w.grad()[i],
+                    1e-5 * std::abs(plain_w.grad()[i]) + 1e-4);
+      for (int i = 0; i < b.size(); i++)
+        EXPECT_NEAR(fused_b.grad()[i], plain_b.grad()[i],
+                    1e-5 * std::abs(plain_b.grad()[i]) + 1e-4);
+    }
+  }
+}
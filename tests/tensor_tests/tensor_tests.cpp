@@ -3,7 +3,9 @@
 #include "../../src/tensor/tensor_create.h"
 #include "../../src/tensor/tensor_func.h"
 #include "tensor_utils.h"
+#include <cmath>
 #include <gtest/gtest.h>
+#include <memory>
 
 using namespace tensor;
 
@@ -101,6 +103,67 @@ TEST(TensorTest, Division_ForCorrectShapes_Works) {
   ExpectVectorsNear(t2.grad(), std::vector<float>({-0.1}));
 }
 
+TEST(TensorTest, Multiplication_ForColumnBroadcast_Works) {
+  // arrange
+  auto t1 = Tensor({1, 2, 3, 4, 5, 6}, {2, 3});
+  auto t2 = Tensor({10, 100}, {2, 1});
+
+  // act
+  auto result = t1 * t2;
+  result.backward();
+
+  // assert
+  ExpectVectorsNear(result.data(), {10, 20, 30, 400, 500, 600});
+  ExpectVectorsNear(t1.grad(), {10, 10, 10, 100, 100, 100});
+  ExpectVectorsNear(t2.grad(), {6, 15});
+}
+
+TEST(TensorTest, Subtraction_ForLargeRowBroadcast_MatchesElementwise) {
+  // arrange
+  int rows = 129, columns = 257;
+  std::vector<float> data1(rows * columns), data2(columns);
+  for (int i = 0; i < data1.size(); i++)
+    data1[i] = i % 17;
+  for (int i = 0; i < data2.size(); i++)
+    data2[i] = i % 5;
+  auto t1 = Tensor(data1, {rows, columns});
+  auto t2 = Tensor(data2, {columns});
+
+  // act
+  auto result = t1 - t2;
+  result.backward();
+
+  // assert
+  std::vector<float> expected(rows * columns);
+  for (int i = 0; i < expected.size(); i++)
+    expected[i] = data1[i] - data2[i % columns];
+  ExpectVectorsNear(result.data(), expected);
+  ExpectVectorsNear(t1.grad(), std::vector<float>(rows * columns, 1));
+  ExpectVectorsNear(t2.grad(), std::vector<float>(columns, -rows));
+}
+
+TEST(TensorTest, MultiplicationBackward_ForLargeScalarBroadcast_SumsGrad) {
+  // arrange
+  int rows = 200, columns = 301;
+  std::vector<float> data(rows * columns);
+  for (int i = 0; i < data.size(); i++)
+    data[i] = i % 7 - 3;
+  auto t1 = Tensor(data, {rows, columns});
+  auto t2 = Tensor({2}, {1});
+  auto column = Tensor(std::vector<float>(rows, 1), {rows, 1});
+
+  // act
+  auto result = t1 * t2 + column;
+  result.backward();
+
+  // assert
+  float expected = 0;
+  for (float value : data)
+    expected += value;
+  ExpectVectorsNear(t2.grad(), {expected});
+  ExpectVectorsNear(column.grad(), std::vector<float>(rows, columns));
+}
+
 TEST(TensorTest, MatrixMultiplication_ForMatchingShapes_Works) {
   // arrange
   auto t1 = Tensor({1.0, 2.0}, {1, 2});
@@ -153,8 +216,77 @@ TEST(TensorTest, MatrixMultiplicationBackward_ForMatchingShapes_Works) {
   ExpectVectorsNear(t2.grad(), std::vector<float>({1.0, 1.0, 2.0, 2.0}));
 }
 
+TEST(TensorTest, MatrixMultiplication_ForUnevenBlockSizes_MatchesNaive) {
+  // arrange
+  int rows = 37, inners = 300, columns = 41;
+  std::vector<float> data1(rows * inners), data2(inners * columns);
+  for (int i = 0; i < data1.size(); i++)
+    data1[i] = (i % 13) / 13.0f - 0.5f;
+  for (int i = 0; i < data2.size(); i++)
+    data2[i] = (i % 7) / 7.0f - 0.5f;
+  auto t1 = Tensor(data1, {rows, inners});
+  auto t2 = Tensor(data2, {inners, columns});
+
+  // act
+  auto result = t1 & t2;
+  result.backward();
+
+  // assert
+  std::vector<float> expected(rows * columns, 0);
+  std::vector<float> expected_grad1(rows * inners, 0);
+  std::vector<float> expected_grad2(inners * columns, 0);
+  for (int i = 0; i < rows; i++) {
+    for (int p = 0; p < inners; p++) {
+      for (int j = 0; j < columns; j++) {
+        float product = data1[i * inners + p] * data2[p * columns + j];
+        expected[i * columns + j] += product;
+        expected_grad1[i * inners + p] += data2[p * columns + j];
+        expected_grad2[p * columns + j] += data1[i * inners + p];
+      }
+    }
+  }
+  ExpectVectorsNear(result.data(), expected);
+  ExpectVectorsNear(t1.grad(), expected_grad1);
+  ExpectVectorsNear(t2.grad(), expected_grad2);
+}
+
+TEST(TensorTest, MatrixMultiplication_ForSmallShapes_MatchesNaive) {
+  // Shapes that skip the packed kernel: one row, a few rows, one column.
+  auto sizes = std::vector<std::vector<int>>(
+      {{1, 785, 513}, {3, 64, 37}, {9, 300, 1}, {2, 5, 3}});
+  for (auto &size : sizes) {
+    // arrange
+    int rows = size[0], inners = size[1], columns = size[2];
+    std::vector<float> data1(rows * inners), data2(inners * columns);
+    for (int i = 0; i < data1.size(); i++)
+      data1[i] = (i % 13) / 13.0f - 0.5f;
+    for (int i = 0; i < data2.size(); i++)
+      data2[i] = (i % 7) / 7.0f - 0.5f;
+    auto t1 = Tensor(data1, {rows, inners});
+    auto t2 = Tensor(data2, {inners, columns});
+
+    // act
+    auto result = t1 & t2;
+    result.backward();
+
+    // assert
+    std::vector<float> expected(rows * columns, 0);
+    std::vector<float> expected_grad1(rows * inners, 0);
+    for (int i = 0; i < rows; i++) {
+      for (int p = 0; p < inners; p++) {
+        for (int j = 0; j < columns; j++) {
+          expected[i * columns + j] +=
+              data1[i * inners + p] * data2[p * columns + j];
+          expected_grad1[i * inners + p] += data2[p * columns + j];
+        }
+      }
+    }
+    ExpectVectorsNear(result.data(), expected);
+    ExpectVectorsNear(t1.grad(), expected_grad1);
+  }
+}
+
 TEST(TensorTest, MatrixMultiplication_ForTensors_Works) {
-  throw std::runtime_error("Test not working");
   // arrange
   auto t1 = Tensor({8, 6, 4, 2, 0, -2, -4, -6}, {2, 2, 2});
   auto t2 = Tensor({1, 2, 3, 4, 5, 6, 7, 8}, {2, 2, 2});
@@ -168,9 +300,9 @@ TEST(TensorTest, MatrixMultiplication_ForTensors_Works) {
                     std::vector<float>({26, 40, 10, 16, -14, -16, -62, -72}));
   EXPECT_EQ(result.shape(), std::vector<int>({2, 2, 2}));
   ExpectVectorsNear(t1.grad(),
-                    std::vector<float>({12, 12, 8, 8, -4, -4, -8, -8}));
-  ExpectVectorsNear(t2.grad(),
                     std::vector<float>({3, 7, 3, 7, 11, 15, 11, 15}));
+  ExpectVectorsNear(t2.grad(),
+                    std::vector<float>({12, 12, 8, 8, -4, -4, -8, -8}));
 }
 
 TEST(TensorTest, MatrixMultiplication_ForTensorAndMatrix_Works) {
@@ -190,6 +322,39 @@ TEST(TensorTest, MatrixMultiplication_ForTensorAndMatrix_Works) {
   ExpectVectorsNear(t2.grad(), std::vector<float>({8, 8, 0, 0}));
 }
 
+TEST(TensorTest, MatrixMultiplication_ForBroadcastBatches_Works) {
+  // arrange
+  auto t1 = Tensor({1, 2, 3, 4}, {2, 1, 2});
+  auto t2 = Tensor({1, 0, 0, 1, 2, 0, 0, 2, 1, 1, 1, 1}, {3, 1, 2, 2});
+
+  // act
+  auto result = t1 & t2;
+  result.backward();
+
+  // assert
+  EXPECT_EQ(result.shape(), std::vector<int>({3, 2, 1, 2}));
+  ExpectVectorsNear(result.data(),
+                    {1, 2, 3, 4, 2, 4, 6, 8, 3, 3, 7, 7});
+  ExpectVectorsNear(t1.grad(), {5, 5, 5, 5});
+  ExpectVectorsNear(t2.grad(), {4, 4, 6, 6, 4, 4, 6, 6, 4, 4, 6, 6});
+}
+
+TEST(TensorTest, MatrixMultiplication_ForTransposedBatches_ReadsViews) {
+  // arrange
+  auto t1 = Tensor({1, 2, 3, 4, 5, 6, 7, 8}, {2, 2, 2});
+  auto t2 = Tensor({1, 2, 3, 4, 5, 6, 7, 8}, {2, 2, 2});
+
+  // act
+  auto transposed = t2.transpose(1, 2);
+  auto result = t1 & transposed;
+  result.backward();
+
+  // assert
+  ExpectVectorsNear(result.data(), {5, 11, 11, 25, 61, 83, 83, 113});
+  ExpectVectorsNear(t1.grad(), {4, 6, 4, 6, 12, 14, 12, 14});
+  ExpectVectorsNear(t2.grad(), {4, 6, 4, 6, 12, 14, 12, 14});
+}
+
 TEST(TensorTest, backward_ForSingleValueTensors_Works) {
   // arrange
   auto x1 = Tensor({2.0}, {1});
@@ -270,10 +435,166 @@ TEST(TensorTest, Backward_ForLinearLayerBatchedData_Works) {
   ExpectVectorsNear(b.grad(), {3.0169615, -5.3018e-5}, 1.0e-7);
 }
 
+TEST(TensorTest, Backward_ForLongChain_Works) {
+  // arrange
+  auto x = Tensor({1.0}, {1});
+  auto scale = Tensor({1.0}, {1});
+  auto y = x;
+  for (int i = 0; i < 50000; i++) {
+    auto scaled = y * scale;
+    y = scaled + x;
+  }
+
+  // act
+  y.backward();
+
+  // assert
+  ExpectVectorsNear(y.data(), {50001});
+  ExpectVectorsNear(x.grad(), {50001});
+}
+
+TEST(TensorTest, Backward_WithGradient_SeedsTheResult) {
+  // arrange
+  auto x = Tensor({1, 2, 3}, {3});
+  auto w = Tensor({4, 5, 6}, {3});
+  auto gradient = Tensor({1, 0, -2}, {3});
+
+  // act
+  auto result = x * w;
+  result.backward(gradient);
+
+  // assert
+  ExpectVectorsNear(x.grad(), {4, 0, -12});
+  ExpectVectorsNear(w.grad(), {1, 0, -6});
+}
+
+TEST(TensorTest, Backward_FreesGraphUnlessRetained) {
+  // arrange
+  auto x = Tensor({2.0}, {1});
+  auto w = Tensor({3.0}, {1});
+  auto retained = x * w;
+  auto freed = x * w;
+  auto intermediate = std::weak_ptr<variable::Variable<>>();
+  {
+    auto product = freed * w;
+    intermediate = product.var->weak_from_this();
+    freed = product * x;
+  }
+  auto retained_out = retained * retained;
+
+  // act
+  freed.backward();
+  retained_out.backward(true);
+
+  // assert
+  EXPECT_TRUE(intermediate.expired());
+  EXPECT_TRUE(freed.var->prev.empty());
+  EXPECT_THROW(freed.backward(), std::runtime_error);
+  EXPECT_EQ(retained_out.var->prev.size(), 2);
+  EXPECT_NO_THROW(retained_out.backward(true));
+}
+
+TEST(TensorTest, Graph_IsFreedWithTheResult) {
+  // arrange
+  auto x = Tensor({1.0}, {1});
+  auto first = std::weak_ptr<variable::Variable<>>();
+
+  // act
+  {
+    auto y = x * x;
+    first = y.var->weak_from_this();
+    for (int i = 0; i < 100000; i++) {
+      auto next = y * x;
+      y = next;
+    }
+  }
+
+  // assert
+  EXPECT_TRUE(first.expired());
+}
+
+TEST(TensorTest, Forward_ReleasesDataTheBackwardDoesNotSave) {
+  // arrange
+  auto x = Tensor({1.0, -2.0}, {1, 2});
+  auto w = Tensor({0.5, -1.0, 2.0, 0.25}, {2, 2});
+  auto product = std::weak_ptr<storage::Storage<float>>();
+  auto activation = std::weak_ptr<storage::Storage<float>>();
+  auto forward = [&]() {
+    auto h = x & w;
+    auto t = tanh(h);
+    auto squares = t * t;
+    product = h.var->storage;
+    activation = t.var->storage;
+    return sum(squares);
+  };
+  float t0 = std::tanh(-3.5f), t1 = std::tanh(-1.5f);
+  float d0 = 2 * t0 * (1 - t0 * t0), d1 = 2 * t1 * (1 - t1 * t1);
+
+  // act
+  auto out = forward();
+  bool product_released = product.expired();
+  bool activation_released = activation.expired();
+  out.backward();
+
+  // assert
+  EXPECT_TRUE(product_released);
+  EXPECT_FALSE(activation_released);
+  EXPECT_TRUE(activation.expired());
+  ExpectVectorsNear(x.grad(),
+                    std::vector<float>({0.5f * d0 - d1, 2 * d0 + 0.25f * d1}));
+  ExpectVectorsNear(w.grad(), std::vector<float>({d0, d1, -2 * d0, -2 * d1}));
+}
+
+TEST(TensorTest, MultiplicationByConstant_ReleasesTheOtherOperand) {
+  // arrange
+  auto w = Tensor({1, 2}, {2});
+  auto c = Tensor({2, 5}, {2});
+  c.requires_grad() = false;
+  auto operand = std::weak_ptr<storage::Storage<float>>();
+  auto forward = [&]() {
+    auto x = w + w;
+    operand = x.var->storage;
+    auto product = x * c;
+    return sum(product);
+  };
+
+  // act
+  auto out = forward();
+  bool operand_released = operand.expired();
+  out.backward();
+
+  // assert
+  EXPECT_TRUE(operand_released);
+  ExpectVectorsNear(w.grad(), {4, 10});
+}
+
+TEST(TensorTest, DivisionByConstant_ReleasesTheDividend) {
+  // arrange
+  auto w = Tensor({1, 2}, {2});
+  auto c = Tensor({2, 4}, {2});
+  c.requires_grad() = false;
+  auto dividend = std::weak_ptr<storage::Storage<float>>();
+  auto forward = [&]() {
+    auto x = w + w;
+    dividend = x.var->storage;
+    auto quotient = x / c;
+    return sum(quotient);
+  };
+
+  // act
+  auto out = forward();
+  bool dividend_released = dividend.expired();
+  out.backward();
+
+  // assert
+  EXPECT_TRUE(dividend_released);
+  ExpectVectorsNear(w.grad(), {1, 0.5});
+}
+
 TEST(TensorTest, CopyConstructor_CopiesData_1to1) {
   // arrange
   auto t = Tensor({1.0, 2.0, 3.0, 4.0}, {2, 2});
-  t.grad() = {4.0, 3.0, 2.0, 1.0};
+  t.grad_span() = {4.0, 3.0, 2.0, 1.0};
 
   // act
   auto copy = new Tensor(t);
@@ -282,3 +603,267 @@ TEST(TensorTest, CopyConstructor_CopiesData_1to1) {
   ExpectVectorsNear(t.data(), copy->data());
   ExpectVectorsNear(t.grad(), copy->grad());
 }
+
+TEST(TensorTest, Transpose_SharesDataWithoutCopy) {
+  // arrange
+  auto t = Tensor({1, 2, 3, 4, 5, 6}, {2, 3});
+
+  // act
+  auto result = t.transpose(0, 1);
+  result.get({2, 1}) = 60;
+
+  // assert
+  EXPECT_EQ(result.shape(), std::vector<int>({3, 2}));
+  EXPECT_FALSE(result.is_contiguous());
+  EXPECT_EQ(t.data(5), 60);
+  ExpectVectorsNear(result.contiguous().data(), {1, 4, 2, 5, 3, 60});
+}
+
+TEST(TensorTest, Data_OfTemporary_OutlivesTheTensor) {
+  // arrange
+  auto t = Tensor({1, 2, 3}, {3});
+
+  // act
+  auto values = (t + t).data();
+  auto reused = t * t;
+
+  // assert
+  ExpectVectorsNear(values, {2, 4, 6});
+  ExpectVectorsNear(reused.data(), {1, 4, 9});
+}
+
+TEST(TensorTest, Data_OfStridedView_CopiesTheView) {
+  // arrange
+  auto t = Tensor({0, 1, 2, 3, 4, 5, 6, 7}, {2, 4});
+
+  // act
+  auto result = t.slice(1, 1, 4, 2);
+
+  // assert
+  EXPECT_EQ(result.numel(), 4);
+  ExpectVectorsNear(result.data(), {1, 3, 5, 7});
+  EXPECT_THROW(result.data_span(), std::runtime_error);
+  EXPECT_EQ(result.contiguous().data_span().size(), 4);
+}
+
+TEST(TensorTest, View_OfTransposedTensor_Throws) {
+  // arrange
+  auto t = Tensor({1, 2, 3, 4, 5, 6}, {2, 3});
+
+  // act
+  auto result = t.transpose(0, 1);
+
+  // assert
+  EXPECT_THROW(result.view({6}), std::runtime_error);
+  EXPECT_EQ(result.shape(), std::vector<int>({3, 2}));
+}
+
+TEST(TensorTest, DataAtIndex_OfViews_FollowsTheView) {
+  // arrange
+  auto t = Tensor({1, 2, 3, 4, 5, 6}, {2, 3});
+
+  // act
+  auto transposed = t.transpose(0, 1);
+  auto narrowed = t.narrow(1, 1, 2);
+
+  // assert
+  EXPECT_EQ(transposed.data(1), 4);
+  EXPECT_EQ(transposed.data(4), 3);
+  EXPECT_EQ(narrowed.data(2), 5);
+  EXPECT_EQ(narrowed.data(3), 6);
+}
+
+TEST(TensorTest, TransposeBackward_PropagatesIntoSource) {
+  // arrange
+  auto t = Tensor({1, 2, 3, 4, 5, 6}, {2, 3});
+  auto w = Tensor({1, 10, 100, 1000, 10000, 100000}, {3, 2});
+
+  // act
+  auto transposed = t.transpose(0, 1);
+  auto result = transposed * w;
+  result.backward();
+
+  // assert
+  ExpectVectorsNear(result.data(), {1, 40, 200, 5000, 30000, 600000});
+  ExpectVectorsNear(t.grad(), {1, 100, 10000, 10, 1000, 100000});
+}
+
+TEST(TensorTest, Slice_WithStep_SelectsElementsAndBackward) {
+  // arrange
+  auto t = Tensor({0, 1, 2, 3, 4, 5, 6, 7}, {2, 4});
+
+  // act
+  auto result = t.slice(1, 1, 4, 2);
+  auto total = sum(result);
+  total.backward();
+
+  // assert
+  EXPECT_EQ(result.shape(), std::vector<int>({2, 2}));
+  ExpectVectorsNear(result.contiguous().data(), {1, 3, 5, 7});
+  ExpectVectorsNear(t.grad(), {0, 1, 0, 1, 0, 1, 0, 1});
+}
+
+TEST(TensorTest, Narrow_ContiguousRows_StaysContiguous) {
+  // arrange
+  auto t = Tensor({0, 1, 2, 3, 4, 5, 6, 7}, {4, 2});
+
+  // act
+  auto result = t.narrow(0, 1, 2);
+
+  // assert
+  EXPECT_TRUE(result.is_contiguous());
+  ExpectVectorsNear(result.data(), {2, 3, 4, 5});
+}
+
+TEST(TensorTest, ExpandBackward_SumsOverBroadcastDims) {
+  // arrange
+  auto t = Tensor({1, 2}, {2, 1});
+
+  // act
+  auto result = t.expand({3, 2, 3});
+  auto total = sum(result);
+  total.backward();
+
+  // assert
+  EXPECT_EQ(result.shape(), std::vector<int>({3, 2, 3}));
+  ExpectVectorsNear(result.contiguous().data(),
+                    {1, 1, 1, 2, 2, 2, 1, 1, 1, 2, 2, 2, 1, 1, 1, 2, 2, 2});
+  ExpectVectorsNear(t.grad(), {9, 9});
+}
+
+TEST(TensorTest, Reshape_OfPermutedTensor_CopiesOnce) {
+  // arrange
+  auto t = Tensor({1, 2, 3, 4, 5, 6}, {1, 2, 3});
+
+  // act
+  auto result = t.permute({2, 0, 1}).reshape({-1});
+  result.backward();
+
+  // assert
+  EXPECT_EQ(result.shape(), std::vector<int>({6}));
+  ExpectVectorsNear(result.data(), {1, 4, 2, 5, 3, 6});
+  ExpectVectorsNear(t.grad(), {1, 1, 1, 1, 1, 1});
+}
+
+TEST(TensorTest, RequiresGrad_IsInferredThroughOps) {
+  // arrange
+  auto x = Tensor({1, 2}, {2});
+  auto w = Tensor({3, 4}, {2});
+  x.requires_grad() = false;
+
+  // act
+  auto constant = x * x;
+  auto result = constant * w;
+  result.backward();
+
+  // assert
+  EXPECT_FALSE(constant.requires_grad());
+  EXPECT_TRUE(constant.var->prev.empty());
+  EXPECT_TRUE(result.requires_grad());
+  EXPECT_EQ(x.var->grad_storage, nullptr);
+  EXPECT_EQ(constant.var->grad_storage, nullptr);
+  ExpectVectorsNear(w.grad(), {1, 4});
+}
+
+TEST(TensorTest, Factories_MakeTensorsWithoutGradByDefault) {
+  // arrange
+  auto w = Tensor({1, 2}, {2});
+
+  // act
+  auto noise = uniform({2}, 0.0f, 1.0f);
+  auto constant = from_vector({3, 4}, {2});
+  auto parameter = zeros({2}, true);
+  auto masked = noise * constant;
+  auto result = w * constant;
+
+  // assert
+  EXPECT_FALSE(noise.requires_grad());
+  EXPECT_FALSE(constant.requires_grad());
+  EXPECT_TRUE(parameter.requires_grad());
+  EXPECT_FALSE(masked.requires_grad());
+  EXPECT_TRUE(masked.var->prev.empty());
+  EXPECT_TRUE(result.requires_grad());
+}
+
+TEST(TensorTest, Grad_IsAllocatedOnFirstAccumulation) {
+  // arrange
+  auto t1 = Tensor({1, 2}, {2});
+  auto t2 = Tensor({3, 4}, {2});
+
+  // act
+  auto result = t1 * t2;
+  bool allocated_before_backward = result.var->grad_storage != nullptr;
+  result.backward();
+
+  // assert
+  EXPECT_FALSE(allocated_before_backward);
+  ExpectVectorsNear(t1.grad(), {3, 4});
+  ExpectVectorsNear(t2.grad(), {1, 2});
+}
+
+TEST(TensorTest, GradAtIndex_BeforeBackward_AllocatesZeros) {
+  // arrange
+  auto t = Tensor({1, 2}, {2});
+
+  // act
+  float first = t.grad(0);
+  t.grad(1) = 5;
+
+  // assert
+  EXPECT_EQ(first, 0);
+  ExpectVectorsNear(t.grad(), {0, 5});
+}
+
+TEST(TensorTest, NoGradGuard_ProducesLeafResults) {
+  // arrange
+  auto t1 = Tensor({1, 2}, {2});
+  auto t2 = Tensor({3, 4}, {2});
+
+  // act
+  auto result = Tensor({0}, {1});
+  {
+    auto guard = NoGradGuard();
+    auto product = t1 * t2;
+    result = tanh(product);
+  }
+  auto recorded = t1 * t2;
+
+  // assert
+  ExpectVectorsNear(result.data(), {std::tanh(3.0f), std::tanh(8.0f)});
+  EXPECT_FALSE(result.requires_grad());
+  EXPECT_TRUE(result.var->prev.empty());
+  EXPECT_TRUE(recorded.requires_grad());
+  EXPECT_EQ(recorded.var->prev.size(), 2);
+}
+
+TEST(TensorTest, InferenceMode_ResultsCannotBeSavedForBackward) {
+  // arrange
+  auto x = Tensor({1, 2}, {2});
+  auto w = Tensor({3, 4}, {2});
+
+  // act
+  auto result = Tensor({0}, {1});
+  {
+    auto guard = InferenceModeGuard();
+    result = x * w;
+  }
+
+  // assert
+  EXPECT_FALSE(result.requires_grad());
+  EXPECT_TRUE(result.var->is_inference);
+  EXPECT_THROW(result * w, std::runtime_error);
+}
+
+TEST(TensorTest, FullName_IsBuiltFromTheGraphOnDemand) {
+  // arrange
+  auto x = Tensor({1, 2}, {2}, "x");
+  auto w = Tensor({3, 4}, {2}, "w");
+
+  // act
+  auto product = x * w;
+  auto result = tanh(product);
+
+  // assert
+  EXPECT_EQ(product.name(), "");
+  EXPECT_EQ(result.full_name(), "tanh(x * w)");
+}